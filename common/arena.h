@@ -0,0 +1,173 @@
+/**
+ * @file
+ *
+ * Bump allocation for short-lived data that is all discarded at once.
+ */
+
+#ifndef UTS_COMMON_ARENA_H
+#define UTS_COMMON_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include "debug_vector.h"
+#include "debug_unordered_map.h"
+
+/**
+ * Memory for the transient data of one operation, such as the lookup tables built during validation.
+ * Allocation bumps a pointer through large blocks, deallocation does nothing, and everything is freed
+ * together when the arena is destroyed or @ref reset. Blocks double in size as the arena fills, so the
+ * number of blocks grows only with the logarithm of the total. Not thread-safe: each thread or
+ * operation should have its own arena.
+ */
+class Arena
+{
+private:
+    /// A block of raw memory, filled from the front
+    struct Block
+    {
+        char * data;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks;  ///< blocks in order of allocation, the last is being filled
+    std::size_t offset;         ///< first free byte in the last block
+    std::size_t blocksize;      ///< size of the first block
+    std::size_t used;           ///< bytes handed out since the last reset, including alignment padding
+
+    // Make non-copyable
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /// Add a block with room for at least @a bytes
+    void addBlock(std::size_t bytes)
+    {
+        std::size_t size = std::max(bytes, blocks.empty() ? blocksize : 2 * blocks.back().size);
+        blocks.push_back(Block{static_cast<char *>(::operator new(size)), size});
+        offset = 0;
+    }
+
+public:
+    /// Constructor. No memory is taken until the first allocation.
+    explicit Arena(std::size_t blocksize = 64 * 1024) : offset(0), blocksize(blocksize), used(0)
+    {
+    }
+
+    ~Arena()
+    {
+        for(Block &b: blocks)
+            ::operator delete(b.data);
+    }
+
+    /**
+     * Allocate uninitialised memory
+     * @param bytes     size wanted
+     * @param align     alignment wanted, a power of two
+     * @return memory valid until the arena is reset or destroyed
+     */
+    void * allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t))
+    {
+        std::uintptr_t start = 0;
+
+        if(!blocks.empty())
+        {
+            std::uintptr_t base = reinterpret_cast<std::uintptr_t>(blocks.back().data);
+            start = (base + offset + align - 1) & ~(std::uintptr_t) (align - 1);
+            if(start + bytes > base + blocks.back().size)
+                start = 0;
+        }
+        if(start == 0)
+        {
+            addBlock(bytes + align);
+            std::uintptr_t base = reinterpret_cast<std::uintptr_t>(blocks.back().data);
+            start = (base + align - 1) & ~(std::uintptr_t) (align - 1);
+        }
+        std::size_t end = start + bytes - reinterpret_cast<std::uintptr_t>(blocks.back().data);
+        used += end - offset;
+        offset = end;
+        return reinterpret_cast<void *>(start);
+    }
+
+    /// Free everything allocated so far, keeping the first block for reuse
+    void reset()
+    {
+        for(std::size_t b = 1; b < blocks.size(); b++)
+            ::operator delete(blocks[b].data);
+        if(!blocks.empty())
+            blocks.resize(1);
+        offset = 0;
+        used = 0;
+    }
+
+    /// Bytes handed out since the last reset
+    std::size_t bytesUsed() const { return used; }
+
+    /// Bytes held in blocks, whether handed out or not
+    std::size_t bytesReserved() const
+    {
+        std::size_t total = 0;
+        for(const Block &b: blocks)
+            total += b.size;
+        return total;
+    }
+};
+
+/**
+ * Standard allocator drawing from an @ref Arena, so that standard containers can be used for transient
+ * data. Freeing is a no-op: memory is only reclaimed with the arena, so containers that grow repeatedly
+ * should be reserved up front.
+ */
+template<typename T>
+class ArenaAllocator
+{
+private:
+    Arena * arena;
+
+    template<typename U> friend class ArenaAllocator;
+
+public:
+    typedef T value_type;
+
+    /// Constructor, drawing from @a arena which must outlive every container using the allocator
+    explicit ArenaAllocator(Arena &arena) : arena(&arena) {}
+
+    /// Conversion between element types, sharing the arena
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T * allocate(std::size_t n)
+    {
+        return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t)
+    {
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+};
+
+namespace uts
+{
+    /// @ref uts::vector drawing from an @ref Arena
+    template<typename T>
+    using arena_vector = uts::vector<T, ArenaAllocator<T> >;
+
+    /// @ref uts::unordered_map drawing from an @ref Arena
+    template<
+        typename Key,
+        typename T,
+        typename Hash = std::hash<Key>,
+        typename KeyEqual = std::equal_to<Key> >
+    using arena_unordered_map = uts::unordered_map<Key, T, Hash, KeyEqual, ArenaAllocator<std::pair<const Key, T> > >;
+}
+
+#endif /* !UTS_COMMON_ARENA_H */
@@ -0,0 +1,239 @@
+/**
+ * @file
+ *
+ * Hash map stored in a single array, for lookup tables on hot paths.
+ */
+
+#ifndef UTS_COMMON_FLAT_MAP_H
+#define UTS_COMMON_FLAT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <functional>
+#include <utility>
+#include "debug_vector.h"
+
+/**
+ * Hash map with open addressing and Robin Hood linear probing. Entries live directly in one power-of-two sized
+ * array rather than in a node each, so building a table costs one allocation per growth and lookups touch
+ * consecutive memory. On insertion an entry displaces any entry closer to its home position, which keeps
+ * probe sequences short and lets a failed lookup stop as soon as it passes where the key would have been.
+ * Keys and values must be default constructible and copyable. Entries cannot be erased, and pointers to
+ * values are invalidated when the table grows.
+ *
+ * The hash is scrambled before use, so the identity hash of integer keys is fine.
+ */
+template<typename Key, typename T, typename Hash = std::hash<Key>, typename Alloc = std::allocator<std::pair<Key, T> > >
+class FlatMap
+{
+private:
+    /// An entry, or an empty place in the table
+    struct Slot
+    {
+        Key key;
+        T value;
+        std::uint32_t dist;  ///< one more than the distance from the home position, or 0 if empty
+    };
+
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Slot> SlotAlloc;
+
+    uts::vector<Slot, SlotAlloc> slots; ///< the table, empty until the first insertion
+    std::size_t count;                  ///< entries in use
+    Hash hash;                          ///< hash of the keys
+
+    /// Home position of a key, scrambled so that nearby keys spread over the table
+    std::size_t home(const Key &key) const
+    {
+        std::uint64_t h = (std::uint64_t) hash(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return (std::size_t) h & (slots.size() - 1);
+    }
+
+    /**
+     * Find the slot of a key
+     * @param key       key to look for
+     * @param[out] pos  slot holding the key, or where the probe stopped if it is absent
+     * @param[out] dist distance of @a pos from the home position, plus one
+     * @retval true  if the key is present,
+     * @retval false otherwise
+     */
+    bool probe(const Key &key, std::size_t &pos, std::uint32_t &dist) const
+    {
+        std::size_t mask = slots.size() - 1;
+
+        pos = home(key);
+        dist = 1;
+        // entries along the probe are at least as far from home as the key would be, or it is absent
+        while(slots[pos].dist >= dist)
+        {
+            if(slots[pos].dist == dist && slots[pos].key == key)
+                return true;
+            pos = (pos + 1) & mask;
+            dist++;
+        }
+        return false;
+    }
+
+    /**
+     * Place a key known to be absent, starting from where its probe stopped
+     * @param entry     the new entry, with its distance at @a pos
+     * @param pos       where the probe for the key stopped
+     * @return slot now holding the key
+     */
+    std::size_t place(Slot entry, std::size_t pos)
+    {
+        std::size_t mask = slots.size() - 1, result = slots.size();
+
+        while(slots[pos].dist != 0)
+        {
+            // take the place of an entry nearer its home, and carry that entry on instead
+            if(slots[pos].dist < entry.dist)
+            {
+                std::swap(slots[pos], entry);
+                if(result == slots.size())
+                    result = pos;
+            }
+            pos = (pos + 1) & mask;
+            entry.dist++;
+        }
+        slots[pos] = entry;
+        return (result == slots.size()) ? pos : result;
+    }
+
+    /// Rebuild the table with a given number of slots
+    void rehash(std::size_t size)
+    {
+        uts::vector<Slot, SlotAlloc> table(size, Slot{Key(), T(), 0}, slots.get_allocator());
+        table.swap(slots); // table now holds the old entries
+        for(Slot &s: table)
+            if(s.dist != 0)
+            {
+                // old entries are distinct, so they are placed without looking for them first
+                s.dist = 1;
+                place(s, home(s.key));
+            }
+    }
+
+public:
+    /// Constructor, with an allocator such as an ArenaAllocator for transient tables
+    explicit FlatMap(const Alloc &alloc = Alloc()) : slots(SlotAlloc(alloc)), count(0)
+    {
+    }
+
+    /// Number of entries
+    std::size_t size() const { return count; }
+
+    /// Test whether there are no entries
+    bool empty() const { return count == 0; }
+
+    /// Slots in a table with room for @a n entries, keeping the load below three quarters
+    static std::size_t tableSize(std::size_t n)
+    {
+        std::size_t size = 16;
+        while(size * 3 < n * 4)
+            size *= 2;
+        return size;
+    }
+
+    /// Bytes of the table @ref reserve allocates for @a n entries, to check memory before building a map
+    static std::size_t reserveBytes(std::size_t n)
+    {
+        return tableSize(n) * sizeof(Slot);
+    }
+
+    /// Make room for @a n entries without further growth
+    void reserve(std::size_t n)
+    {
+        std::size_t size = tableSize(n);
+        if(size > slots.size())
+            rehash(size);
+    }
+
+    /// Remove all entries, keeping the table
+    void clear()
+    {
+        for(Slot &s: slots)
+            s.dist = 0;
+        count = 0;
+    }
+
+    /**
+     * Look up a key
+     * @retval the value of the key if present,
+     * @retval NULL otherwise
+     */
+    T * find(const Key &key)
+    {
+        std::size_t pos;
+        std::uint32_t dist;
+
+        if(slots.empty() || !probe(key, pos, dist))
+            return nullptr;
+        return &slots[pos].value;
+    }
+
+    /// Look up a key, as the non-const version
+    const T * find(const Key &key) const
+    {
+        return const_cast<FlatMap *>(this)->find(key);
+    }
+
+    /**
+     * Insert a key unless it is already present
+     * @param key       key to insert
+     * @param value     value for the key if it is new
+     * @return the value stored for the key, and whether it was inserted
+     */
+    std::pair<T *, bool> insert(const Key &key, const T &value)
+    {
+        std::size_t pos;
+        std::uint32_t dist;
+
+        if((count + 1) * 4 > slots.size() * 3)
+            rehash(slots.empty() ? 16 : 2 * slots.size());
+        if(probe(key, pos, dist))
+            return std::make_pair(&slots[pos].value, false);
+        pos = place(Slot{key, value, dist}, pos);
+        count++;
+        return std::make_pair(&slots[pos].value, true);
+    }
+
+    /// Value of a key, inserting a default value if it is not present
+    T & operator[](const Key &key)
+    {
+        return * insert(key, T()).first;
+    }
+
+    /// Call f(key, value) for every entry, in table order
+    template<typename Func>
+    void forEach(Func f) const
+    {
+        for(const Slot &s: slots)
+            if(s.dist != 0)
+                f(s.key, s.value);
+    }
+
+    /// Call f(key, value) for every entry, in table order, allowing the values to be changed
+    template<typename Func>
+    void forEach(Func f)
+    {
+        for(Slot &s: slots)
+            if(s.dist != 0)
+                f(s.key, s.value);
+    }
+
+    /// Bytes held by the table
+    std::size_t bytes() const { return slots.capacity() * sizeof(Slot); }
+};
+
+namespace uts
+{
+    /// @ref FlatMap with the standard allocator, for use in place of @ref uts::unordered_map on hot paths
+    template<typename Key, typename T, typename Hash = std::hash<Key> >
+    using flat_map = FlatMap<Key, T, Hash>;
+}
+
+#endif /* !UTS_COMMON_FLAT_MAP_H */
@@ -9,6 +9,7 @@
 
 #include <limits>
 #include <cassert>
+#include <cmath>
 
 /// Tests whether @a x is a power of 2
 static inline constexpr bool isPower2(int x)
@@ -100,4 +101,41 @@ constexpr bool isPower2Ratio(T a, T b)
 
 extern template bool isPower2Ratio<float>(float, float);
 
+/**
+ * Floating-point accumulator using Neumaier's variant of Kahan summation. The rounding error of each
+ * addition is carried separately, so the result is close to correctly rounded regardless of the number
+ * or relative magnitude of the terms.
+ */
+template<typename T>
+class CompensatedSum
+{
+private:
+    T sum;          ///< running total
+    T carry;        ///< accumulated low-order error not yet reflected in sum
+
+public:
+    CompensatedSum() : sum(0), carry(0) {}
+
+    /// Add a term
+    void add(T x)
+    {
+        T t = sum + x;
+        if (std::abs(sum) >= std::abs(x))
+            carry += (sum - t) + x;
+        else
+            carry += (x - t) + sum;
+        sum = t;
+    }
+
+    /// Add the total of another accumulator, including its carried error
+    void add(const CompensatedSum<T> &other)
+    {
+        add(other.sum);
+        add(other.carry);
+    }
+
+    /// Compensated total of all terms added so far
+    T value() const { return sum + carry; }
+};
+
 #endif /* !UTS_COMMON_MATHUTILS_H */
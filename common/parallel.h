@@ -0,0 +1,112 @@
+/**
+ * @file
+ *
+ * Simple fork-join parallelism over index ranges.
+ */
+
+#ifndef UTS_COMMON_PARALLEL_H
+#define UTS_COMMON_PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+namespace parallel
+{
+
+/**
+ * Number of worker threads used by @ref forChunks when none is specified: one per hardware thread,
+ * or one if that cannot be determined.
+ */
+inline int defaultThreads()
+{
+    return std::max(1, (int) std::thread::hardware_concurrency());
+}
+
+/**
+ * Split [begin, end) into contiguous chunks and process them concurrently, returning once all are done.
+ * Chunk boundaries depend only on the range and @a numchunks, never on scheduling, so callers that
+ * combine per-chunk results in chunk order get the same answer on every run.
+ *
+ * @param begin, end    index range to process
+ * @param numchunks     number of chunks, each run on its own thread. Values below one select
+ *                      @ref defaultThreads. Never more chunks than indices are created.
+ * @param body          callable as body(chunk, first, last) processing indices [first, last)
+ * @return number of chunks actually used, so that per-chunk results can be sized beforehand with
+ *         @ref numChunks
+ */
+template<typename Body>
+int forChunks(int begin, int end, int numchunks, Body body)
+{
+    std::vector<std::thread> workers;
+    int c, count = end - begin;
+
+    if(count <= 0)
+        return 0;
+    if(numchunks < 1)
+        numchunks = defaultThreads();
+    numchunks = std::min(numchunks, count);
+
+    // the calling thread takes the first chunk rather than sitting idle
+    for(c = 1; c < numchunks; c++)
+        workers.push_back(std::thread(body, c, begin + (int) ((long long) count * c / numchunks),
+                                      begin + (int) ((long long) count * (c+1) / numchunks)));
+    body(0, begin, begin + (int) ((long long) count / numchunks));
+    for(auto &w: workers)
+        w.join();
+    return numchunks;
+}
+
+/**
+ * Number of chunks that @ref forChunks will use for a given range and requested chunk count
+ */
+inline int numChunks(int begin, int end, int numchunks)
+{
+    if(end <= begin)
+        return 0;
+    if(numchunks < 1)
+        numchunks = defaultThreads();
+    return std::min(numchunks, end - begin);
+}
+
+/**
+ * Hand out the indices [0, count) one at a time to threads that each claim the next unclaimed index until
+ * none remain, for jobs of uneven cost. Each thread runs @a worker once, so per-thread setup such as a
+ * rendering context happens outside the loop. A worker that cannot set up returns without claiming, and
+ * its share is taken by the others; indices left over because every worker gave up are returned, so
+ * that each index is either claimed or reported exactly once.
+ *
+ * @param count         number of indices to hand out
+ * @param numthreads    number of worker threads. Values below one select @ref defaultThreads.
+ *                      Never more threads than indices are created.
+ * @param worker        callable as worker(claim), where claim() returns the next unclaimed index,
+ *                      or -1 once all have been claimed
+ * @return number of indices that no worker claimed
+ */
+template<typename Worker>
+int forClaims(int count, int numthreads, Worker worker)
+{
+    std::vector<std::thread> workers;
+    std::atomic<int> next(0);
+    int t;
+
+    if(count <= 0)
+        return 0;
+    if(numthreads < 1)
+        numthreads = defaultThreads();
+    numthreads = std::min(numthreads, count);
+
+    // every claim advances the counter, including the final one by each thread that finds nothing left
+    std::function<int()> claim = [&next, count]() { int i = next++; return (i < count) ? i : -1; };
+    for(t = 0; t < numthreads; t++)
+        workers.push_back(std::thread([&worker, &claim]() { worker(claim); }));
+    for(auto &w: workers)
+        w.join();
+    return count - std::min(count, next.load());
+}
+
+} // namespace parallel
+
+#endif /* !UTS_COMMON_PARALLEL_H */
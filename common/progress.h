@@ -0,0 +1,141 @@
+/**
+ * @file
+ *
+ * Progress reporting and cancellation for long-running operations.
+ */
+
+#ifndef UTS_COMMON_PROGRESS_H
+#define UTS_COMMON_PROGRESS_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+/**
+ * Shared state between a long-running operation and whoever is waiting on it. The operation reports the
+ * fraction complete through @ref update, which also tells it whether to stop. Any thread may call
+ * @ref cancel or read @ref fraction.
+ *
+ * A listener, if given, is called on the operation's thread whenever the fraction changes by at least
+ * one thousandth, so it must be thread-safe with respect to its observers.
+ */
+class Progress
+{
+private:
+    std::atomic<bool> cancelFlag;               ///< set once a cancel has been requested
+    std::atomic<int> permille;                  ///< fraction complete in thousandths
+    std::function<void(float)> listener;        ///< notified of changes in the fraction complete
+
+    // Make non-copyable
+    Progress(const Progress &) = delete;
+    Progress &operator=(const Progress &) = delete;
+
+public:
+    /// Constructor, with an optional listener for changes in the fraction complete
+    explicit Progress(std::function<void(float)> listener = nullptr)
+        : cancelFlag(false), permille(0), listener(std::move(listener))
+    {
+    }
+
+    /// Request that the operation stop at its next check. Thread-safe.
+    void cancel()
+    {
+        cancelFlag.store(true, std::memory_order_relaxed);
+    }
+
+    /// Test whether a cancel has been requested. Thread-safe.
+    bool cancelled() const
+    {
+        return cancelFlag.load(std::memory_order_relaxed);
+    }
+
+    /// Fraction of the operation completed, in [0,1]. Thread-safe.
+    float fraction() const
+    {
+        return (float) permille.load(std::memory_order_relaxed) / 1000.0f;
+    }
+
+    /**
+     * Report the fraction of the operation completed
+     * @param done  fraction complete, in [0,1]
+     * @retval true if the operation should continue,
+     * @retval false if it has been cancelled
+     */
+    bool update(float done)
+    {
+        int p = (int) (done * 1000.0f);
+        if (permille.exchange(p, std::memory_order_relaxed) != p && listener)
+            listener(done);
+        return !cancelled();
+    }
+};
+
+/**
+ * One stage of a long-running operation, mapping the stage's own fraction complete onto a part of an
+ * overall @ref Progress, so that a stage need not know where it falls in the whole. Stages split further
+ * with @ref sub. A range without a progress reports nothing and is never cancelled.
+ *
+ * Loops call @ref check on every step, which only touches the shared state at chunk boundaries, so the
+ * cost is a comparison per step and cancellation is seen within one chunk of work.
+ */
+class ProgressRange
+{
+private:
+    Progress * progress;    ///< overall progress, may be NULL
+    float begin;            ///< overall fraction at the start of the stage
+    float end;              ///< overall fraction at the end of the stage
+
+public:
+    static const long defaultInterval = 4096; ///< steps between checks, a few milliseconds at most of mesh processing
+
+    /**
+     * Constructor
+     * @param progress  overall progress, or NULL to report nothing
+     * @param begin     overall fraction complete when this stage starts
+     * @param end       overall fraction complete when this stage ends
+     */
+    ProgressRange(Progress * progress = NULL, float begin = 0.0f, float end = 1.0f)
+        : progress(progress), begin(begin), end(end)
+    {
+    }
+
+    /// The part of this stage from fraction @a from to fraction @a to of it
+    ProgressRange sub(float from, float to) const
+    {
+        return ProgressRange(progress, begin + from * (end - begin), begin + to * (end - begin));
+    }
+
+    /// Test whether a cancel has been requested. Thread-safe.
+    bool cancelled() const
+    {
+        return progress != NULL && progress->cancelled();
+    }
+
+    /**
+     * Report the fraction of this stage completed
+     * @param done  fraction complete, in [0,1]
+     * @retval true if the operation should continue,
+     * @retval false if it has been cancelled
+     */
+    bool update(float done) const
+    {
+        return progress == NULL || progress->update(begin + done * (end - begin));
+    }
+
+    /**
+     * Report progress through a loop, at chunk boundaries only
+     * @param step      current step
+     * @param total     number of steps in this stage
+     * @param interval  steps between reports
+     * @retval true if the operation should continue,
+     * @retval false if it has been cancelled
+     */
+    bool check(long step, long total, long interval = defaultInterval) const
+    {
+        if (progress == NULL || step % interval != 0)
+            return true;
+        return update((total > 0) ? (float) step / (float) total : 1.0f);
+    }
+};
+
+#endif /* !UTS_COMMON_PROGRESS_H */
@@ -5,6 +5,8 @@
  */
 
 #include <mutex>
+#include <algorithm>
+#include "debug_vector.h"
 #include "stats.h"
 
 namespace stats
@@ -26,11 +28,430 @@ std::mutex &getStatsPrintMutex()
     return statsPrintMutex;
 }
 
+thread_local SlotBlock *threadSlots = nullptr;
+
+/// Slots at the top of the range that absorb updates to counters that could not be allocated
+static constexpr std::size_t discardSlots = Histogram::numBuckets + 2;
+
+/// Blocks of counter slots, and the counters registered for @ref reportStats
+struct SlotRegistry
+{
+    std::mutex mutex;
+    uts::vector<SlotBlock *> blocks;        ///< Every block ever created
+    uts::vector<SlotBlock *> freeBlocks;    ///< Blocks of threads that have exited
+    std::size_t nextSlot = 0;
+    uts::vector<std::pair<std::size_t, std::size_t> > freeSlots; ///< First slot and count of released ranges
+    uts::vector<const Counter *> counters;
+    uts::vector<const Histogram *> histograms;
+    uts::vector<const MemoryAccount *> accounts;
+};
+
+static SlotRegistry &getSlotRegistry()
+{
+    /* This is wrapped into a function to give predictable initialization
+     * order when a Counter is declared at file scope. It is never destroyed,
+     * since counters held by other statics unregister during exit.
+     */
+    static SlotRegistry *registry = new SlotRegistry();
+    return *registry;
+}
+
+/// Returns the block of a thread to the registry when the thread exits
+struct SlotBlockRelease
+{
+    ~SlotBlockRelease()
+    {
+        if (threadSlots != nullptr)
+        {
+            SlotRegistry &registry = getSlotRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.freeBlocks.push_back(threadSlots);
+            threadSlots = nullptr;
+        }
+    }
+};
+
+std::atomic<std::uint64_t> &getSlotSlow(std::size_t slot)
+{
+    if (threadSlots == nullptr)
+    {
+        thread_local SlotBlockRelease release;
+        (void) release;
+
+        SlotRegistry &registry = getSlotRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if (registry.freeBlocks.empty())
+        {
+            SlotBlock *block = new SlotBlock();
+            for (std::size_t c = 0; c < maxChunks; c++)
+                block->chunks[c].store(nullptr, std::memory_order_relaxed);
+            registry.blocks.push_back(block);
+            threadSlots = block;
+        }
+        else
+        {
+            threadSlots = registry.freeBlocks.back();
+            registry.freeBlocks.pop_back();
+        }
+    }
+
+    std::atomic<SlotChunk *> &chunk = threadSlots->chunks[slot / slotsPerChunk];
+    if (chunk.load(std::memory_order_relaxed) == nullptr)
+    {
+        SlotChunk *fresh = new SlotChunk();
+        for (std::size_t s = 0; s < slotsPerChunk; s++)
+            fresh->slots[s].store(0, std::memory_order_relaxed);
+        chunk.store(fresh, std::memory_order_release);
+    }
+    return chunk.load(std::memory_order_relaxed)->slots[slot % slotsPerChunk];
+}
+
+std::size_t allocateSlots(std::size_t count)
+{
+    SlotRegistry &registry = getSlotRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    const std::size_t capacity = slotsPerChunk * maxChunks - discardSlots;
+
+    for (std::size_t i = 0; i < registry.freeSlots.size(); i++)
+        if (registry.freeSlots[i].second == count)
+        {
+            std::size_t first = registry.freeSlots[i].first;
+            registry.freeSlots.erase(registry.freeSlots.begin() + i);
+            return first;
+        }
+    if (registry.nextSlot + count > capacity)
+    {
+        std::cerr << "Error stats::allocateSlots: out of counter slots, updates will be discarded" << std::endl;
+        return capacity;
+    }
+    std::size_t first = registry.nextSlot;
+    registry.nextSlot += count;
+    return first;
+}
+
+void releaseSlots(std::size_t first, std::size_t count)
+{
+    SlotRegistry &registry = getSlotRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    if (first >= slotsPerChunk * maxChunks - discardSlots) // the discard range is shared
+        return;
+    for (SlotBlock *block : registry.blocks)
+        for (std::size_t slot = first; slot < first + count; slot++)
+        {
+            SlotChunk *chunk = block->chunks[slot / slotsPerChunk].load(std::memory_order_acquire);
+            if (chunk != nullptr)
+                chunk->slots[slot % slotsPerChunk].store(0, std::memory_order_relaxed);
+        }
+    registry.freeSlots.push_back(std::make_pair(first, count));
+}
+
+/// Apply a function to the value of a slot in every thread
+template<typename Func>
+static void forEachSlot(std::size_t slot, Func func)
+{
+    SlotRegistry &registry = getSlotRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    for (SlotBlock *block : registry.blocks)
+    {
+        const SlotChunk *chunk = block->chunks[slot / slotsPerChunk].load(std::memory_order_acquire);
+        if (chunk != nullptr)
+            func(chunk->slots[slot % slotsPerChunk].load(std::memory_order_relaxed));
+    }
+}
+
+std::uint64_t sumSlot(std::size_t slot)
+{
+    std::uint64_t total = 0;
+    forEachSlot(slot, [&total](std::uint64_t value) { total += value; });
+    return total;
+}
+
+std::uint64_t maxSlotAll(std::size_t slot)
+{
+    std::uint64_t largest = 0;
+    forEachSlot(slot, [&largest](std::uint64_t value) { largest = std::max(largest, value); });
+    return largest;
+}
+
+/// Add or remove an entry in a list of registered counters
+template<typename T>
+static void registerStat(uts::vector<const T *> SlotRegistry::*list, const T *stat, bool add)
+{
+    SlotRegistry &registry = getSlotRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    uts::vector<const T *> &entries = registry.*list;
+
+    if (add)
+        entries.push_back(stat);
+    else
+        entries.erase(std::remove(entries.begin(), entries.end(), stat), entries.end());
+}
+
+static std::atomic<std::int64_t> memoryTotal(0);   ///< Bytes held over all accounts
+static std::atomic<std::int64_t> memoryPeak(0);    ///< Most bytes held over all accounts at once
+static std::atomic<std::int64_t> memoryBudget(0);  ///< Limit set by @ref setMemoryBudget
+
+/// Order counters by name for @ref reportStats
+static bool counterLess(const Counter *a, const Counter *b)
+{
+    return a->name() < b->name();
+}
+
+/// Order histograms by name for @ref reportStats
+static bool histogramLess(const Histogram *a, const Histogram *b)
+{
+    return a->name() < b->name();
+}
+
+/// Order memory accounts by name for @ref reportStats
+static bool accountLess(const MemoryAccount *a, const MemoryAccount *b)
+{
+    return a->name() < b->name();
+}
+
+/// Raise a peak to at least a value
+static void raisePeak(std::atomic<std::int64_t> &peak, std::int64_t value)
+{
+    std::int64_t old = peak.load(std::memory_order_relaxed);
+    while (value > old && !peak.compare_exchange_weak(old, value, std::memory_order_relaxed))
+    {
+    }
+}
+
 } // namespace detail
 
 void enableStats(bool enabled)
 {
-    detail::statsEnabled = true;
+    detail::statsEnabled = enabled;
+}
+
+Counter::Counter(const uts::string &name) : name_(name), slot(detail::allocateSlots(1))
+{
+    detail::registerStat(&detail::SlotRegistry::counters, this, true);
+}
+
+Counter::~Counter()
+{
+    detail::registerStat(&detail::SlotRegistry::counters, this, false);
+    detail::releaseSlots(slot, 1);
+}
+
+const uts::string &Counter::name() const
+{
+    return name_;
+}
+
+std::uint64_t Counter::total() const
+{
+    return detail::sumSlot(slot);
+}
+
+Histogram::Histogram(const uts::string &name) : name_(name), slot(detail::allocateSlots(numBuckets + 2))
+{
+    detail::registerStat(&detail::SlotRegistry::histograms, this, true);
+}
+
+Histogram::~Histogram()
+{
+    detail::registerStat(&detail::SlotRegistry::histograms, this, false);
+    detail::releaseSlots(slot, numBuckets + 2);
+}
+
+const uts::string &Histogram::name() const
+{
+    return name_;
+}
+
+std::uint64_t Histogram::bucketMax(int bucket)
+{
+    if (bucket < subBuckets)
+        return (std::uint64_t) bucket;
+    int shift = bucket / subBuckets - 1;
+    std::uint64_t next = (std::uint64_t) (subBuckets + bucket % subBuckets) + 1;
+    if (shift == 60 && next == 2 * subBuckets) // the last bucket ends at the largest value
+        return ~std::uint64_t(0);
+    return (next << shift) - 1;
+}
+
+std::uint64_t Histogram::count() const
+{
+    std::uint64_t total = 0;
+    for (int b = 0; b < numBuckets; b++)
+        total += detail::sumSlot(slot + b);
+    return total;
+}
+
+std::uint64_t Histogram::sum() const
+{
+    return detail::sumSlot(slot + numBuckets);
+}
+
+std::uint64_t Histogram::max() const
+{
+    return detail::maxSlotAll(slot + numBuckets + 1);
+}
+
+std::uint64_t Histogram::quantile(double q) const
+{
+    uts::vector<std::uint64_t> counts(numBuckets);
+    std::uint64_t total = 0, seen = 0;
+
+    for (int b = 0; b < numBuckets; b++)
+    {
+        counts[b] = detail::sumSlot(slot + b);
+        total += counts[b];
+    }
+    if (total == 0)
+        return 0;
+
+    // rank of the sample wanted, counting from one
+    q = std::min(1.0, std::max(0.0, q));
+    std::uint64_t rank = std::max<std::uint64_t>(1, (std::uint64_t) (q * (double) total + 0.999999));
+    for (int b = 0; b < numBuckets; b++)
+    {
+        seen += counts[b];
+        if (seen >= rank)
+            return std::min(bucketMax(b), max());
+    }
+    return max();
+}
+
+MemoryAccount::MemoryAccount(const uts::string &name) : name_(name), bytes_(0), peak_(0)
+{
+    detail::registerStat(&detail::SlotRegistry::accounts, this, true);
+}
+
+MemoryAccount::~MemoryAccount()
+{
+    detail::registerStat(&detail::SlotRegistry::accounts, this, false);
+}
+
+const uts::string &MemoryAccount::name() const
+{
+    return name_;
+}
+
+void MemoryAccount::add(std::int64_t bytes)
+{
+    detail::raisePeak(peak_, bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    detail::raisePeak(detail::memoryPeak, detail::memoryTotal.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+std::int64_t MemoryAccount::bytes() const
+{
+    return bytes_.load(std::memory_order_relaxed);
+}
+
+std::int64_t MemoryAccount::peak() const
+{
+    return peak_.load(std::memory_order_relaxed);
+}
+
+MemoryCharge::MemoryCharge() : account(nullptr), bytes(0)
+{
+}
+
+MemoryCharge::MemoryCharge(const MemoryCharge &other) : account(nullptr), bytes(0)
+{
+    if (other.account != nullptr)
+        set(*other.account, other.bytes);
+}
+
+MemoryCharge &MemoryCharge::operator=(const MemoryCharge &other)
+{
+    if (this != &other)
+    {
+        release();
+        if (other.account != nullptr)
+            set(*other.account, other.bytes);
+    }
+    return *this;
+}
+
+MemoryCharge::~MemoryCharge()
+{
+    release();
+}
+
+void MemoryCharge::set(MemoryAccount &account, std::int64_t bytes)
+{
+    if (this->account != nullptr && this->account != &account)
+        release();
+    this->account = &account;
+    account.add(bytes - this->bytes);
+    this->bytes = bytes;
+}
+
+void MemoryCharge::release()
+{
+    if (account != nullptr)
+        account->add(-bytes);
+    bytes = 0;
+}
+
+void setMemoryBudget(std::int64_t bytes)
+{
+    detail::memoryBudget = bytes;
+}
+
+std::int64_t getMemoryBudget()
+{
+    return detail::memoryBudget.load(std::memory_order_relaxed);
+}
+
+std::int64_t memoryInUse()
+{
+    return detail::memoryTotal.load(std::memory_order_relaxed);
+}
+
+bool fitsMemoryBudget(std::int64_t bytes)
+{
+    std::int64_t budget = getMemoryBudget();
+    return budget <= 0 || memoryInUse() + bytes <= budget;
+}
+
+void reportStats()
+{
+    if (!detail::getStatsEnabled())
+        return;
+
+    uts::vector<const Counter *> counters;
+    uts::vector<const Histogram *> histograms;
+    uts::vector<const MemoryAccount *> accounts;
+    {
+        detail::SlotRegistry &registry = detail::getSlotRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        counters = registry.counters;
+        histograms = registry.histograms;
+        accounts = registry.accounts;
+    }
+
+    std::sort(counters.begin(), counters.end(), detail::counterLess);
+    std::sort(histograms.begin(), histograms.end(), detail::histogramLess);
+    std::sort(accounts.begin(), accounts.end(), detail::accountLess);
+    for (const Counter *c : counters)
+        printStat(c->name(), c->total());
+    for (const Histogram *h : histograms)
+    {
+        std::uint64_t count = h->count();
+        printStat(h->name() + ".count", count);
+        if (count == 0)
+            continue;
+        printStat(h->name() + ".mean", (double) h->sum() / (double) count);
+        printStat(h->name() + ".p50", h->quantile(0.50));
+        printStat(h->name() + ".p95", h->quantile(0.95));
+        printStat(h->name() + ".p99", h->quantile(0.99));
+        printStat(h->name() + ".max", h->max());
+    }
+    for (const MemoryAccount *a : accounts)
+    {
+        printStat(a->name() + ".bytes", a->bytes());
+        printStat(a->name() + ".peak", a->peak());
+    }
+    printStat("memory.total.bytes", memoryInUse());
+    printStat("memory.total.peak", detail::memoryPeak.load(std::memory_order_relaxed));
 }
 
 } // namespace stats
@@ -10,6 +10,9 @@
 #include <iostream>
 #include <mutex>
 #include <utility>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
 #include "debug_string.h"
 
 /// Utilities for collecting execution statistics.
@@ -41,8 +44,289 @@ std::mutex &getStatsPrintMutex();
 
 bool getStatsEnabled();
 
+/// Number of counter slots allocated together in each thread
+static constexpr std::size_t slotsPerChunk = 512;
+/// Maximum number of chunks of slots, so that counters can use at most slotsPerChunk * maxChunks slots
+static constexpr std::size_t maxChunks = 64;
+
+/// A group of counter slots, allocated by the thread that owns it on first use
+struct SlotChunk
+{
+    std::atomic<std::uint64_t> slots[slotsPerChunk];
+};
+
+/**
+ * Counter slots belonging to one thread. Only the owning thread writes to
+ * them, so updates need no atomic read-modify-write; other threads only read
+ * them to form totals. When a thread exits its block is handed on to the next
+ * new thread rather than freed, so counts are never lost and the number of
+ * blocks is bounded by the number of threads alive at once.
+ */
+struct SlotBlock
+{
+    std::atomic<SlotChunk *> chunks[maxChunks];
+};
+
+extern thread_local SlotBlock *threadSlots; ///< Block owned by this thread, if it has one yet
+
+/**
+ * Slow path of @ref getSlot, which claims a block for the thread and
+ * allocates the chunk containing the slot.
+ */
+std::atomic<std::uint64_t> &getSlotSlow(std::size_t slot);
+
+/**
+ * Returns this thread's copy of a counter slot.
+ */
+inline std::atomic<std::uint64_t> &getSlot(std::size_t slot)
+{
+    SlotBlock *block = threadSlots;
+    if (block != nullptr)
+    {
+        SlotChunk *chunk = block->chunks[slot / slotsPerChunk].load(std::memory_order_relaxed);
+        if (chunk != nullptr)
+            return chunk->slots[slot % slotsPerChunk];
+    }
+    return getSlotSlow(slot);
+}
+
+/**
+ * Add to this thread's copy of a counter slot.
+ */
+inline void addSlot(std::size_t slot, std::uint64_t value)
+{
+    std::atomic<std::uint64_t> &s = getSlot(slot);
+    s.store(s.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+/**
+ * Raise this thread's copy of a counter slot to at least a value.
+ */
+inline void maxSlot(std::size_t slot, std::uint64_t value)
+{
+    std::atomic<std::uint64_t> &s = getSlot(slot);
+    if (value > s.load(std::memory_order_relaxed))
+        s.store(value, std::memory_order_relaxed);
+}
+
+/**
+ * Reserve a range of slots, which are zero in every thread.
+ * @param count     number of slots needed
+ * @return index of the first slot
+ */
+std::size_t allocateSlots(std::size_t count);
+
+/**
+ * Return a range of slots from @ref allocateSlots for reuse, zeroing them in
+ * every thread. Nothing may update the slots once they are released.
+ * @param first     index of the first slot
+ * @param count     number of slots, as allocated
+ */
+void releaseSlots(std::size_t first, std::size_t count);
+
+/**
+ * Sum a slot over all threads.
+ */
+std::uint64_t sumSlot(std::size_t slot);
+
+/**
+ * Largest value of a slot over all threads.
+ */
+std::uint64_t maxSlotAll(std::size_t slot);
+
 } // namespace detail
 
+/**
+ * An event count that is cheap to update from many threads at once. Each
+ * thread adds to its own copy, and the copies are summed when the total is
+ * read, so there is no shared cache line or lock on the hot path. Like a
+ * @ref TimeInit it is intended to be declared at file scope, and registers
+ * itself for @ref reportStats. Its slots are released for reuse when it is
+ * destroyed.
+ */
+class Counter
+{
+private:
+    uts::string name_;
+    std::size_t slot;
+
+    // Make non-copyable
+    Counter(const Counter &) = delete;
+    Counter &operator=(const Counter &) = delete;
+
+public:
+    explicit Counter(const uts::string &name);
+    ~Counter();
+
+    const uts::string &name() const;
+
+    /// Add to the count
+    void add(std::uint64_t value = 1)
+    {
+        detail::addSlot(slot, value);
+    }
+
+    /// Total over all threads. Concurrent updates may or may not be included.
+    std::uint64_t total() const;
+};
+
+/**
+ * Distribution of non-negative integer samples, updated like a @ref Counter.
+ * Values below 8 have their own buckets, and above that each power of two is
+ * split into 8 buckets, so quantiles are accurate to within 12.5% over the
+ * whole range of a 64-bit value.
+ */
+class Histogram
+{
+public:
+    static constexpr int subBuckets = 8;                  ///< Buckets per power of two
+    static constexpr int numBuckets = subBuckets * 62;    ///< Buckets needed for any 64-bit value
+
+private:
+    uts::string name_;
+    std::size_t slot;   ///< Bucket counts followed by the sum and the maximum
+
+    // Make non-copyable
+    Histogram(const Histogram &) = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+public:
+    explicit Histogram(const uts::string &name);
+    ~Histogram();
+
+    const uts::string &name() const;
+
+    /// Bucket holding a value
+    static int bucket(std::uint64_t value)
+    {
+        if (value < (std::uint64_t) subBuckets)
+            return (int) value;
+        int msb = 63;
+        while (!(value >> msb))
+            msb--;
+        int shift = msb - 3;
+        return (shift + 1) * subBuckets + (int) ((value >> shift) & (subBuckets - 1));
+    }
+
+    /// Largest value held in a bucket
+    static std::uint64_t bucketMax(int bucket);
+
+    /// Record a sample
+    void add(std::uint64_t value)
+    {
+        detail::addSlot(slot + bucket(value), 1);
+        detail::addSlot(slot + numBuckets, value);
+        detail::maxSlot(slot + numBuckets + 1, value);
+    }
+
+    std::uint64_t count() const;    ///< Number of samples
+    std::uint64_t sum() const;      ///< Sum of all samples
+    std::uint64_t max() const;      ///< Largest sample
+
+    /**
+     * Estimate a quantile, as the upper end of the bucket holding it but no
+     * more than the largest sample.
+     * @param q     fraction of samples at or below the result, in [0, 1]
+     * @return the quantile, or 0 if there are no samples
+     */
+    std::uint64_t quantile(double q) const;
+};
+
+/**
+ * Bytes held by one subsystem, such as mesh vertices or GPU buffers, and the
+ * most it has held at once. Every account also adds to a process-wide total
+ * which is checked against the budget set by @ref setMemoryBudget. Updates
+ * are rare compared to counter updates, so they are shared atomics. Like a
+ * @ref Counter it is intended to be declared at file scope.
+ */
+class MemoryAccount
+{
+private:
+    uts::string name_;
+    std::atomic<std::int64_t> bytes_;
+    std::atomic<std::int64_t> peak_;
+
+    // Make non-copyable
+    MemoryAccount(const MemoryAccount &) = delete;
+    MemoryAccount &operator=(const MemoryAccount &) = delete;
+
+public:
+    explicit MemoryAccount(const uts::string &name);
+    ~MemoryAccount();
+
+    const uts::string &name() const;
+
+    /// Add to the bytes held, or release them if negative
+    void add(std::int64_t bytes);
+
+    std::int64_t bytes() const;     ///< Bytes currently held
+    std::int64_t peak() const;      ///< Most bytes held at once
+};
+
+/**
+ * Bytes charged to a @ref MemoryAccount by one object, released when the
+ * object is destroyed. A copy charges the same bytes again, since the data it
+ * stands for is copied with it.
+ */
+class MemoryCharge
+{
+private:
+    MemoryAccount *account;
+    std::int64_t bytes;
+
+public:
+    MemoryCharge();
+    MemoryCharge(const MemoryCharge &other);
+    MemoryCharge &operator=(const MemoryCharge &other);
+    ~MemoryCharge();
+
+    /**
+     * Replace the charge, adjusting the accounts by the difference
+     * @param account   account to charge, which should not change over the life of the charge
+     * @param bytes     bytes now held
+     */
+    void set(MemoryAccount &account, std::int64_t bytes);
+
+    /// Release the whole charge
+    void release();
+};
+
+/**
+ * Set a limit on the total bytes held across all memory accounts, checked by
+ * @ref fitsMemoryBudget before large allocations.
+ * @param bytes     limit, or 0 for no limit
+ */
+void setMemoryBudget(std::int64_t bytes);
+
+/**
+ * Returns the value set by @ref setMemoryBudget.
+ */
+std::int64_t getMemoryBudget();
+
+/**
+ * Total bytes currently held across all memory accounts.
+ */
+std::int64_t memoryInUse();
+
+/**
+ * Check whether an allocation would keep the total within the memory budget.
+ * @param bytes     size of the allocation about to be made
+ * @retval true  if there is no budget or the allocation fits within it,
+ * @retval false otherwise
+ */
+bool fitsMemoryBudget(std::int64_t bytes);
+
+/**
+ * Print every registered @ref Counter, @ref Histogram and @ref MemoryAccount
+ * with @ref printStat, in order of name. Histograms print their count, mean,
+ * 50th, 95th and 99th percentiles and maximum as separate statistics suffixed
+ * by .count, .mean, .p50, .p95, .p99 and .max. Memory accounts print their
+ * current and peak bytes suffixed by .bytes and .peak, followed by the same
+ * for the total over all accounts as memory.total. Nothing is printed unless
+ * statistics are enabled.
+ */
+void reportStats();
+
 /**
  * Enable recording of statistics with @ref print and @ref printStat.
  * @warning The enable flag is not thread-safe. It should be initialized before
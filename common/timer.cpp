@@ -10,6 +10,9 @@
 #include <memory>
 #include <thread>
 #include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
 #include "debug_string.h"
 #include "debug_vector.h"
 #include "timer.h"
@@ -21,7 +24,7 @@ namespace stats
 namespace detail
 {
 
-static bool timersEnabled = false;    ///< Whether timers were enabled by @ref enableTimers
+static std::atomic<bool> timersEnabled(false); ///< Whether timers were enabled by @ref enableTimers, toggled while workers time spans
 
 static uts::vector<std::shared_ptr<Time> > &getTimesRaw()
 {
@@ -39,16 +42,86 @@ static std::mutex &getTimesMutex()
     return timesMutex;
 }
 
+static bool tracingEnabled = false;   ///< Whether tracing was enabled by @ref enableTracing
+static clock_type::time_point traceOrigin; ///< Time at which tracing was enabled
+
+static thread_local int spanDepth = 0; ///< Number of open spans on this thread
+
+/// A completed @ref Span
+struct TraceEvent
+{
+    std::shared_ptr<Time> time;
+    clock_type::time_point start;
+    clock_type::duration elapsed;
+    int depth;
+};
+
+/**
+ * Events recorded by one thread. The mutex is only contended while the trace
+ * is being written.
+ */
+struct ThreadTrace
+{
+    std::mutex mutex;
+    uts::vector<TraceEvent> events;
+    int tid;
+};
+
+static uts::vector<std::shared_ptr<ThreadTrace> > &getTracesRaw()
+{
+    // See comment in getTimesRaw
+    static uts::vector<std::shared_ptr<ThreadTrace> > traces;
+    return traces;
+}
+
+static std::mutex &getTracesMutex()
+{
+    static std::mutex tracesMutex;
+    return tracesMutex;
+}
+
+/**
+ * Returns the event buffer for the calling thread, registering it on first
+ * use. The registry keeps it alive after the thread exits.
+ */
+static ThreadTrace &getThreadTrace()
+{
+    thread_local std::shared_ptr<ThreadTrace> trace;
+    if (!trace)
+    {
+        trace = std::make_shared<ThreadTrace>();
+        std::lock_guard<std::mutex> lock(getTracesMutex());
+        auto &traces = getTracesRaw();
+        trace->tid = traces.size() + 1;
+        traces.push_back(trace);
+    }
+    return *trace;
+}
+
+/// Write a string as a JSON string literal
+static void writeJSONString(std::ostream &out, const uts::string &s)
+{
+    out << '"';
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if ((unsigned char) c >= 0x20)
+            out << c;
+    }
+    out << '"';
+}
+
 } // namespace detail
 
 void enableTimers(bool enable)
 {
-    detail::timersEnabled = enable;
+    detail::timersEnabled.store(enable, std::memory_order_relaxed);
 }
 
 bool isTimingEnabled()
 {
-    return detail::timersEnabled;
+    return detail::timersEnabled.load(std::memory_order_relaxed);
 }
 
 uts::vector<std::shared_ptr<Time> > getTimes()
@@ -79,13 +152,20 @@ void reportTimes()
         {
             std::chrono::duration<double> t = p->total();
             printAlways("TOTAL,", p->name(), ",", t.count(), ",", p->times(), "\n");
+            const Histogram *latency = p->latency();
+            if (latency != nullptr && latency->count() > 0)
+                printAlways("LATENCY,", p->name(), ",", latency->quantile(0.50) * 1e-6, ",",
+                            latency->quantile(0.95) * 1e-6, ",", latency->quantile(0.99) * 1e-6, ",",
+                            latency->max() * 1e-6, "\n");
         }
     }
 }
 
 
-Time::Time(const uts::string &name) : name_(name), ticks_(0), times_(0)
+Time::Time(const uts::string &name, bool latency) : name_(name), ticks_(0), times_(0)
 {
+    if (latency)
+        latency_.reset(new Histogram(name + ".latency_us"));
 }
 
 const uts::string &Time::name() const
@@ -103,21 +183,28 @@ std::uint64_t Time::times() const
     return times_.load(std::memory_order_relaxed);
 }
 
+const Histogram *Time::latency() const
+{
+    return latency_.get();
+}
+
 Time &Time::operator+=(const clock_type::duration &add)
 {
     ticks_.fetch_add(add.count(), std::memory_order_relaxed);
     times_.fetch_add(1, std::memory_order_relaxed);
+    if (latency_)
+        latency_->add(std::chrono::duration_cast<std::chrono::microseconds>(add).count());
     return *this;
 }
 
 
-TimeInit::TimeInit(const uts::string &name)
+TimeInit::TimeInit(const uts::string &name, bool latency)
 {
     auto &times = detail::getTimesRaw();
     std::mutex &mutex = detail::getTimesMutex();
 
     std::lock_guard<std::mutex> lock(mutex);
-    times.push_back(std::make_shared<Time>(name));
+    times.push_back(std::make_shared<Time>(name, latency));
     time = times.back();
 }
 
@@ -153,13 +240,13 @@ void TimerBase::doneDouble(double elapsed)
 
 Timer::Timer(const TimeInit &t, double *out) :
     TimerBase(t, out),
-    start(detail::timersEnabled ? clock_type::now() : clock_type::time_point())
+    start(isTimingEnabled() ? clock_type::now() : clock_type::time_point())
 {
 }
 
 Timer::Timer(const std::shared_ptr<Time> &t, double *out) :
     TimerBase(t, out),
-    start(detail::timersEnabled ? clock_type::now() : clock_type::time_point())
+    start(isTimingEnabled() ? clock_type::now() : clock_type::time_point())
 {
 }
 
@@ -174,7 +261,7 @@ Timer::Timer(Timer &&other) : TimerBase(std::move(other))
 
 void Timer::stop()
 {
-    if (detail::timersEnabled && start != clock_type::time_point())
+    if (isTimingEnabled() && start != clock_type::time_point())
     {
         auto end = clock_type::now();
         clock_type::duration elapsed = end - start;
@@ -188,4 +275,100 @@ Timer::~Timer()
     stop();
 }
 
+Span::Span(const TimeInit &t) : Span(t.time.lock())
+{
+}
+
+Span::Span(const std::shared_ptr<Time> &t) :
+    time(t),
+    start(),
+    depth(0)
+{
+    if (isTimingEnabled() || detail::tracingEnabled)
+    {
+        start = clock_type::now();
+        depth = detail::spanDepth++;
+    }
+}
+
+void Span::stop()
+{
+    if (start != clock_type::time_point())
+    {
+        clock_type::duration elapsed = clock_type::now() - start;
+        detail::spanDepth--;
+        if (time)
+        {
+            *time += elapsed;
+            if (detail::tracingEnabled)
+            {
+                detail::ThreadTrace &trace = detail::getThreadTrace();
+                std::lock_guard<std::mutex> lock(trace.mutex);
+                trace.events.push_back(detail::TraceEvent{time, start, elapsed, depth});
+            }
+        }
+        start = clock_type::time_point(); // mark as stopped
+    }
+}
+
+Span::~Span()
+{
+    stop();
+}
+
+void enableTracing(bool enable)
+{
+    if (enable && !detail::tracingEnabled)
+        detail::traceOrigin = clock_type::now();
+    detail::tracingEnabled = enable;
+}
+
+bool isTracingEnabled()
+{
+    return detail::tracingEnabled;
+}
+
+bool writeTrace(const uts::string &filename)
+{
+    uts::vector<std::shared_ptr<detail::ThreadTrace> > traces;
+    {
+        std::lock_guard<std::mutex> lock(detail::getTracesMutex());
+        traces = detail::getTracesRaw();
+    }
+
+    std::ofstream out(filename.c_str());
+    if (!out)
+        return false;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (const auto &trace : traces)
+    {
+        std::lock_guard<std::mutex> lock(trace->mutex);
+        for (const detail::TraceEvent &e : trace->events)
+        {
+            std::chrono::duration<double, std::micro> ts = e.start - detail::traceOrigin;
+            std::chrono::duration<double, std::micro> dur = e.elapsed;
+            out << (first ? "\n" : ",\n") << "{\"name\": ";
+            detail::writeJSONString(out, e.time->name());
+            out << ", \"cat\": \"span\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << trace->tid
+                << ", \"ts\": " << ts.count() << ", \"dur\": " << dur.count()
+                << ", \"args\": {\"depth\": " << e.depth << "}}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return (bool) out;
+}
+
+void clearTrace()
+{
+    std::lock_guard<std::mutex> lock(detail::getTracesMutex());
+    for (const auto &trace : detail::getTracesRaw())
+    {
+        std::lock_guard<std::mutex> traceLock(trace->mutex);
+        trace->events.clear();
+    }
+}
+
 } // namespace stats
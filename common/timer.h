@@ -13,6 +13,7 @@
 #include <memory>
 #include <atomic>
 #include "debug_vector.h"
+#include "stats.h"
 
 namespace stats
 {
@@ -25,25 +26,33 @@ typedef std::conditional<
 
 /**
  * Keeps track of total accumulated time. It supports atomic increment of
- * elapsed time.
+ * elapsed time. It can also keep the distribution of the individual samples,
+ * for operations such as drawing a frame where the worst cases matter more
+ * than the total.
  */
 class Time
 {
 public:
     static_assert(std::is_integral<clock_type::duration::rep>::value, "Duration type must be integral to use atomics");
 
-    /// Initializes with zero total time
-    explicit Time(const uts::string &name);
+    /**
+     * Initializes with zero total time
+     * @param name      name for reports
+     * @param latency   whether to keep a histogram of the samples
+     */
+    explicit Time(const uts::string &name, bool latency = false);
 
     const uts::string &name() const;
     clock_type::duration total() const;  ///< Total duration of all uses
     std::uint64_t times() const;         ///< Number of times called
+    const Histogram *latency() const;    ///< Samples in microseconds, or @c nullptr if not kept
     Time &operator+=(const clock_type::duration &add); ///< Add a new sample
 
 private:
     uts::string name_;
     std::atomic<clock_type::duration::rep> ticks_;
     std::atomic<std::uint64_t> times_;
+    std::unique_ptr<Histogram> latency_;
 };
 
 /**
@@ -54,11 +63,16 @@ private:
 class TimeInit
 {
     friend class TimerBase;
+    friend class Span;
 private:
     std::weak_ptr<Time> time;
 
 public:
-    explicit TimeInit(const uts::string &name);
+    /**
+     * @param name      name for reports
+     * @param latency   whether to keep a histogram of the samples, see @ref Time
+     */
+    explicit TimeInit(const uts::string &name, bool latency = false);
 };
 
 /**
@@ -124,11 +138,79 @@ public:
     ~Timer();
 };
 
+/**
+ * Timer for one phase of a larger operation. Like @ref Timer it measures its
+ * own lifetime (or until @ref stop) and accumulates into a @ref Time, but it
+ * prints nothing, so it is cheap enough to leave in library code and the
+ * totals are read back with @ref reportTimes. It is a no-op unless timers
+ * or tracing are enabled.
+ *
+ * Spans nest: each thread keeps the depth of its open spans, and when
+ * tracing is enabled each completed span is appended to a buffer owned by
+ * its thread, so threads do not contend. The buffers are exported with
+ * @ref writeTrace.
+ *
+ * @see @ref stats::enableTracing.
+ */
+class Span
+{
+private:
+    std::shared_ptr<Time> time;
+    clock_type::time_point start;
+    int depth;
+
+    // Make non-copyable
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+public:
+    explicit Span(const TimeInit &t);
+    explicit Span(const std::shared_ptr<Time> &t);
+
+    /// Stop the span and record it. Later calls have no effect.
+    void stop();
+    ~Span();
+};
+
+/**
+ * Enable or disable recording of @ref Span events for @ref writeTrace.
+ * Enabling also sets the origin of the trace timestamps.
+ *
+ * @pre There are no currently live spans.
+ */
+void enableTracing(bool enable);
+
+/**
+ * Returns the value set by @ref enableTracing.
+ */
+bool isTracingEnabled();
+
+/**
+ * Write all recorded span events as a Chrome trace (the JSON event format
+ * read by chrome://tracing), with one track per thread. Events are kept
+ * after threads exit. This function is thread-safe, but spans still open
+ * are not included.
+ *
+ * @param filename  file to write
+ * @retval true  if the file is written,
+ * @retval false otherwise
+ */
+bool writeTrace(const uts::string &filename);
+
+/**
+ * Discard all recorded span events.
+ */
+void clearTrace();
+
 /**
  * Enable or disable reporting of elapsed time. Turning this on has a small
  * performance impact, and of course causes spam on stdout.
  *
- * @pre There are no currently live timers.
+ * This may be called while other threads run timers and spans. A timer
+ * records only if timing was on both when it started and when it stops. A
+ * @ref Span starts if timing or tracing is on, and once started always adds
+ * its elapsed time to its @ref Time, even if only tracing was on or both
+ * have since been turned off.
  */
 void enableTimers(bool enable);
 
@@ -150,6 +232,10 @@ uts::vector<std::shared_ptr<Time> > getTimes();
  * Report total times for all registered timers. This function is thread-safe,
  * but it does not guarantee an atomic snapshot i.e., another thread may
  * increment some times part-way through the printout.
+ *
+ * Each time prints a TOTAL line with its total in seconds and number of
+ * samples. Times that keep a histogram also print a LATENCY line with the
+ * 50th, 95th and 99th percentile and maximum samples in seconds.
  */
 void reportTimes();
 
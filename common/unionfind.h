@@ -0,0 +1,73 @@
+/**
+ * @file
+ *
+ * Concurrent disjoint-set forest for connected component labelling.
+ */
+
+#ifndef UTS_COMMON_UNIONFIND_H
+#define UTS_COMMON_UNIONFIND_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/**
+ * Disjoint sets over the integers [0, size). @ref unite and @ref find may be called concurrently from any
+ * number of threads. Roots are always linked beneath the smaller index, so once all unions are done the
+ * representative of each set is its smallest member, independent of the order in which unions happened.
+ */
+class DisjointSets
+{
+private:
+    std::unique_ptr<std::atomic<int>[]> parent; ///< parent of each element, roots are their own parent
+    int size;                                   ///< number of elements
+
+public:
+    /// Constructor, with every element in a set of its own
+    explicit DisjointSets(int size) : parent(new std::atomic<int>[size]), size(size)
+    {
+        for(int i = 0; i < size; i++)
+            parent[i].store(i, std::memory_order_relaxed);
+    }
+
+    /// Number of elements
+    int getSize() const { return size; }
+
+    /**
+     * Representative of the set containing an element. Paths are halved along the way, which is safe
+     * under concurrency because it only ever replaces a parent with one of its ancestors.
+     */
+    int find(int x)
+    {
+        int p, gp;
+
+        while((p = parent[x].load(std::memory_order_relaxed)) != x)
+        {
+            gp = parent[p].load(std::memory_order_relaxed);
+            if(gp != p)
+                parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+            x = gp;
+        }
+        return x;
+    }
+
+    /// Merge the sets containing two elements
+    void unite(int a, int b)
+    {
+        while(true)
+        {
+            a = find(a);
+            b = find(b);
+            if(a == b)
+                return;
+            if(a < b)
+                std::swap(a, b);
+            // a is the larger root: link it beneath b, unless another thread got to it first
+            int expected = a;
+            if(parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+                return;
+        }
+    }
+};
+
+#endif /* !UTS_COMMON_UNIONFIND_H */
@@ -0,0 +1,73 @@
+#include "bvh.h"
+#include <algorithm>
+
+using namespace std;
+
+void BVH::build(const std::vector<cgp::BoundBox> &boxes, int leafsize)
+{
+    struct Pending { int node, first, count; };
+    vector<cgp::Point> centres(boxes.size());
+    vector<Pending> stack;
+    int i;
+
+    nodes.clear();
+    prims.resize(boxes.size());
+    if(boxes.empty())
+        return;
+    leafsize = max(1, leafsize);
+
+    for(i = 0; i < (int) boxes.size(); i++)
+    {
+        prims[i] = i;
+        centres[i] = cgp::Point(0.5f * (boxes[i].min.x + boxes[i].max.x), 0.5f * (boxes[i].min.y + boxes[i].max.y),
+                                0.5f * (boxes[i].min.z + boxes[i].max.z));
+    }
+
+    nodes.reserve(2 * boxes.size() / leafsize + 1);
+    nodes.push_back(Node());
+    stack.push_back({0, 0, (int) boxes.size()});
+    while(!stack.empty())
+    {
+        Pending cur = stack.back();
+        cgp::BoundBox box, centrebox;
+        int axis, mid;
+
+        stack.pop_back();
+        for(i = cur.first; i < cur.first + cur.count; i++)
+        {
+            box.includePnt(boxes[prims[i]].min);
+            box.includePnt(boxes[prims[i]].max);
+            centrebox.includePnt(centres[prims[i]]);
+        }
+        nodes[cur.node].box = box;
+
+        cgp::Vector extent = centrebox.getDiag();
+        if(cur.count <= leafsize || (extent.i == 0.0f && extent.j == 0.0f && extent.k == 0.0f))
+        {
+            // few enough primitives, or all centred at one point so that no split can separate them
+            nodes[cur.node].count = cur.count;
+            nodes[cur.node].first = cur.first;
+            nodes[cur.node].left = nodes[cur.node].right = -1;
+            continue;
+        }
+
+        // median split along the longest axis of the primitive centres keeps the tree balanced
+        axis = (extent.i >= extent.j && extent.i >= extent.k) ? 0 : ((extent.j >= extent.k) ? 1 : 2);
+        mid = cur.first + cur.count / 2;
+        nth_element(prims.begin() + cur.first, prims.begin() + mid, prims.begin() + cur.first + cur.count,
+                    [&centres, axis](int a, int b)
+                    {
+                        return (axis == 0) ? centres[a].x < centres[b].x
+                             : ((axis == 1) ? centres[a].y < centres[b].y : centres[a].z < centres[b].z);
+                    });
+
+        int left = (int) nodes.size();
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[cur.node].left = left;
+        nodes[cur.node].right = left + 1;
+        nodes[cur.node].first = nodes[cur.node].count = 0;
+        stack.push_back({left, cur.first, mid - cur.first});
+        stack.push_back({left + 1, mid, cur.first + cur.count - mid});
+    }
+}
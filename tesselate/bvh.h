@@ -0,0 +1,141 @@
+#ifndef _bvh_h
+#define _bvh_h
+/**
+ * @file
+ *
+ * Bounding volume hierarchy over axis-aligned boxes, for broad phase culling of geometric queries.
+ */
+
+#include "vecpnt.h"
+#include <vector>
+
+/**
+ * Test whether two bounding boxes overlap, including touching faces
+ * @param a, b  boxes to test
+ */
+inline bool boxOverlap(const cgp::BoundBox &a, const cgp::BoundBox &b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x
+        && a.min.y <= b.max.y && b.min.y <= a.max.y
+        && a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+/**
+ * Binary tree of axis-aligned bounding boxes over a set of primitives, each represented only by its box and
+ * an index. Built top-down by median split along the longest axis of the primitive centres. Once built, queries
+ * are read-only and may run concurrently.
+ */
+class BVH
+{
+public:
+    /// Tree node. Leaves have count > 0 and refer to prims[first, first + count)
+    struct Node
+    {
+        cgp::BoundBox box;  ///< bounds of all primitives below this node
+        int left, right;    ///< child node indices, unused for leaves
+        int first, count;   ///< range of primitive indices held by a leaf
+    };
+
+private:
+    std::vector<Node> nodes;    ///< tree nodes, root first
+    std::vector<int> prims;     ///< primitive indices, grouped by leaf
+
+public:
+
+    /**
+     * Build the hierarchy, replacing any previous contents
+     * @param boxes     bounding box of each primitive
+     * @param leafsize  maximum number of primitives in a leaf
+     */
+    void build(const std::vector<cgp::BoundBox> &boxes, int leafsize = 4);
+
+    /// Test whether the hierarchy holds no primitives
+    bool empty() const { return nodes.empty(); }
+
+    /// Getter for the tree nodes, root first
+    const std::vector<Node> &getNodes() const { return nodes; }
+
+    /// Getter for the primitive indices referenced by leaves
+    const std::vector<int> &getPrims() const { return prims; }
+
+    /**
+     * Visit every primitive whose bounding box overlaps a query box
+     * @param box       query box
+     * @param visit     callable as bool visit(int prim), returning false to stop the traversal early
+     * @retval true  if the traversal completed,
+     * @retval false if it was stopped by the visitor
+     */
+    template<typename Visitor>
+    bool overlap(const cgp::BoundBox &box, Visitor visit) const
+    {
+        int stack[64], top = 0; // depth is logarithmic in the number of primitives thanks to median splits
+
+        if(nodes.empty())
+            return true;
+        stack[top++] = 0;
+        while(top > 0)
+        {
+            const Node &node = nodes[stack[--top]];
+            if(!boxOverlap(node.box, box))
+                continue;
+            if(node.count > 0)
+            {
+                for(int i = node.first; i < node.first + node.count; i++)
+                    if(!visit(prims[i]))
+                        return false;
+            }
+            else
+            {
+                stack[top++] = node.left;
+                stack[top++] = node.right;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Find the primitive nearest to a point, visiting nodes closest first and pruning any further away than
+     * the best distance found so far
+     * @param pnt           query point
+     * @param sqrdist       callable as float sqrdist(int prim), giving the squared distance from pnt to a primitive
+     * @param[in,out] best  on input the squared search radius, on output the squared distance to the nearest primitive
+     * @retval index of the nearest primitive, or -1 if none lies within the search radius
+     */
+    template<typename SqrDist>
+    int nearest(const cgp::Point &pnt, SqrDist sqrdist, float &best) const
+    {
+        int stack[64], top = 0, found = -1;
+
+        if(nodes.empty())
+            return -1;
+        stack[top++] = 0;
+        while(top > 0)
+        {
+            const Node &node = nodes[stack[--top]];
+            if(pointBoxSqrDist(pnt, node.box) >= best)
+                continue;
+            if(node.count > 0)
+            {
+                for(int i = node.first; i < node.first + node.count; i++)
+                {
+                    float d = sqrdist(prims[i]);
+                    if(d < best)
+                    {
+                        best = d;
+                        found = prims[i];
+                    }
+                }
+            }
+            else
+            {
+                // push the further child first so that the nearer one is searched first
+                float dl = pointBoxSqrDist(pnt, nodes[node.left].box), dr = pointBoxSqrDist(pnt, nodes[node.right].box);
+                stack[top++] = (dl < dr) ? node.right : node.left;
+                stack[top++] = (dl < dr) ? node.left : node.right;
+            }
+        }
+        return found;
+    }
+};
+
+#endif
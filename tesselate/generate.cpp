@@ -0,0 +1,341 @@
+#include "generate.h"
+#include "voxel.h"
+#include "halfedge.h"
+#include <common/parallel.h>
+#include <common/flat_map.h>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include <cmath>
+#include <cfloat>
+
+using namespace std;
+
+typedef SparseGrid<float> FloatGrid;
+
+/// Set the face normal of a triangle from its vertex positions
+static void setFaceNormal(const std::vector<cgp::Point> &verts, Triangle &tri)
+{
+    cgp::Vector e0, e1;
+    e0.diff(verts[tri.v[0]], verts[tri.v[1]]);
+    e1.diff(verts[tri.v[0]], verts[tri.v[2]]);
+    tri.n.cross(e0, e1);
+    tri.n.normalize();
+}
+
+void icosphere(int levels, float radius, std::vector<cgp::Point> &verts, std::vector<Triangle> &tris)
+{
+    const float t = (1.0f + sqrt(5.0f)) / 2.0f;
+    static const int faces[20][3] = {{0,11,5}, {0,5,1}, {0,1,7}, {0,7,10}, {0,10,11}, {1,5,9}, {5,11,4}, {11,10,2},
+                                     {10,7,6}, {7,1,8}, {3,9,4}, {3,4,2}, {3,2,6}, {3,6,8}, {3,8,9}, {4,9,5},
+                                     {2,4,11}, {6,2,10}, {8,6,7}, {9,8,1}};
+    uts::flat_map<uint64_t, int> midpoints;
+    vector<Triangle> finer;
+
+    verts = {cgp::Point(-1, t, 0), cgp::Point(1, t, 0), cgp::Point(-1, -t, 0), cgp::Point(1, -t, 0),
+             cgp::Point(0, -1, t), cgp::Point(0, 1, t), cgp::Point(0, -1, -t), cgp::Point(0, 1, -t),
+             cgp::Point(t, 0, -1), cgp::Point(t, 0, 1), cgp::Point(-t, 0, -1), cgp::Point(-t, 0, 1)};
+    tris.resize(20);
+    for(int f = 0; f < 20; f++)
+        for(int p = 0; p < 3; p++)
+            tris[f].v[p] = faces[f][p];
+
+    // new vertices are shared between the two triangles on either side of an edge
+    auto midpoint = [&](int a, int b)
+    {
+        uint64_t key = (a < b) ? ((uint64_t) a << 32 | (uint64_t) b) : ((uint64_t) b << 32 | (uint64_t) a);
+        auto ins = midpoints.insert(key, (int) verts.size());
+        if(ins.second)
+            verts.push_back(cgp::Point(0.5f * (verts[a].x + verts[b].x), 0.5f * (verts[a].y + verts[b].y),
+                                       0.5f * (verts[a].z + verts[b].z)));
+        return * ins.first;
+    };
+
+    // the shortest edge stays above 0.85 of the icosahedron's edge halved at each level, which is always
+    // several cells of the weld grid for the resulting number of triangles
+    if(20.0 * pow(4.0, (double) levels) > (double) maxGeneratedTris)
+    {
+        cerr << "Error icosphere: " << levels << " levels would give more than " << maxGeneratedTris << " triangles" << endl;
+        verts.clear();
+        tris.clear();
+        return;
+    }
+
+    for(int l = 0; l < levels; l++)
+    {
+        midpoints.clear();
+        midpoints.reserve(tris.size() * 3 / 2);
+        verts.reserve(verts.size() + tris.size() * 3 / 2);
+        finer.resize(tris.size() * 4);
+        for(int f = 0; f < (int) tris.size(); f++)
+        {
+            const int * v = tris[f].v;
+            int m0 = midpoint(v[0], v[1]), m1 = midpoint(v[1], v[2]), m2 = midpoint(v[2], v[0]);
+            int sub[4][3] = {{v[0], m0, m2}, {v[1], m1, m0}, {v[2], m2, m1}, {m0, m1, m2}};
+            for(int s = 0; s < 4; s++)
+                for(int p = 0; p < 3; p++)
+                    finer[4 * f + s].v[p] = sub[s][p];
+        }
+        tris.swap(finer);
+    }
+
+    for(cgp::Point &p: verts)
+    {
+        float s = radius / sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        p = cgp::Point(p.x * s, p.y * s, p.z * s);
+    }
+    for(Triangle &tri: tris)
+        setFaceNormal(verts, tri);
+}
+
+/**
+ * Collapse edges too short to survive welding. mergeVerts merges vertices sharing a cell of its grid, so a mesh
+ * read back from a file loses vertices that lie closer than a cell, as those next to a crossing near a sample
+ * point do. Edges shorter than two cell widths are collapsed onto their midpoints, or failing that onto either
+ * end, until none remain that can be collapsed without changing the topology or folding a triangle over.
+ * @param[in,out] verts, tris   welded closed mesh
+ */
+static void collapseShortEdges(std::vector<cgp::Point> &verts, std::vector<Triangle> &tris)
+{
+    HalfEdgeMesh hem;
+    cgp::BoundBox box;
+    bool any = false;
+    int collapses;
+
+    for(const cgp::Point &p: verts)
+        box.includePnt(p);
+    // the grid is a little coarser once the collapses have removed triangles, but stays well under half an edge
+    const float minlen = 2.0f * box.diagLen() / (float) Mesh::weldCells((long) tris.size()), maxsqrlen = FLT_MAX;
+
+    // usually there are none, and the half-edge mesh is not worth building
+    for(const Triangle &tri: tris)
+        for(int e = 0; e < 3; e++)
+        {
+            cgp::Vector d;
+            d.diff(verts[tri.v[e]], verts[tri.v[(e + 1) % 3]]);
+            any = any || d.sqrdlength() < minlen * minlen;
+        }
+    if(!any)
+        return;
+    hem.build(verts, tris);
+    do
+    {
+        collapses = 0;
+        for(int h = 0; h < (int) hem.origin.size(); h++)
+        {
+            if(hem.fdead[h / 3] || hem.twin[h] < 0 || hem.sqrLength(h) >= minlen * minlen)
+                continue;
+            const cgp::Point &p0 = hem.verts[hem.origin[h]], &p1 = hem.verts[hem.target(h)];
+            cgp::Point to[3] = {cgp::Point(0.5f * (p0.x + p1.x), 0.5f * (p0.y + p1.y), 0.5f * (p0.z + p1.z)), p1, p0};
+            for(int c = 0; c < 3; c++)
+            {
+                // the last choice keeps the origin's position, so the target is removed
+                int k = (c < 2) ? h : hem.twin[h];
+                if(!hem.locked[hem.origin[k]] && hem.canCollapse(k, to[c], maxsqrlen))
+                {
+                    hem.collapse(k, to[c]);
+                    collapses++;
+                    break;
+                }
+            }
+        }
+    }
+    while(collapses > 0);
+    hem.extract(verts, tris);
+}
+
+/**
+ * Sample an implicit function over a box and extract its zero level set. Values are clamped to a band of
+ * two samples about the surface, and bricks lying wholly beyond the band by the Lipschitz bound of the
+ * function are left as background or filled uniformly without sampling each voxel. So that the surface reads
+ * back from a file as extracted, samples are kept off zero and any edges still shorter than the weld grid
+ * can resolve are collapsed.
+ * @param field             callable as float field(const cgp::Point &), negative inside
+ * @param lipschitz         bound on how fast the field changes with distance
+ * @param box               region containing the surface
+ * @param spacing           distance between samples
+ * @param[out] verts, tris  extracted surface
+ * @param numthreads        number of threads to use, 0 for one per core
+ */
+template<typename Field>
+static void extractImplicit(Field field, float lipschitz, const cgp::BoundBox &box, float spacing,
+                            std::vector<cgp::Point> &verts, std::vector<Triangle> &tris, int numthreads)
+{
+    const int bs = FloatGrid::bricksize;
+    const float band = 2.0f * spacing, halfdiag = 0.5f * sqrt(3.0f) * bs * spacing;
+    // samples are kept this far from zero, so that few crossings fall next to a sample point where they would
+    // leave edges too short to weld
+    const float nudge = lipschitz * spacing / 8.0f;
+    cgp::Point origin(box.min.x - 2.0f * spacing, box.min.y - 2.0f * spacing, box.min.z - 2.0f * spacing);
+    float extent[3] = {box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z};
+    int nb[3], numbricks, numchunks;
+    FloatGrid grid(band);
+
+    // the box and two samples either side, in whole bricks
+    for(int a = 0; a < 3; a++)
+        nb[a] = ((int) ceil(extent[a] / spacing) + 4 + bs - 1) / bs;
+    numbricks = nb[0] * nb[1] * nb[2];
+
+    numchunks = parallel::numChunks(0, numbricks, numthreads);
+    vector<FloatGrid> partial;
+    for(int c = 0; c < numchunks; c++)
+        partial.emplace_back(band);
+    parallel::forChunks(0, numbricks, numthreads, [&](int chunk, int first, int last)
+    {
+        float data[FloatGrid::brickvoxels];
+
+        for(int b = first; b < last; b++)
+        {
+            int bi = b % nb[0], bj = (b / nb[0]) % nb[1], bk = b / (nb[0] * nb[1]);
+            float centre = field(cgp::Point(origin.x + (bi + 0.5f) * bs * spacing, origin.y + (bj + 0.5f) * bs * spacing,
+                                            origin.z + (bk + 0.5f) * bs * spacing));
+            if(centre - lipschitz * halfdiag >= band) // outside, the background
+                continue;
+            if(centre + lipschitz * halfdiag <= -band)
+            {
+                partial[chunk].fillBrick(bi, bj, bk, -band);
+                continue;
+            }
+            for(int k = 0; k < bs; k++)
+                for(int j = 0; j < bs; j++)
+                    for(int i = 0; i < bs; i++)
+                    {
+                        cgp::Point pnt(origin.x + ((float) (bi * bs + i) + 0.5f) * spacing,
+                                       origin.y + ((float) (bj * bs + j) + 0.5f) * spacing,
+                                       origin.z + ((float) (bk * bs + k) + 0.5f) * spacing);
+                        float value = field(pnt);
+                        if(fabs(value) < nudge)
+                            value = (value < 0.0f) ? -nudge : nudge;
+                        data[(k * bs + j) * bs + i] = max(-band, min(band, value));
+                    }
+            copy(data, data + FloatGrid::brickvoxels, partial[chunk].denseBrick(bi, bj, bk));
+        }
+        partial[chunk].compact();
+    });
+    for(int c = 0; c < numchunks; c++)
+        grid.merge(partial[c]);
+    isosurface(grid, origin, spacing, 0.0f, verts, tris, numthreads);
+    collapseShortEdges(verts, tris);
+}
+
+void genusTorus(int genus, int resolution, std::vector<cgp::Point> &verts, std::vector<Triangle> &tris, int numthreads)
+{
+    const float major = 1.0f, minor = 0.35f;
+    cgp::BoundBox box;
+
+    verts.clear();
+    tris.clear();
+    if(genus < 1 || resolution < 1)
+    {
+        cerr << "Error genusTorus: genus and resolution must be positive" << endl;
+        return;
+    }
+    if(14.0 * (double) genus * (double) resolution * (double) resolution > (double) maxGeneratedTris)
+    {
+        cerr << "Error genusTorus: genus " << genus << " at resolution " << resolution << " would give more than "
+             << maxGeneratedTris << " triangles" << endl;
+        return;
+    }
+
+    // ring r is centred at x = 2r - (genus - 1), so neighbouring centre circles touch on the x axis
+    box.includePnt(cgp::Point(-(float) (genus - 1) * major - major - minor, -major - minor, -minor));
+    box.includePnt(cgp::Point((float) (genus - 1) * major + major + minor, major + minor, minor));
+    auto field = [genus, major, minor](const cgp::Point &p)
+    {
+        float x = p.x + (float) (genus - 1) * major;
+        int nearest = max(0, min(genus - 1, (int) floor(x / (2.0f * major) + 0.5f)));
+        float d = FLT_MAX;
+        for(int r = max(0, nearest - 1); r <= min(genus - 1, nearest + 1); r++)
+        {
+            float dx = x - 2.0f * major * (float) r, q = sqrt(dx * dx + p.y * p.y) - major;
+            d = min(d, sqrt(q * q + p.z * p.z) - minor);
+        }
+        return d;
+    };
+    extractImplicit(field, 1.0f, box, 2.0f * (major + minor) / (float) resolution, verts, tris, numthreads);
+}
+
+void gyroid(int cells, int resolution, std::vector<cgp::Point> &verts, std::vector<Triangle> &tris, int numthreads)
+{
+    const float twopi = 6.2831853f;
+    cgp::BoundBox box;
+
+    verts.clear();
+    tris.clear();
+    if(cells < 1 || resolution < 1)
+    {
+        cerr << "Error gyroid: cells and resolution must be positive" << endl;
+        return;
+    }
+    if(34.0 * pow((double) cells, 3.0) * (double) resolution * (double) resolution > (double) maxGeneratedTris)
+    {
+        cerr << "Error gyroid: " << cells << " cells at resolution " << resolution << " would give more than "
+             << maxGeneratedTris << " triangles" << endl;
+        return;
+    }
+
+    // scaled so that the field changes by about one unit per cell, and intersected with the box
+    float side = (float) cells;
+    box.includePnt(cgp::Point(0.0f, 0.0f, 0.0f));
+    box.includePnt(cgp::Point(side, side, side));
+    auto field = [side, twopi](const cgp::Point &p)
+    {
+        float x = twopi * p.x, y = twopi * p.y, z = twopi * p.z;
+        float g = (sin(x) * cos(y) + sin(y) * cos(z) + sin(z) * cos(x)) / twopi;
+        float b = max(max(max(-p.x, p.x - side), max(-p.y, p.y - side)), max(-p.z, p.z - side));
+        return max(g, b);
+    };
+    extractImplicit(field, 2.0f * sqrt(3.0f), box, 1.0f / (float) resolution, verts, tris, numthreads);
+}
+
+void triangleSoup(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, float duplicates,
+                  int holes, unsigned int seed, std::vector<cgp::Point> &soupverts, std::vector<Triangle> &souptris)
+{
+    mt19937 rng(seed);
+    vector<int> order(tris.size()), kept;
+    vector<char> usedvert(verts.size(), 0), removed(tris.size(), 0);
+    int t, cut = 0;
+
+    // shuffle by Fisher-Yates on raw generator output, which unlike the standard distributions is the same everywhere
+    auto shuffle = [&rng](vector<int> &items)
+    {
+        for(int i = (int) items.size() - 1; i > 0; i--)
+            swap(items[i], items[rng() % (uint32_t) (i + 1)]);
+    };
+
+    // holes are taken in random order from triangles not touching an earlier hole
+    for(t = 0; t < (int) tris.size(); t++)
+        order[t] = t;
+    shuffle(order);
+    for(t = 0; t < (int) order.size() && cut < holes; t++)
+    {
+        const int * v = tris[order[t]].v;
+        if(usedvert[v[0]] || usedvert[v[1]] || usedvert[v[2]])
+            continue;
+        usedvert[v[0]] = usedvert[v[1]] = usedvert[v[2]] = 1;
+        removed[order[t]] = 1;
+        cut++;
+    }
+    for(t = 0; t < (int) tris.size(); t++)
+        if(!removed[t])
+            kept.push_back(t);
+
+    // copies of random survivors
+    int numdup = (int) (duplicates * (float) kept.size() + 0.5f), numkept = (int) kept.size();
+    for(int d = 0; d < numdup && numkept > 0; d++)
+        kept.push_back(kept[rng() % (uint32_t) numkept]);
+    shuffle(kept);
+
+    soupverts.resize(kept.size() * 3);
+    souptris.resize(kept.size());
+    for(t = 0; t < (int) kept.size(); t++)
+    {
+        const Triangle &tri = tris[kept[t]];
+        for(int p = 0; p < 3; p++)
+        {
+            soupverts[3 * t + p] = verts[tri.v[p]];
+            souptris[t].v[p] = 3 * t + p;
+        }
+        setFaceNormal(soupverts, souptris[t]);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef _generate_h
+#define _generate_h
+/**
+ * @file
+ *
+ * Procedural test meshes of any size, for benchmarks and scaling tests that should not depend on mesh files.
+ * All generators are deterministic: the same parameters always give the same mesh.
+ */
+
+#include "mesh.h"
+#include <vector>
+
+const long maxGeneratedTris = 1L << 30; ///< most triangles a generator will build, leaving room in int indices
+
+/**
+ * Build a sphere by repeatedly splitting the faces of an icosahedron into four and pushing the new vertices
+ * out onto the sphere. The result is closed, welded and has 20 * 4^levels triangles facing outward.
+ * @param levels            number of rounds of subdivision. Beyond 12 levels there would be more than
+ *                          @ref maxGeneratedTris triangles, so an error is reported and the mesh is left empty
+ * @param radius            sphere radius
+ * @param[out] verts, tris  generated mesh, previous contents are discarded
+ */
+void icosphere(int levels, float radius, std::vector<cgp::Point> &verts, std::vector<Triangle> &tris);
+
+/**
+ * Build a closed surface of a given genus as a row of rings of unit radius and tube radius 0.35 whose centre
+ * circles touch, extracted from the union of their distance fields by marching tetrahedra. There are about
+ * 14 * genus * resolution^2 triangles, and if that would exceed @ref maxGeneratedTris an error is reported
+ * and the mesh is left empty. Every edge spans at least two cells of the weld grid, so the mesh survives a
+ * round trip through a file unchanged.
+ * @param genus             number of holes, at least 1
+ * @param resolution        samples across the diameter of one ring
+ * @param[out] verts, tris  generated mesh, previous contents are discarded
+ * @param numthreads        number of threads to use, 0 for one per core
+ */
+void genusTorus(int genus, int resolution, std::vector<cgp::Point> &verts, std::vector<Triangle> &tris,
+                int numthreads = 0);
+
+/**
+ * Build a lattice of gyroid cells: the solid sin x cos y + sin y cos z + sin z cos x < 0 clipped to a cube of
+ * unit cells, extracted by marching tetrahedra. The result is a single closed shell of high genus. There are
+ * about 34 * cells^3 * resolution^2 triangles, limited and with short edges removed as for ::genusTorus.
+ * @param cells             unit cells along each side of the cube
+ * @param resolution        samples across one cell
+ * @param[out] verts, tris  generated mesh, previous contents are discarded
+ * @param numthreads        number of threads to use, 0 for one per core
+ */
+void gyroid(int cells, int resolution, std::vector<cgp::Point> &verts, std::vector<Triangle> &tris,
+            int numthreads = 0);
+
+/**
+ * Turn a welded mesh into an unwelded triangle soup of the kind read from an STL file, with some triangles
+ * repeated and some removed to leave holes. Each hole removes one triangle sharing no vertex with any other
+ * hole, and duplicates are copies of surviving triangles, so the soup welds back into the original mesh less
+ * the holes. Triangles are shuffled and each has its own three vertices.
+ * @param verts, tris       welded mesh
+ * @param duplicates        number of extra copies to add, as a fraction of the surviving triangles
+ * @param holes             number of holes to cut, fewer if the mesh runs out of separated triangles
+ * @param seed              seed for the pseudo-random choices
+ * @param[out] soupverts, souptris  triangle soup, previous contents are discarded
+ */
+void triangleSoup(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, float duplicates,
+                  int holes, unsigned int seed, std::vector<cgp::Point> &soupverts, std::vector<Triangle> &souptris);
+
+#endif
@@ -12,6 +12,7 @@
 #include <QImage>
 #include <QCoreApplication>
 #include <QMessageBox>
+#include <common/timer.h>
 
 #include <fstream>
 
@@ -22,6 +23,8 @@
 
 using namespace std;
 
+static stats::TimeInit timePaintGL("glwidget.paintGL", true); ///< CPU time to issue a frame, not including the GPU finishing it
+
 #ifndef GL_MULTISAMPLE
 #define GL_MULTISAMPLE  0x809D
 #endif
@@ -47,6 +50,10 @@ GLWidget::GLWidget(const QGLFormat& format, QWidget *parent)
 GLWidget::~GLWidget()
 {
     if (renderer) delete renderer;
+
+    // latencies gathered while the overlay was shown
+    if(stats::isTimingEnabled())
+        stats::reportTimes();
 }
 
 QSize GLWidget::minimumSizeHint() const
@@ -106,7 +113,7 @@ void GLWidget::initializeGL()
 
 void GLWidget::paintGL()
 {
-    ShapeDrawData sdd;
+    stats::Span span(timePaintGL);
 
     glewExperimental = GL_TRUE;
     if(!glewSetupDone)
@@ -127,8 +134,7 @@ void GLWidget::paintGL()
 
         if(meshVisible)
         {
-            if(xsect.genGeometry(getView(), sdd))
-                drawParams.push_back(sdd);
+            xsect.genGeometry(getView(), drawParams);
         }
         updateGeometry = false;
     }
@@ -0,0 +1,565 @@
+#include "halfedge.h"
+#include "bvh.h"
+#include "timer.h"
+#include <common/parallel.h>
+#include <common/flat_map.h>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <cfloat>
+
+using namespace std;
+
+float HalfEdgeMesh::sqrLength(int h) const
+{
+    cgp::Vector e;
+    e.diff(verts[origin[h]], verts[target(h)]);
+    return e.sqrdlength();
+}
+
+void HalfEdgeMesh::setTri(int f, int a, int b, int c)
+{
+    origin[3 * f] = a;
+    origin[3 * f + 1] = b;
+    origin[3 * f + 2] = c;
+}
+
+void HalfEdgeMesh::link(int h, int g)
+{
+    if(h >= 0)
+        twin[h] = g;
+    if(g >= 0)
+        twin[g] = h;
+}
+
+void HalfEdgeMesh::build(const std::vector<cgp::Point> &pnts, const std::vector<Triangle> &tris)
+{
+    vector<pair<uint64_t, int>> keys(tris.size() * 3);
+    vector<int> incident(pnts.size(), 0), ring;
+    int f, e, h, v;
+
+    verts = pnts;
+    origin.resize(tris.size() * 3);
+    twin.assign(tris.size() * 3, -1);
+    fdead.assign(tris.size(), 0);
+    vhalf.assign(pnts.size(), -1);
+    locked.assign(pnts.size(), 0);
+    for(f = 0; f < (int) tris.size(); f++)
+        for(e = 0; e < 3; e++)
+        {
+            origin[3 * f + e] = tris[f].v[e];
+            vhalf[tris[f].v[e]] = 3 * f + e;
+            incident[tris[f].v[e]]++;
+        }
+
+    // pair half-edges running in opposite directions along the same edge
+    for(h = 0; h < (int) origin.size(); h++)
+    {
+        uint64_t a = (uint64_t) origin[h], b = (uint64_t) target(h);
+        keys[h] = make_pair((a < b) ? (a << 32 | b) : (b << 32 | a), h);
+    }
+    sort(keys.begin(), keys.end());
+    for(e = 0; e < (int) keys.size(); )
+    {
+        int end = e + 1;
+        while(end < (int) keys.size() && keys[end].first == keys[e].first)
+            end++;
+        int h0 = keys[e].second, h1 = keys[e + 1 < end ? e + 1 : e].second;
+        if(end - e == 2 && origin[h0] == target(h1))
+            link(h0, h1);
+        else // boundary, non-manifold or inconsistently oriented
+            for(int k = e; k < end; k++)
+            {
+                locked[origin[keys[k].second]] = 1;
+                locked[target(keys[k].second)] = 1;
+            }
+        e = end;
+    }
+
+    // a vertex whose triangles do not form a single fan is pinched, and is locked like a non-manifold edge
+    for(v = 0; v < (int) verts.size(); v++)
+        if(vhalf[v] >= 0 && !locked[v])
+        {
+            int count = 0;
+            h = vhalf[v];
+            do
+            {
+                count++;
+                h = twin[prev(h)];
+            }
+            while(h != vhalf[v]);
+            if(count != incident[v])
+                locked[v] = 1;
+        }
+}
+
+void HalfEdgeMesh::extract(std::vector<cgp::Point> &pnts, std::vector<Triangle> &tris) const
+{
+    vector<int> remap(verts.size(), -1);
+    int f, e;
+
+    pnts.clear();
+    tris.clear();
+    for(f = 0; f < numTris(); f++)
+    {
+        if(fdead[f])
+            continue;
+        Triangle tri;
+        for(e = 0; e < 3; e++)
+        {
+            int v = origin[3 * f + e];
+            if(remap[v] < 0)
+            {
+                remap[v] = (int) pnts.size();
+                pnts.push_back(verts[v]);
+            }
+            tri.v[e] = remap[v];
+        }
+        cgp::Vector e0, e1;
+        e0.diff(pnts[tri.v[0]], pnts[tri.v[1]]);
+        e1.diff(pnts[tri.v[0]], pnts[tri.v[2]]);
+        tri.n.cross(e0, e1);
+        tri.n.normalize();
+        tris.push_back(tri);
+    }
+}
+
+/**
+ * Collect one half-edge leaving a vertex in each of its triangles, walking counter-clockwise and then, if a
+ * boundary is reached, clockwise from the start
+ */
+static void outgoing(const HalfEdgeMesh &hem, int v, std::vector<int> &hs)
+{
+    int start = hem.vhalf[v], h = start;
+
+    hs.clear();
+    if(start < 0)
+        return;
+    do
+    {
+        hs.push_back(h);
+        h = hem.twin[HalfEdgeMesh::prev(h)];
+    }
+    while(h >= 0 && h != start);
+    if(h < 0)
+    {
+        h = start;
+        while(hem.twin[h] >= 0)
+        {
+            h = HalfEdgeMesh::next(hem.twin[h]);
+            hs.push_back(h);
+        }
+    }
+}
+
+/// Half-edge running from vertex a to vertex b, or -1 if there is none
+static int findHalfEdge(const HalfEdgeMesh &hem, int a, int b)
+{
+    vector<int> hs;
+
+    outgoing(hem, a, hs);
+    for(int h: hs)
+        if(hem.target(h) == b)
+            return h;
+    return -1;
+}
+
+void HalfEdgeMesh::oneRing(int v, std::vector<int> &ring) const
+{
+    vector<int> hs;
+
+    outgoing(*this, v, hs);
+    ring.clear();
+    for(int h: hs)
+    {
+        ring.push_back(target(h));
+        if(twin[prev(h)] < 0) // the last edge of a fan ending at a boundary
+            ring.push_back(origin[prev(h)]);
+    }
+}
+
+int HalfEdgeMesh::valence(int v) const
+{
+    vector<int> ring;
+    oneRing(v, ring);
+    return (int) ring.size();
+}
+
+int HalfEdgeMesh::split(int h, const cgp::Point &pnt)
+{
+    int g = twin[h], f0 = h / 3, f1 = g / 3;
+    int a = origin[h], b = target(h), c = origin[prev(h)], d = origin[prev(g)];
+    int tn0 = twin[next(h)], tp0 = twin[prev(h)], tn1 = twin[next(g)], tp1 = twin[prev(g)];
+    int m = (int) verts.size(), f2 = numTris(), f3 = f2 + 1;
+
+    verts.push_back(pnt);
+    vhalf.push_back(-1);
+    locked.push_back(0);
+    fdead.push_back(0);
+    fdead.push_back(0);
+    origin.resize(origin.size() + 6);
+    twin.resize(twin.size() + 6, -1);
+
+    // (a, b, c) and (b, a, d) become (a, m, c), (m, b, c), (b, m, d) and (m, a, d)
+    setTri(f0, a, m, c);
+    setTri(f2, m, b, c);
+    setTri(f1, b, m, d);
+    setTri(f3, m, a, d);
+    link(3 * f0, 3 * f3);
+    link(3 * f0 + 1, 3 * f2 + 2);
+    link(3 * f0 + 2, tp0);
+    link(3 * f2, 3 * f1);
+    link(3 * f2 + 1, tn0);
+    link(3 * f1 + 1, 3 * f3 + 2);
+    link(3 * f1 + 2, tp1);
+    link(3 * f3 + 1, tn1);
+    vhalf[a] = 3 * f0;
+    vhalf[m] = 3 * f0 + 1;
+    vhalf[c] = 3 * f0 + 2;
+    vhalf[b] = 3 * f1;
+    vhalf[d] = 3 * f1 + 2;
+    return m;
+}
+
+/// Unnormalised normal of a triangle
+static cgp::Vector triNormal(const cgp::Point &p0, const cgp::Point &p1, const cgp::Point &p2)
+{
+    cgp::Vector e0, e1, n;
+    e0.diff(p0, p1);
+    e1.diff(p0, p2);
+    n.cross(e0, e1);
+    return n;
+}
+
+bool HalfEdgeMesh::canCollapse(int h, const cgp::Point &pnt, float maxsqrlen) const
+{
+    int g = twin[h];
+    vector<int> ringa, ringb, hs;
+
+    if(g < 0 || locked[origin[h]])
+        return false;
+    if(twin[next(h)] < 0 || twin[prev(h)] < 0 || twin[next(g)] < 0 || twin[prev(g)] < 0)
+        return false;
+
+    // link condition: the only vertices adjacent to both ends are the two opposite the edge
+    int a = origin[h], b = target(h), c = origin[prev(h)], d = origin[prev(g)];
+    oneRing(a, ringa);
+    oneRing(b, ringb);
+    int common = 0;
+    for(int u: ringa)
+        if(find(ringb.begin(), ringb.end(), u) != ringb.end())
+            common++;
+    if(common != 2 || valence(c) <= 3 || valence(d) <= 3)
+        return false;
+
+    // triangles around either end, other than the two removed, must not fold over or gain long edges
+    for(int v: {a, b})
+    {
+        outgoing(*this, v, hs);
+        for(int k: hs)
+        {
+            int f = k / 3;
+            if(f == h / 3 || f == g / 3)
+                continue;
+            cgp::Point p[3];
+            for(int e = 0; e < 3; e++)
+            {
+                int u = origin[3 * f + e];
+                p[e] = (u == a || u == b) ? pnt : verts[u];
+            }
+            cgp::Vector before = triNormal(verts[origin[3 * f]], verts[origin[3 * f + 1]], verts[origin[3 * f + 2]]);
+            cgp::Vector after = triNormal(p[0], p[1], p[2]);
+            if(after.dot(before) <= 0.0f)
+                return false;
+            cgp::Vector e0, e1;
+            e0.diff(pnt, verts[target(k)]);
+            e1.diff(pnt, verts[origin[prev(k)]]);
+            if(e0.sqrdlength() > maxsqrlen || e1.sqrdlength() > maxsqrlen)
+                return false;
+        }
+    }
+    return true;
+}
+
+void HalfEdgeMesh::collapse(int h, const cgp::Point &pnt)
+{
+    int g = twin[h], f0 = h / 3, f1 = g / 3;
+    int a = origin[h], b = target(h), c = origin[prev(h)], d = origin[prev(g)];
+    int tn0 = twin[next(h)], tp0 = twin[prev(h)], tn1 = twin[next(g)], tp1 = twin[prev(g)];
+    vector<int> hs;
+
+    outgoing(*this, a, hs);
+    for(int k: hs)
+        origin[k] = b;
+    link(tn0, tp0);
+    link(tn1, tp1);
+    fdead[f0] = fdead[f1] = 1;
+    vhalf[a] = -1;
+    verts[b] = pnt;
+    vhalf[b] = tp0;
+    vhalf[c] = tn0;
+    vhalf[d] = tn1;
+}
+
+bool HalfEdgeMesh::canFlip(int h) const
+{
+    int g = twin[h];
+    vector<int> ring;
+
+    if(g < 0)
+        return false;
+    int a = origin[h], b = target(h), c = origin[prev(h)], d = origin[prev(g)];
+    if(c == d || valence(a) <= 3 || valence(b) <= 3)
+        return false;
+    oneRing(c, ring);
+    if(find(ring.begin(), ring.end(), d) != ring.end()) // the other diagonal is already an edge
+        return false;
+
+    cgp::Vector old0 = triNormal(verts[a], verts[b], verts[c]), old1 = triNormal(verts[b], verts[a], verts[d]);
+    cgp::Vector new0 = triNormal(verts[a], verts[d], verts[c]), new1 = triNormal(verts[d], verts[b], verts[c]);
+    return new0.dot(old0) > 0.0f && new0.dot(old1) > 0.0f && new1.dot(old0) > 0.0f && new1.dot(old1) > 0.0f;
+}
+
+void HalfEdgeMesh::flip(int h)
+{
+    int g = twin[h], f0 = h / 3, f1 = g / 3;
+    int a = origin[h], b = target(h), c = origin[prev(h)], d = origin[prev(g)];
+    int tn0 = twin[next(h)], tp0 = twin[prev(h)], tn1 = twin[next(g)], tp1 = twin[prev(g)];
+
+    // (a, b, c) and (b, a, d) become (a, d, c) and (d, b, c)
+    setTri(f0, a, d, c);
+    setTri(f1, d, b, c);
+    link(3 * f0, tn1);
+    link(3 * f0 + 1, 3 * f1 + 2);
+    link(3 * f0 + 2, tp0);
+    link(3 * f1, tp1);
+    link(3 * f1 + 1, tn0);
+    vhalf[a] = 3 * f0;
+    vhalf[d] = 3 * f0 + 1;
+    vhalf[c] = 3 * f0 + 2;
+    vhalf[b] = 3 * f1 + 1;
+}
+
+/// Key of the edge between two vertices, the same in either direction
+static inline uint64_t edgeKey(int a, int b)
+{
+    return (a < b) ? ((uint64_t) a << 32 | (uint64_t) b) : ((uint64_t) b << 32 | (uint64_t) a);
+}
+
+void isotropicRemesh(HalfEdgeMesh &hem, const std::vector<cgp::Point> &pnts, const std::vector<Triangle> &tris,
+                     float targetlen, int iterations, RemeshReport &report, float featureangle, int numthreads)
+{
+    const float high2 = (4.0f / 3.0f * targetlen) * (4.0f / 3.0f * targetlen);
+    const float low2 = (4.0f / 5.0f * targetlen) * (4.0f / 5.0f * targetlen);
+    const float cosfeature = cos(featureangle * PI / 180.0f);
+    vector<cgp::BoundBox> boxes(tris.size());
+    vector<cgp::Point> buffer;
+    uts::flat_map<uint64_t, char> creases; // edges by key, 1 while they are creases
+    vector<int> numcreases(hem.verts.size(), 0), ring;
+    BVH bvh;
+    Timer timer;
+    int h, livetris = 0;
+
+    report.splits = report.collapses = report.flips = 0;
+    timer.start();
+
+    // creases are edges whose faces meet at more than the feature angle. Edits keep them: they are split into
+    // creases, never flipped, and only collapsed along their own line
+    auto isCrease = [&creases](int a, int b)
+    {
+        const char * c = creases.find(edgeKey(a, b));
+        return c && * c;
+    };
+    auto setCrease = [&creases, &numcreases](int a, int b, bool crease)
+    {
+        int change = crease ? 1 : -1;
+        char &c = creases[edgeKey(a, b)];
+        if((bool) c == crease)
+            return;
+        c = crease;
+        numcreases[a] += change;
+        numcreases[b] += change;
+    };
+    if(featureangle > 0.0f)
+        for(h = 0; h < (int) hem.origin.size(); h++)
+        {
+            int g = hem.twin[h];
+            if(g < h || hem.fdead[h / 3])
+                continue;
+            cgp::Vector n0 = triNormal(hem.verts[hem.origin[h]], hem.verts[hem.origin[HalfEdgeMesh::next(h)]], hem.verts[hem.origin[HalfEdgeMesh::prev(h)]]);
+            cgp::Vector n1 = triNormal(hem.verts[hem.origin[g]], hem.verts[hem.origin[HalfEdgeMesh::next(g)]], hem.verts[hem.origin[HalfEdgeMesh::prev(g)]]);
+            n0.normalize();
+            n1.normalize();
+            if(n0.dot(n1) < cosfeature)
+                setCrease(hem.origin[h], hem.target(h), true);
+        }
+
+    // the original surface, to project relaxed vertices back onto
+    for(int t = 0; t < (int) tris.size(); t++)
+        for(int p = 0; p < 3; p++)
+            boxes[t].includePnt(pnts[tris[t].v[p]]);
+    bvh.build(boxes);
+
+    for(int it = 0; it < iterations && targetlen > 0.0f; it++)
+    {
+        // split long edges longest first, so that triangles are bisected across their longest side rather than
+        // cut into slivers, and repeat on the halves until none remain too long
+        for(int pass = 0; pass < 32; pass++)
+        {
+            vector<pair<float, pair<int, int>>> longedges;
+            for(h = 0; h < (int) hem.origin.size(); h++)
+            {
+                float len2;
+                if(!hem.fdead[h / 3] && hem.twin[h] > h && (len2 = hem.sqrLength(h)) > high2)
+                    longedges.push_back(make_pair(len2, make_pair(hem.origin[h], hem.target(h))));
+            }
+            if(longedges.empty())
+                break;
+            sort(longedges.begin(), longedges.end(), greater<pair<float, pair<int, int>>>());
+
+            // splits renumber the half-edges of neighbouring triangles, so edges are found again by their ends
+            for(const auto &edge: longedges)
+            {
+                h = findHalfEdge(hem, edge.second.first, edge.second.second);
+                if(h < 0 || hem.twin[h] < 0 || hem.sqrLength(h) <= high2)
+                    continue;
+                const cgp::Point &p0 = hem.verts[edge.second.first], &p1 = hem.verts[edge.second.second];
+                int m = hem.split(h, cgp::Point(0.5f * (p0.x + p1.x), 0.5f * (p0.y + p1.y), 0.5f * (p0.z + p1.z)));
+                numcreases.push_back(0);
+                if(isCrease(edge.second.first, edge.second.second))
+                {
+                    setCrease(edge.second.first, edge.second.second, false);
+                    setCrease(edge.second.first, m, true);
+                    setCrease(m, edge.second.second, true);
+                }
+                report.splits++;
+            }
+        }
+
+        // collapse short edges, onto the midpoint unless one end is locked or on a crease
+        for(h = 0; h < (int) hem.origin.size(); h++)
+        {
+            int g = hem.twin[h], k = h, along = -1;
+            if(hem.fdead[h / 3] || g < 0 || hem.sqrLength(h) >= low2)
+                continue;
+            int a = hem.origin[h], b = hem.target(h);
+            bool fixeda = hem.locked[a] || numcreases[a] > 0, fixedb = hem.locked[b] || numcreases[b] > 0;
+            cgp::Point pnt;
+            if(isCrease(a, b))
+            {
+                // slide an end that lies on this crease line alone onto the other, keeping the line
+                if(!hem.locked[a] && numcreases[a] == 2)
+                    pnt = hem.verts[b];
+                else if(!hem.locked[b] && numcreases[b] == 2)
+                {
+                    k = g;
+                    pnt = hem.verts[a];
+                }
+                else
+                    continue;
+                int removed = hem.origin[k], kept = hem.target(k);
+                hem.oneRing(removed, ring);
+                for(int u: ring)
+                    if(u != kept && isCrease(removed, u))
+                        along = u;
+                // the crease beyond must not merge into an edge of the removed triangles
+                if(along < 0 || along == hem.origin[HalfEdgeMesh::prev(k)] || along == hem.origin[HalfEdgeMesh::prev(hem.twin[k])])
+                    continue;
+            }
+            else if(fixeda && fixedb) // an edge across a crease, or between locked vertices
+                continue;
+            else if(fixeda)
+            {
+                k = g;
+                pnt = hem.verts[a];
+            }
+            else if(fixedb)
+                pnt = hem.verts[b];
+            else
+                pnt = cgp::Point(0.5f * (hem.verts[a].x + hem.verts[b].x), 0.5f * (hem.verts[a].y + hem.verts[b].y),
+                                 0.5f * (hem.verts[a].z + hem.verts[b].z));
+            if(hem.canCollapse(k, pnt, high2))
+            {
+                int removed = hem.origin[k], kept = hem.target(k);
+                hem.collapse(k, pnt);
+                if(along >= 0)
+                {
+                    setCrease(removed, kept, false);
+                    setCrease(removed, along, false);
+                    setCrease(kept, along, true);
+                }
+                report.collapses++;
+            }
+        }
+
+        // flip edges that bring the valences of the four vertices involved closer to 6, or 4 on boundaries
+        for(h = 0; h < (int) hem.origin.size(); h++)
+        {
+            int g = hem.twin[h];
+            if(hem.fdead[h / 3] || g < h || isCrease(hem.origin[h], hem.target(h)))
+                continue;
+            int v[4] = {hem.origin[h], hem.target(h), hem.origin[HalfEdgeMesh::prev(h)], hem.origin[HalfEdgeMesh::prev(g)]};
+            int change[4] = {-1, -1, 1, 1}, before = 0, after = 0;
+            for(int i = 0; i < 4; i++)
+            {
+                int val = hem.valence(v[i]), target = hem.locked[v[i]] ? 4 : 6;
+                before += abs(val - target);
+                after += abs(val + change[i] - target);
+            }
+            if(after < before && hem.canFlip(h))
+            {
+                hem.flip(h);
+                report.flips++;
+            }
+        }
+
+        // tangential relaxation towards the centroid of the neighbours, then projection onto the original surface.
+        // Vertices on creases stay put, since relaxation and projection would round the crease off
+        buffer = hem.verts;
+        parallel::forChunks(0, (int) hem.verts.size(), numthreads, [&](int, int first, int last)
+        {
+            vector<int> ring, hs;
+            cgp::Point closest;
+
+            for(int v = first; v < last; v++)
+            {
+                if(hem.vhalf[v] < 0 || hem.locked[v] || numcreases[v] > 0)
+                    continue;
+                const cgp::Point &p = hem.verts[v];
+                cgp::Vector n(0.0f, 0.0f, 0.0f), d;
+                float qx = 0.0f, qy = 0.0f, qz = 0.0f;
+
+                outgoing(hem, v, hs);
+                for(int k: hs)
+                {
+                    cgp::Vector fn = triNormal(p, hem.verts[hem.target(k)], hem.verts[hem.origin[HalfEdgeMesh::prev(k)]]);
+                    n.add(fn); // area weighted
+                    const cgp::Point &q = hem.verts[hem.target(k)];
+                    qx += q.x; qy += q.y; qz += q.z;
+                }
+                n.normalize();
+                float w = 1.0f / (float) hs.size();
+                cgp::Point q(qx * w, qy * w, qz * w);
+                d.diff(q, p);
+                float s = d.dot(n);
+                cgp::Point relaxed(q.x + s * n.i, q.y + s * n.j, q.z + s * n.k);
+
+                float best = FLT_MAX;
+                int t = bvh.nearest(relaxed, [&](int t)
+                {
+                    return pointTriSqrDist(relaxed, pnts[tris[t].v[0]], pnts[tris[t].v[1]], pnts[tris[t].v[2]], closest);
+                }, best);
+                if(t >= 0) // closest holds the last candidate tested, not necessarily the nearest
+                    pointTriSqrDist(relaxed, pnts[tris[t].v[0]], pnts[tris[t].v[1]], pnts[tris[t].v[2]], closest);
+                buffer[v] = (t >= 0) ? closest : relaxed;
+            }
+        });
+        hem.verts.swap(buffer);
+    }
+
+    for(int f = 0; f < hem.numTris(); f++)
+        livetris += !hem.fdead[f];
+    timer.stop();
+    report.seconds = timer.peek();
+    report.trispersec = (report.seconds > 0.0) ? (double) livetris * iterations / report.seconds : 0.0;
+}
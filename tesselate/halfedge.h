@@ -0,0 +1,143 @@
+#ifndef _halfedge_h
+#define _halfedge_h
+/**
+ * @file
+ *
+ * Half-edge connectivity for triangle meshes, supporting the local edits needed for remeshing.
+ */
+
+#include "mesh.h"
+#include <vector>
+
+/**
+ * Half-edge structure over a welded triangle mesh. Triangle f owns half-edges 3f, 3f+1 and 3f+2, running
+ * counter-clockwise from its vertices v[0], v[1] and v[2], so next and previous half-edges are implicit and only
+ * the origin vertex and opposite half-edge are stored. Edits leave deleted triangles and vertices in place, to be
+ * dropped by @a extract.
+ *
+ * Edges with other than two incident triangles have no opposite half-edge. Their vertices are locked: never
+ * moved or removed, so that boundaries and non-manifold regions are preserved.
+ */
+class HalfEdgeMesh
+{
+public:
+    std::vector<cgp::Point> verts;  ///< vertex positions
+    std::vector<int> origin;        ///< vertex at the start of each half-edge
+    std::vector<int> twin;          ///< opposite half-edge, -1 on boundary and non-manifold edges
+    std::vector<int> vhalf;         ///< a half-edge leaving each vertex, -1 for deleted vertices
+    std::vector<char> fdead;        ///< true for deleted triangles
+    std::vector<char> locked;       ///< true for vertices that must not move or be removed
+
+    /// Next half-edge around the same triangle
+    static int next(int h){ return (h % 3 == 2) ? h - 2 : h + 1; }
+
+    /// Previous half-edge around the same triangle
+    static int prev(int h){ return (h % 3 == 0) ? h + 2 : h - 1; }
+
+    /// Vertex at the end of a half-edge
+    int target(int h) const { return origin[next(h)]; }
+
+    /// Number of triangles, including deleted ones
+    int numTris() const { return (int) fdead.size(); }
+
+    /// Squared length of the edge of a half-edge
+    float sqrLength(int h) const;
+
+    /**
+     * Build from a welded triangle mesh, replacing any previous contents
+     * @param pnts, tris    mesh geometry
+     */
+    void build(const std::vector<cgp::Point> &pnts, const std::vector<Triangle> &tris);
+
+    /**
+     * Copy the live triangles and the vertices they use into a triangle mesh, with face normals set
+     * @param[out] pnts, tris   mesh geometry, previous contents are discarded
+     */
+    void extract(std::vector<cgp::Point> &pnts, std::vector<Triangle> &tris) const;
+
+    /**
+     * Find the vertices around a vertex, in counter-clockwise order for an interior vertex
+     * @param v             vertex
+     * @param[out] ring     neighbouring vertices
+     */
+    void oneRing(int v, std::vector<int> &ring) const;
+
+    /// Number of edges at a vertex
+    int valence(int v) const;
+
+    /**
+     * Split an interior edge at a point, replacing its two triangles with four
+     * @param h     half-edge of the edge to split
+     * @param pnt   position of the new vertex
+     * @retval index of the new vertex
+     */
+    int split(int h, const cgp::Point &pnt);
+
+    /**
+     * Test whether an edge can be collapsed onto a point without changing the topology, folding a triangle
+     * over or creating an edge longer than a limit
+     * @param h         half-edge whose origin is removed, which must not be locked
+     * @param pnt       position of the surviving vertex
+     * @param maxsqrlen largest squared edge length allowed around the surviving vertex
+     */
+    bool canCollapse(int h, const cgp::Point &pnt, float maxsqrlen) const;
+
+    /**
+     * Collapse an interior edge, removing its origin vertex and two triangles. Check @a canCollapse first.
+     * @param h     half-edge whose origin is removed
+     * @param pnt   new position of the surviving vertex
+     */
+    void collapse(int h, const cgp::Point &pnt);
+
+    /**
+     * Test whether flipping an interior edge keeps the mesh manifold and both new triangles facing the same
+     * way as the old ones
+     * @param h     half-edge of the edge to flip
+     */
+    bool canFlip(int h) const;
+
+    /**
+     * Replace an interior edge with the other diagonal of its two triangles. Check @a canFlip first.
+     * @param h     half-edge of the edge to flip
+     */
+    void flip(int h);
+
+private:
+    /// Set the vertices of triangle f
+    void setTri(int f, int a, int b, int c);
+
+    /// Make two half-edges opposite each other, either of which may be -1
+    void link(int h, int g);
+};
+
+/**
+ * Counts and timing for @a Mesh::remesh
+ */
+struct RemeshReport
+{
+    int splits;         ///< edges split
+    int collapses;      ///< edges collapsed
+    int flips;          ///< edges flipped
+    double seconds;     ///< elapsed time
+    double trispersec;  ///< output triangles times iterations per second
+};
+
+/**
+ * Isotropic remeshing (Botsch and Kobbelt): repeatedly split edges longer than 4/3 of the target length,
+ * collapse edges shorter than 4/5 of it, flip edges to bring vertex valences towards 6, and relax vertices
+ * tangentially towards the centroid of their neighbours before projecting them back onto the original surface.
+ * Relaxation and projection run in parallel. Edges whose faces meet at more than the feature angle are creases:
+ * they are split into creases but never flipped, collapsed only along their own line and never across, and
+ * vertices on them are not relaxed, so sharp edges and corners are kept.
+ * @param[in,out] hem       mesh to remesh
+ * @param pnts, tris        original surface to project onto
+ * @param targetlen         target edge length
+ * @param iterations        number of rounds of split, collapse, flip and relax
+ * @param[out] report       counts of each operation and timing
+ * @param featureangle      smallest angle between face normals, in degrees, treated as a crease, 0 for none
+ * @param numthreads        number of threads to use, 0 for one per core
+ */
+void isotropicRemesh(HalfEdgeMesh &hem, const std::vector<cgp::Point> &pnts, const std::vector<Triangle> &tris,
+                     float targetlen, int iterations, RemeshReport &report, float featureangle = 45.0f, int numthreads = 0);
+
+#endif
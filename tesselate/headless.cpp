@@ -0,0 +1,210 @@
+#include <GL/glew.h>
+#include "headless.h"
+#include <iostream>
+#include <mutex>
+#include <QImage>
+#include <EGL/egl.h>
+
+// EGL_KHR_create_context and EGL_MESA_platform_surfaceless tokens, absent from older EGL headers
+#ifndef EGL_CONTEXT_MAJOR_VERSION_KHR
+#define EGL_CONTEXT_MAJOR_VERSION_KHR 0x3098
+#endif
+#ifndef EGL_CONTEXT_MINOR_VERSION_KHR
+#define EGL_CONTEXT_MINOR_VERSION_KHR 0x30FB
+#endif
+#ifndef EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR
+#define EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR 0x30FD
+#endif
+#ifndef EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR
+#define EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR 0x00000001
+#endif
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+using namespace std;
+
+typedef EGLDisplay (* GetPlatformDisplayProc)(EGLenum platform, void * native_display, const EGLint * attrib_list);
+
+static std::mutex displayMutex;                 ///< guards one-off initialisation of the shared display
+static EGLDisplay sharedDisplay = EGL_NO_DISPLAY; ///< EGL connection shared by all canvases
+static std::mutex glewMutex;                    ///< guards loading of the process-wide GLEW entry points
+static bool glewReady = false;                  ///< have the GLEW entry points been loaded
+
+HeadlessCanvas::HeadlessCanvas()
+{
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+    fbo = colourRB = depthRB = 0;
+    width = height = 0;
+}
+
+HeadlessCanvas::~HeadlessCanvas()
+{
+    if(context != EGL_NO_CONTEXT)
+    {
+        // framebuffer objects only exist once the GLEW entry points have been loaded
+        if(fbo != 0 && makeCurrent())
+        {
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(1, &colourRB);
+            glDeleteRenderbuffers(1, &depthRB);
+        }
+        eglMakeCurrent((EGLDisplay) display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay) display, (EGLContext) context);
+    }
+}
+
+bool HeadlessCanvas::initDisplay()
+{
+    std::lock_guard<std::mutex> lock(displayMutex);
+    EGLint major, minor;
+
+    if(sharedDisplay == EGL_NO_DISPLAY)
+    {
+        EGLDisplay dpy = EGL_NO_DISPLAY;
+
+        // surfaceless platform first, then whatever the implementation offers by default
+        GetPlatformDisplayProc getPlatformDisplay = (GetPlatformDisplayProc) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if(getPlatformDisplay != NULL)
+            dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if(dpy == EGL_NO_DISPLAY)
+            dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if(dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor))
+        {
+            cerr << "Error HeadlessCanvas::initDisplay: unable to initialise EGL" << endl;
+            return false;
+        }
+        if(!eglBindAPI(EGL_OPENGL_API))
+        {
+            cerr << "Error HeadlessCanvas::initDisplay: EGL implementation does not support desktop OpenGL" << endl;
+            return false;
+        }
+        sharedDisplay = dpy;
+    }
+    display = sharedDisplay;
+    return true;
+}
+
+bool HeadlessCanvas::initGlew()
+{
+    std::lock_guard<std::mutex> lock(glewMutex);
+
+    if(!glewReady)
+    {
+        // glewInit would also look for a GLX display, which does not exist here, so only load the core
+        // and extension entry points of the current context
+        glewExperimental = GL_TRUE;
+        GLenum err = glewContextInit();
+        if(err != GLEW_OK)
+        {
+            cerr << "Error HeadlessCanvas::initGlew: " << (const char *) glewGetErrorString(err) << endl;
+            return false;
+        }
+        glGetError(); // glewContextInit can leave a spurious GL_INVALID_ENUM on core contexts
+        glewReady = true;
+    }
+    return true;
+}
+
+bool HeadlessCanvas::init(int w, int h)
+{
+    EGLConfig config;
+    EGLint numconfigs;
+    GLenum status;
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24,
+        EGL_NONE };
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 2,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE };
+
+    width = w; height = h;
+    if(!initDisplay())
+        return false;
+
+    // eglBindAPI is per-thread state, so repeat it for canvases created on worker threads
+    eglBindAPI(EGL_OPENGL_API);
+    if(!eglChooseConfig((EGLDisplay) display, configAttribs, &config, 1, &numconfigs) || numconfigs < 1)
+    {
+        cerr << "Error HeadlessCanvas::init: no suitable EGL framebuffer configuration" << endl;
+        return false;
+    }
+    context = eglCreateContext((EGLDisplay) display, config, EGL_NO_CONTEXT, contextAttribs);
+    if(context == EGL_NO_CONTEXT)
+    {
+        cerr << "Error HeadlessCanvas::init: unable to create OpenGL 3.2 core context" << endl;
+        return false;
+    }
+
+    // no window or pbuffer surface, all output goes to a framebuffer object
+    if(!eglMakeCurrent((EGLDisplay) display, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext) context))
+    {
+        cerr << "Error HeadlessCanvas::init: surfaceless contexts are not supported" << endl;
+        return false;
+    }
+    if(!initGlew())
+        return false;
+
+    glGenRenderbuffers(1, &colourRB); CE();
+    glBindRenderbuffer(GL_RENDERBUFFER, colourRB); CE();
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height); CE();
+    glGenRenderbuffers(1, &depthRB); CE();
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRB); CE();
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height); CE();
+
+    glGenFramebuffers(1, &fbo); CE();
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo); CE();
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourRB); CE();
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRB); CE();
+    status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if(status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        cerr << "Error HeadlessCanvas::init: incomplete framebuffer, status = " << status << endl;
+        return false;
+    }
+    return makeCurrent();
+}
+
+bool HeadlessCanvas::makeCurrent()
+{
+    if(!eglMakeCurrent((EGLDisplay) display, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext) context))
+        return false;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo); CE();
+    glViewport(0, 0, width, height); CE();
+    return true;
+}
+
+void HeadlessCanvas::readPixels(std::vector<unsigned char> &pixels)
+{
+    std::vector<unsigned char> rows(width * height * 3);
+    int y, rowbytes = width * 3;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo); CE();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1); CE();
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid *) &rows[0]); CE();
+
+    // OpenGL returns the bottom row first
+    pixels.resize(rows.size());
+    for(y = 0; y < height; y++)
+        std::copy(rows.begin() + (height-1-y) * rowbytes, rows.begin() + (height-y) * rowbytes, pixels.begin() + y * rowbytes);
+}
+
+bool HeadlessCanvas::saveImage(const std::string &filename)
+{
+    std::vector<unsigned char> pixels;
+
+    readPixels(pixels);
+    QImage img(&pixels[0], width, height, width * 3, QImage::Format_RGB888);
+    if(!img.save(QString::fromStdString(filename)))
+    {
+        cerr << "Error HeadlessCanvas::saveImage: unable to write " << filename << endl;
+        return false;
+    }
+    return true;
+}
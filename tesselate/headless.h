@@ -0,0 +1,73 @@
+#ifndef _headless_h
+#define _headless_h
+/**
+ * @file
+ *
+ * Offscreen OpenGL rendering without a window system, for batch generation of thumbnails.
+ */
+
+#include "glheaders.h"
+#include <string>
+#include <vector>
+
+/**
+ * OpenGL 3.2 core context created through EGL, rendering into a framebuffer object rather than a window.
+ * Requires no display server. One instance is needed per rendering thread, since a context can only be
+ * current on a single thread at a time.
+ */
+class HeadlessCanvas
+{
+private:
+    void * display;             ///< EGLDisplay connection, shared by all canvases in the process
+    void * context;             ///< EGLContext owned by this canvas
+    GLuint fbo;                 ///< framebuffer object receiving rendered output
+    GLuint colourRB, depthRB;   ///< colour and depth renderbuffers attached to the fbo
+    int width, height;          ///< dimensions of the framebuffer in pixels
+
+    /// Connect to EGL, preferring a surfaceless platform so that no X server or GPU device node is needed
+    bool initDisplay();
+
+    /// Load the OpenGL entry points through GLEW once a context is current, since no window ever calls glewInit
+    bool initGlew();
+
+public:
+
+    /// Constructor. No EGL or OpenGL calls are made until @a init
+    HeadlessCanvas();
+
+    /// Destructor, releases the context and framebuffer
+    ~HeadlessCanvas();
+
+    /**
+     * Create the context and framebuffer, and make the context current on the calling thread
+     * @param w, h  dimensions of the framebuffer in pixels
+     * @retval true  if a context with an attached framebuffer was created,
+     * @retval false otherwise
+     */
+    bool init(int w, int h);
+
+    /// Bind the context and framebuffer to the calling thread and set the viewport to the full framebuffer
+    bool makeCurrent();
+
+    /// Getter for framebuffer width
+    int getWidth(){ return width; }
+
+    /// Getter for framebuffer height
+    int getHeight(){ return height; }
+
+    /**
+     * Read back the framebuffer as 8-bit RGB rows, top row first
+     * @param[out] pixels   width * height * 3 bytes of image data
+     */
+    void readPixels(std::vector<unsigned char> &pixels);
+
+    /**
+     * Save the framebuffer to an image file. The format is chosen from the file extension.
+     * @param filename  name of image file to write
+     * @retval true  if the image was written,
+     * @retval false otherwise
+     */
+    bool saveImage(const std::string &filename);
+};
+
+#endif
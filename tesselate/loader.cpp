@@ -0,0 +1,61 @@
+#include "loader.h"
+
+const int previewtris[MeshLoader::numPreviews] = { 16384, 131072, 1048576 }; ///< triangle budget of each preview level
+
+MeshLoader::MeshLoader(const std::string &filename, float fitsize, ValidationPolicy validation, QObject *parent)
+    : QThread(parent),
+      filename(filename),
+      fitsize(fitsize),
+      validation(validation),
+      lastpercent(0),
+      progress([this] (float done)
+               {
+                   int percent = (int) (done * 100.0f);
+                   if(percent != lastpercent)
+                   {
+                       lastpercent = percent;
+                       emit progressChanged(percent);
+                   }
+               })
+{
+}
+
+MeshLoader::~MeshLoader()
+{
+    cancel();
+    wait();
+}
+
+void MeshLoader::run()
+{
+    if(!mesh.parseSTL(filename, &progress))
+    {
+        emit loadFinished(false);
+        return;
+    }
+
+    // something to look at while the full mesh is welded and validated, starting with a preview that is
+    // quick to display and refining it while the previous level is being uploaded
+    for(int level = 0; level < numPreviews && previewtris[level] < (int) mesh.getTris().size(); level++)
+    {
+        if(progress.cancelled())
+        {
+            emit loadFinished(false);
+            return;
+        }
+        mesh.decimate(previews[level], previewtris[level]);
+        previews[level].boxFit(fitsize);
+        emit previewReady(level);
+    }
+
+    if(!mesh.weld(&progress))
+    {
+        emit loadFinished(false);
+        return;
+    }
+    mesh.validate(validation, &progress, validationListener);
+    if(progress.cancelled()) // a BACKGROUND validation would otherwise carry on for a load nobody wants
+        mesh.cancelValidation();
+    mesh.boxFit(fitsize);
+    emit loadFinished(!progress.cancelled());
+}
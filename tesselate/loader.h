@@ -0,0 +1,93 @@
+#ifndef _loader_h
+#define _loader_h
+/**
+ * @file
+ *
+ * Background loading of meshes, keeping the user interface responsive.
+ */
+
+#include <QThread>
+#include <string>
+#include <common/progress.h>
+#include "mesh.h"
+
+/**
+ * Loads an STL file on a worker thread. Decimated previews of increasing density are published as soon as
+ * the raw triangles are parsed, followed by the full mesh once welding and validation are done. Signals are delivered to
+ * receivers in the GUI thread as queued connections, after which the corresponding mesh may be taken
+ * with Mesh::takeGeometry.
+ */
+class MeshLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Constructor. Loading begins on a call to start().
+     * @param filename  name of STL file to load
+     * @param fitsize   side length of the bounding cube that the loaded mesh is scaled to fit
+     * @param validation    validity tests to run once the mesh is welded
+     * @param parent    owning Qt object
+     */
+    MeshLoader(const std::string &filename, float fitsize, ValidationPolicy validation = ValidationPolicy::FULL, QObject *parent = 0);
+
+    /// Destructor, cancels and waits for any load still in progress
+    ~MeshLoader();
+
+    /// Getter for the fully loaded mesh, valid once loadFinished(true) has been signalled
+    Mesh * getMesh(){ return &mesh; }
+
+    /// Number of preview levels, from coarsest to finest
+    static const int numPreviews = 3;
+
+    /**
+     * Getter for a preview mesh, valid once previewReady has been signalled for its level
+     * @param level     preview level, from 0 (coarsest) to numPreviews - 1
+     */
+    Mesh * getPreview(int level){ return &previews[level]; }
+
+    /// Getter for the name of the file being loaded
+    const std::string &getFilename(){ return filename; }
+
+    /// Request that the load stop as soon as possible. Thread-safe.
+    void cancel(){ progress.cancel(); }
+
+    /**
+     * Setter for a callback receiving the validation results, passed on to Mesh::validate. With the
+     * BACKGROUND policy it may be called after loadFinished, and after the loader has been destroyed,
+     * since the validation moves with the mesh taken from getMesh. It is not called once cancelled.
+     */
+    void setValidationListener(std::function<void(const MeshValidity &)> listener){ validationListener = listener; }
+
+signals:
+
+    /// signal a change in the percentage of the load completed
+    void progressChanged(int percent);
+
+    /**
+     * signal that a decimated preview of the mesh is available. Levels arrive in increasing order, and
+     * levels that would not be coarser than the mesh itself are skipped.
+     */
+    void previewReady(int level);
+
+    /// signal that loading has ended, either successfully or through failure or cancellation
+    void loadFinished(bool success);
+
+protected:
+
+    /// Parse, preview, weld and validate on the worker thread
+    void run();
+
+private:
+    std::string filename;   ///< STL file to load
+    float fitsize;          ///< bounding cube side length for boxFit
+    ValidationPolicy validation;    ///< validity tests to run on the loaded mesh
+    std::function<void(const MeshValidity &)> validationListener; ///< receives validation results
+    Mesh mesh;              ///< full resolution mesh, built on the worker thread
+    Mesh previews[numPreviews]; ///< decimated meshes of increasing density, built on the worker thread
+    int lastpercent;        ///< last percentage signalled, to avoid flooding the GUI event queue
+    Progress progress;      ///< progress and cancellation shared with the mesh operations
+};
+
+#endif
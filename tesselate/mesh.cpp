@@ -3,6 +3,11 @@
 //
 
 #include "mesh.h"
+#include "bvh.h"
+#include "voxel.h"
+#include "sdf.h"
+#include "halfedge.h"
+#include "generate.h"
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
@@ -16,11 +21,96 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtx/intersect.hpp>
-#include <unordered_map>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <common/parallel.h>
+#include <common/unionfind.h>
+#include <common/mathutils.h>
+#include <common/timer.h>
+#include <common/stats.h>
+#include <common/arena.h>
+#include <common/flat_map.h>
 
 using namespace std;
 using namespace cgp;
 
+// profiling spans for the load, validation and upload pipeline, nested as the calls are
+static stats::TimeInit timeReadSTL("mesh.readSTL");
+static stats::TimeInit timeParseSTL("mesh.parseSTL");
+static stats::TimeInit timeWeld("mesh.weld");
+static stats::TimeInit timeMergeVerts("mesh.mergeVerts");
+static stats::TimeInit timeDeriveVertNorms("mesh.deriveVertNorms");
+static stats::TimeInit timeValidate("mesh.validate");
+static stats::TimeInit timeCreateEdges("mesh.createEdges");
+static stats::TimeInit timeCheckBasic("mesh.checkBasic");
+static stats::TimeInit timeCheckManifold("mesh.checkManifold");
+static stats::TimeInit timeGenGeometry("mesh.genGeometry", true); // on every slider move, so the latency is kept
+
+// memory held by each part of the pipeline, reported by stats::reportStats with peaks
+static stats::MemoryAccount memMeshCore("mesh.core");
+static stats::MemoryAccount memReadBuffer("mesh.readBuffer");
+static stats::MemoryAccount memTopology("mesh.topology"); // welding lookups and edge lists
+
+/// Bytes held by a vector
+template<typename T>
+static std::int64_t vectorBytes(const std::vector<T> &v)
+{
+    return (std::int64_t) (v.capacity() * sizeof(T));
+}
+
+/// Lookup table drawing from the arena of one operation
+template<typename Key, typename T>
+using ArenaFlatMap = FlatMap<Key, T, std::hash<Key>, ArenaAllocator<std::pair<Key, T> > >;
+
+/**
+ * Estimate the memory mergeVerts allocates: the welded vertices, at worst one per vertex, the flat weld
+ * table reserved for every vertex and the remapping of each vertex
+ * @param numverts  vertices before welding
+ * @retval estimated bytes
+ */
+static std::int64_t weldFootprint(std::int64_t numverts)
+{
+    return numverts * (std::int64_t) (sizeof(cgp::Point) + sizeof(int))
+        + (std::int64_t) ArenaFlatMap<long, int>::reserveBytes((std::size_t) numverts);
+}
+
+/**
+ * Estimate the memory validation allocates: the edge list, one and a half edges per triangle, alongside
+ * the flat table keyed by edge that createEdges and checkManifold each reserve in turn, and the per vertex
+ * counts of checkManifold
+ * @param numverts  vertices in the mesh
+ * @param numtris   triangles in the mesh
+ * @retval estimated bytes
+ */
+static std::int64_t validationFootprint(std::int64_t numverts, std::int64_t numtris)
+{
+    std::int64_t numedges = numtris * 3 / 2;
+    return numedges * (std::int64_t) sizeof(Edge) + numverts * (std::int64_t) sizeof(int)
+        + (std::int64_t) ArenaFlatMap<uint64_t, int>::reserveBytes((std::size_t) numedges);
+}
+
+/**
+ * Estimate the most memory held at once while loading an STL file: the file buffer alongside the
+ * triangle soup read from it, or later the soup alongside what welding it allocates
+ * @param filesize  bytes in the file
+ * @retval estimated bytes
+ */
+static std::int64_t loadFootprint(std::int64_t filesize)
+{
+    std::int64_t numt = std::max((std::int64_t) 0, (filesize - 84) / 50);
+    std::int64_t soup = numt * (std::int64_t) (3 * sizeof(cgp::Point) + sizeof(Triangle));
+    return soup + std::max(filesize, weldFootprint(3 * numt));
+}
+
+// event counts, reported by stats::reportStats
+static stats::Counter statTrianglesParsed("mesh.trianglesParsed");
+static stats::Counter statWelds("mesh.welds");
+static stats::Counter statTriTriTests("mesh.triTriTests");
+
 GLfloat stdCol[] = {0.7f, 0.7f, 0.75f, 0.4f};
 const int raysamples = 5;
 
@@ -35,7 +125,7 @@ bool Sphere::pointInSphere(cgp::Point pnt)
         return false;
 }
 
-bool Mesh::findVert(cgp::Point pnt, int &idx)
+bool Mesh::findVert(const cgp::Point &pnt, int &idx) const
 {
     bool found = false;
     int i = 0;
@@ -54,7 +144,7 @@ bool Mesh::findVert(cgp::Point pnt, int &idx)
     return found;
 }
 
-bool Mesh::findEdge(vector<Edge> edges, Edge e, int &idx)
+bool Mesh::findEdge(const vector<Edge> &edges, const Edge &e, int &idx) const
 {
     bool found = false;
     int i = 0;
@@ -73,11 +163,18 @@ bool Mesh::findEdge(vector<Edge> edges, Edge e, int &idx)
     return found;
 }
 
-long Mesh::hashVert(cgp::Point pnt, cgp::BoundBox bbox)
+long Mesh::weldCells(long numtris)
+{
+    // three cell coordinates of up to 2^20 + 1 values each still give a key within 63 bits
+    const double maxcells = (double) (1L << 20);
+    return (long) min(maxcells, max((double) weldcells, 8.0 * sqrt((double) numtris)));
+}
+
+long Mesh::hashVert(const cgp::Point &pnt, const cgp::BoundBox &bbox, long cells) const
 {
     long x, y, z;
-    float range = 2500.0f;
-    long lrangesq, lrange = 2500;
+    float range = (float) cells;
+    long lrangesq, lrange = cells + 1; // a coordinate reaches cells when the box is flat along the other axes
 
     lrangesq = lrange * lrange;
 
@@ -88,26 +185,44 @@ long Mesh::hashVert(cgp::Point pnt, cgp::BoundBox bbox)
     return x+y+z;
 }
 
-void Mesh::mergeVerts()
+bool Mesh::mergeVerts(const ProgressRange &range)
 {
     vector<cgp::Point> cleanverts;
-    long key;
+    long key, cells;
     int i, p, hitcount = 0;
     // use hashmap to quickly look up vertices with the same coordinates
-    std::unordered_map<long, int> idxlookup; // key is concatenation of vertex position, value is index into the cleanverts vector
+    Arena arena;
+    ArenaFlatMap<long, int> idxlookup{ArenaAllocator<std::pair<long, int> >(arena)}; // key is concatenation of vertex position, value is index into the cleanverts vector
+    uts::arena_vector<int> remap{ArenaAllocator<int>(arena)}; // index into cleanverts of each original vertex
     cgp::BoundBox bbox;
+    stats::Span span(timeMergeVerts);
+    stats::MemoryCharge lookupmem;
+
+    // the soup is already held, so only what welding adds is checked against the budget
+    if(!stats::fitsMemoryBudget(weldFootprint((std::int64_t) verts.size())))
+    {
+        cerr << "Error Mesh::mergeVerts: welding " << verts.size() << " vertices needs about " << weldFootprint((std::int64_t) verts.size())
+             << " bytes, with " << stats::memoryInUse() << " in use the memory budget of " << stats::getMemoryBudget() << " would be exceeded" << endl;
+        return false;
+    }
 
     // construct a bounding box enclosing all vertices
     for(i = 0; i < (int) verts.size(); i++)
         bbox.includePnt(verts[i]);
 
     // remove duplicate vertices
+    cells = weldCells((long) tris.size());
+    idxlookup.reserve(verts.size());
+    remap.resize(verts.size());
     for(i = 0; i < (int) verts.size(); i++)
     {
-        key = hashVert(verts[i], bbox);
-        if(idxlookup.find(key) == idxlookup.end()) // key not in map
+        if(!range.check(i, (long) verts.size())) // nothing has been changed yet
+            return false;
+        key = hashVert(verts[i], bbox, cells);
+        auto ins = idxlookup.insert(key, (int) cleanverts.size());
+        remap[i] = * ins.first;
+        if(ins.second) // key not in map, so put index in map for quick lookup
         {
-            idxlookup[key] = (int) cleanverts.size(); // put index in map for quick lookup
             cleanverts.push_back(verts[i]);
         }
         else
@@ -115,27 +230,26 @@ void Mesh::mergeVerts()
             hitcount++;
         }
     }
-    cerr << "num duplicate vertices found = " << hitcount << " of " << (int) verts.size() << endl;
-    cerr << "clean verts = " << (int) cleanverts.size() << endl;
-    cerr << "bbox min = " << bbox.min.x << ", " << bbox.min.y << ", " << bbox.min.z << endl;
-    cerr << "bbox max = " << bbox.max.x << ", " << bbox.max.y << ", " << bbox.max.z << endl;
-    cerr << "bbox diag = " << bbox.diagLen() << endl;
-
-
-    // re-index triangles
+    lookupmem.set(memTopology, (std::int64_t) arena.bytesReserved() + vectorBytes(cleanverts));
+    statWelds.add(hitcount);
+    stats::printStat("mesh.mergeVerts.verts", (int) verts.size());
+    stats::printStat("mesh.mergeVerts.duplicates", hitcount);
+    stats::printStat("mesh.mergeVerts.cleanVerts", (int) cleanverts.size());
+    stats::printStat("mesh.mergeVerts.bboxDiag", bbox.diagLen());
+
+    // re-index triangles, through the index each vertex was given above rather than hashing it again
     for(i = 0; i < (int) tris.size(); i++)
         for(p = 0; p < 3; p++)
         {
-            key = hashVert(verts[tris[i].v[p]], bbox);
-            if(idxlookup.find(key) != idxlookup.end())
-                tris[i].v[p] = idxlookup[key];
+            if(tris[i].v[p] >= 0 && tris[i].v[p] < (int) remap.size())
+                tris[i].v[p] = remap[tris[i].v[p]];
             else
                 cerr << "Error Mesh::mergeVerts: vertex not found in map" << endl;
-
         }
 
-    verts.clear();
-    verts = cleanverts;
+    verts.swap(cleanverts);
+    chargeMemory();
+    return true;
 }
 
 void Mesh::deriveVertNorms()
@@ -143,8 +257,10 @@ void Mesh::deriveVertNorms()
     vector<int> vinc; // number of faces incident on vertex
     int p, t;
     cgp::Vector n;
+    stats::Span span(timeDeriveVertNorms);
 
     // init structures
+    norms.clear();
     for(p = 0; p < (int) verts.size(); p++)
     {
         vinc.push_back(0);
@@ -168,6 +284,7 @@ void Mesh::deriveVertNorms()
         norms[p].mult(1.0f/((float) vinc[p]));
         norms[p].normalize();
     }
+    chargeMemory();
 }
 
 void Mesh::deriveFaceNorms()
@@ -206,6 +323,7 @@ Mesh::Mesh()
     scale = 1.0f;
     xrot = yrot = zrot = 0.0f;
     trx = cgp::Vector(0.0f, 0.0f, 0.0f);
+    eulerchar = 0;
 }
 
 Mesh::~Mesh()
@@ -215,9 +333,12 @@ Mesh::~Mesh()
 
 void Mesh::clear()
 {
+    cancelValidation();
     verts.clear();
+    norms.clear();
     tris.clear();
     geom.clear();
+    chargeMemory();
     col = stdCol;
     scale = 1.0f;
     xrot = yrot = zrot = 0.0f;
@@ -225,13 +346,20 @@ void Mesh::clear()
     for(int i = 0; i < (int) boundspheres.size(); i++)
         boundspheres[i].ind.clear();
     boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+}
+
+void Mesh::chargeMemory()
+{
+    memory.set(memMeshCore, vectorBytes(verts) + vectorBytes(norms) + vectorBytes(tris));
 }
 
-bool Mesh::genGeometry(View * view, ShapeDrawData &sdd)
+bool Mesh::genGeometry(View * view, std::vector<ShapeDrawData> &sdds)
 {
     vector<int> faces;
     int t, p;
     glm::mat4x4 tfm;
+    stats::Span span(timeGenGeometry);
 
     geom.clear();
     geom.setColour(col);
@@ -264,7 +392,7 @@ bool Mesh::genGeometry(View * view, ShapeDrawData &sdd)
     // bind geometry to buffers and return drawing parameters, if possible
     if(geom.bindBuffers(view))
     {
-        sdd = geom.getDrawParameters();
+        geom.getDrawParameters(sdds);
         return true;
     }
     else
@@ -307,7 +435,23 @@ void Mesh::boxFit(float sidelen)
     }
 }
 
-bool Mesh::readSTL(string filename)
+bool Mesh::readSTL(string filename, ValidationPolicy validation, Progress * progress)
+{
+    stats::Span span(timeReadSTL);
+
+    if(!parseSTL(filename, progress))
+        return false;
+
+    cerr << "num vertices = " << (int) verts.size() << endl;
+    cerr << "num triangles = " << (int) tris.size() << endl;
+
+    if(!weld(progress))
+        return false;
+    validate(validation, progress);
+    return true;
+}
+
+bool Mesh::parseSTL(string filename, Progress * progress)
 {
     ifstream infile;
     char * inbuffer;
@@ -315,6 +459,9 @@ bool Mesh::readSTL(string filename)
     int insize, inpos, numt, t, i;
     cgp::Point vpos;
     Triangle tri;
+    ProgressRange range(progress, 0.0f, 0.6f);
+    stats::Span span(timeParseSTL);
+    stats::MemoryCharge readmem; // released with the buffer when parsing ends
 
     // assumes binary format STL file
     infile.open((char *) filename.c_str(), ios_base::in | ios_base::binary);
@@ -326,12 +473,22 @@ bool Mesh::readSTL(string filename)
         stat((char *) filename.c_str(), &results);
         insize = results.st_size;
 
+        // refuse before allocating anything if the load would go over the memory budget
+        if(!stats::fitsMemoryBudget(loadFootprint(insize)))
+        {
+            cerr << "Error Mesh::readSTL: loading " << filename << " needs about " << loadFootprint(insize) << " bytes, with "
+                 << stats::memoryInUse() << " in use the memory budget of " << stats::getMemoryBudget() << " would be exceeded" << endl;
+            return false;
+        }
+
         // put file contents in buffer
         inbuffer = new char[insize];
+        readmem.set(memReadBuffer, insize);
         infile.read(inbuffer, insize);
         if(!infile) // failed to read from the file for some reason
         {
             cerr << "Error Mesh::readSTL: unable to populate read buffer" << endl;
+            delete [] inbuffer;
             return false;
         }
 
@@ -339,21 +496,33 @@ bool Mesh::readSTL(string filename)
         if(insize <= 84)
         {
             cerr << "Error Mesh::readSTL: invalid STL binary file, too small" << endl;
+            delete [] inbuffer;
             return false;
         }
 
         inpos = 80; // skip 80 character header
-        if(inpos+4 >= insize){ cerr << "Error Mesh::readSTL: malformed header on stl file" << endl; return false; }
+        if(inpos+4 >= insize){ cerr << "Error Mesh::readSTL: malformed header on stl file" << endl; delete [] inbuffer; return false; }
         numt = (int) (* ((long *) &inbuffer[inpos]));
         inpos += 4;
 
+        // the header count may be wrong, so reserve no more than the file can hold
+        verts.reserve(3 * (size_t) max(0, min(numt, (insize - 84) / 50)));
+        tris.reserve((size_t) max(0, min(numt, (insize - 84) / 50)));
+
         t = 0;
 
         // triangle vertices have consistent outward facing clockwise winding (right hand rule)
         while(t < numt) // read in triangle data
         {
+            if(!range.check(t, numt))
+            {
+                delete [] inbuffer;
+                clear();
+                return false;
+            }
+
             // normal
-            if(inpos+12 >= insize){ cerr << "Error Mesh::readSTL: malformed stl file" << endl; return false; }
+            if(inpos+12 >= insize){ cerr << "Error Mesh::readSTL: malformed stl file" << endl; delete [] inbuffer; return false; }
             // IEEE floating point 4-byte binary numerical representation, IEEE754, little endian
             tri.n = cgp::Vector((* ((float *) &inbuffer[inpos])), (* ((float *) &inbuffer[inpos+4])), (* ((float *) &inbuffer[inpos+8])));
             inpos += 12;
@@ -361,7 +530,7 @@ bool Mesh::readSTL(string filename)
             // vertices
             for(i = 0; i < 3; i++)
             {
-                if(inpos+12 >= insize){ cerr << "Error Mesh::readSTL: malformed stl file" << endl; return false; }
+                if(inpos+12 >= insize){ cerr << "Error Mesh::readSTL: malformed stl file" << endl; delete [] inbuffer; return false; }
                 vpos = cgp::Point((* ((float *) &inbuffer[inpos])), (* ((float *) &inbuffer[inpos+4])), (* ((float *) &inbuffer[inpos+8])));
                 tri.v[i] = (int) verts.size();
                 verts.push_back(vpos);
@@ -371,27 +540,12 @@ bool Mesh::readSTL(string filename)
             t++;
             inpos += 2; // handle attribute byte count - which can simply be discarded
         }
+        statTrianglesParsed.add(numt);
+        chargeMemory();
 
         // tidy up
-        delete inbuffer;
+        delete [] inbuffer;
         infile.close();
-
-        cerr << "num vertices = " << (int) verts.size() << endl;
-        cerr << "num triangles = " << (int) tris.size() << endl;
-
-        // STL provides a triangle soup so merge vertices that are coincident
-        mergeVerts();
-        // normal vectors at vertices are needed for rendering so derive from incident faces
-        deriveVertNorms();
-        if(basicValidity())
-            cerr << "loaded file has basic validity" << endl;
-        else
-            cerr << "loaded file does not pass basic validity" << endl;
-            
-        if(manifoldValidity())
-            cerr << "loaded file has manifold validity" << endl;
-        else
-            cerr << "loaded file does not pass manifold validity" << endl;
     }
     else
     {
@@ -401,263 +555,1864 @@ bool Mesh::readSTL(string filename)
     return true;
 }
 
-bool Mesh::writeSTL(string filename)
+bool Mesh::weld(Progress * progress)
 {
-    ofstream outfile;
-    int t, p, numt;
-    unsigned short val;
+    stats::Span span(timeWeld);
 
-    outfile.open((char *) filename.c_str(), ios_base::out | ios_base::binary);
-    if(outfile.is_open())
+    if(progress != NULL && !progress->update(0.6f))
     {
-        outfile.write("File Generated by Tesselator. Binary STL", 80); // skippable header
-        numt = (int) tris.size();
-        outfile.write((char *) &numt, 4); // number of triangles
-
-        for(t = 0; t < numt; t++)
-        {
-            // normal
-            outfile.write((char *) &tris[t].n.i, 4);
-            outfile.write((char *) &tris[t].n.j, 4);
-            outfile.write((char *) &tris[t].n.k, 4);
-
-            // triangle vertices
-            for(p = 0; p < 3; p++)
-            {
-                outfile.write((char *) &verts[tris[t].v[p]].x, 4);
-                outfile.write((char *) &verts[tris[t].v[p]].y, 4);
-                outfile.write((char *) &verts[tris[t].v[p]].z, 4);
-            }
-
-            // attribute byte count - null
-            val = 0;
-            outfile.write((char *) &val, 2);
-        }
+        clear();
+        return false;
+    }
 
-        // tidy up
-        outfile.close();
+    // STL provides a triangle soup so merge vertices that are coincident
+    if(!mergeVerts(ProgressRange(progress, 0.6f, 0.7f)) || (progress != NULL && !progress->update(0.7f)))
+    {
+        clear();
+        return false;
     }
-    else
+
+    // normal vectors at vertices are needed for rendering so derive from incident faces
+    deriveVertNorms();
+    if(progress != NULL && !progress->update(0.8f))
     {
-        cerr << "Error Mesh::writeSTL: unable to open " << filename << endl;
+        clear();
         return false;
     }
     return true;
 }
 
-// finds all the edges based on the triangles in tris, stores edges in a vector
-// uses unordered_map to keep track of which edges are in the vector already
-vector<Edge> Mesh::createEdges(cgp::BoundBox bbox){
-	unordered_map<long, int> index;
-	vector<Edge> edges;
-	long key = 0;
-	int pos = 0;
-	// loops through all the triangles
-	for (int i=0; i<(int)tris.size(); i++){
-		Edge temp1,temp2,temp3;
-		bool incpos1 = false, incpos2 = false, incpos3 = false;
-		
-		// first edge of triangle
-		temp1.v[0] = tris[i].v[0];
-		temp1.v[1] = tris[i].v[1];
-		temp1.oriented = false;
-		if (hashVert(verts[temp1.v[0]],bbox) == 0){
-			key = hashVert(verts[temp1.v[1]],bbox);
-		}
-		else if (hashVert(verts[temp1.v[1]],bbox) == 0){
-			key = hashVert(verts[temp1.v[0]],bbox);
-		}
-		else {
-			key = hashVert(verts[temp1.v[0]],bbox) * hashVert(verts[temp1.v[1]],bbox);
-		}
-		
-		if (index.find(key) == index.end()){
-			edges.push_back(temp1);
-			index[key] = pos;
-			incpos1 = true;
-			//cerr << index[key] << endl;
-		}
-		else{
-			if (edges[index[key]].v[1] == temp1.v[0] && edges[index[key]].v[0] == temp1.v[1]){
-    			edges[index[key]].oriented = true;
-    		}	
-		}
-		if (incpos1 == true){
-			pos += 1;
-		}
-		
-		//second edge of triangle
-		temp2.v[0] = tris[i].v[1];
-		temp2.v[1] = tris[i].v[2];
-		temp2.oriented = false;
-		if (hashVert(verts[temp2.v[0]],bbox) == 0){
-			key = hashVert(verts[temp2.v[1]],bbox);
-		}
-		else if (hashVert(verts[temp2.v[1]],bbox) == 0){
-			key = hashVert(verts[temp2.v[0]],bbox);
-		}
-		else {
-			key = hashVert(verts[temp2.v[0]],bbox) * hashVert(verts[temp2.v[1]],bbox);
-		}
-		
-		if (index.find(key) == index.end()){
-			edges.push_back(temp2);
-			index[key] = pos;
-			incpos2 = true;	
-		}
-		else{
-			if (edges[index[key]].v[1] == temp2.v[0] && edges[index[key]].v[0] == temp2.v[1]){
-    			edges[index[key]].oriented = true;
-    		}	
-		}
-		if (incpos2 == true){
-			pos += 1;
-		}
-		
-		//third edge of triangle
-		temp3.v[0] = tris[i].v[2];
-		temp3.v[1] = tris[i].v[0];
-		temp3.oriented = false;
-		if (hashVert(verts[temp3.v[0]],bbox) == 0){
-			key = hashVert(verts[temp3.v[1]],bbox);
-		}
-		else if (hashVert(verts[temp3.v[1]],bbox) == 0){
-			key = hashVert(verts[temp3.v[0]],bbox);
-		}
-		else {
-			key = hashVert(verts[temp3.v[0]],bbox) * hashVert(verts[temp3.v[1]],bbox);
-		}
-		
-		if (index.find(key) == index.end()){
-			edges.push_back(temp3);
-			index[key] = pos;
-			incpos3 = true;
-		}
-		else{
-			if (edges[index[key]].v[1] == temp3.v[0] && edges[index[key]].v[0] == temp3.v[1]){
-    			edges[index[key]].oriented = true;
-    		}	
-		}
-		if (incpos3 == true){
-			pos += 1;
-		}
-		
-	}
-	
-	//cerr < "gethere" << endl;
-	return edges;
+/// Report the outcome of validation on cerr
+static void reportValidity(const MeshValidity &result)
+{
+    if(!result.tested)
+        return;
+    cerr << "Euler's Characteristic: " << result.euler << endl;
+    if(result.basic)
+        cerr << "loaded file has basic validity" << endl;
+    else
+        cerr << "loaded file does not pass basic validity" << endl;
+    if(result.manifoldTested)
+    {
+        if(result.manifold)
+            cerr << "loaded file has manifold validity" << endl;
+        else
+            cerr << "loaded file does not pass manifold validity" << endl;
+    }
 }
 
-// checks for basic validity of model
-bool Mesh::basicValidity()
+MeshValidity Mesh::runValidation(ValidationPolicy policy, const ProgressRange &range)
 {
-    // stub, needs completing
-    cgp::BoundBox bbox;
-    for(int i = 0; i < (int) verts.size(); i++)
-        bbox.includePnt(verts[i]);
-    bool flag = true;
-    vector<Edge> edges = createEdges(bbox);
-    
-    // calculates euler's characteristic
-    int V = (int) verts.size();
-    int E = (int) edges.size();
-    int F = (int) tris.size();
-    eulerchar = V - E + F;
-    cerr << "Euler's Characteristic: " << eulerchar << "\nEdges: " << edges.size() << endl;
-    
-    for (int i=0; i<(int)edges.size(); i++){
-    	if (edges[i].oriented == false){
-    		break;
-    	}
-    }
-    
-    // checks if there are dangling vertices
-    unordered_map<int, int> vertindex;
-    for (int i=0; i<(int)verts.size(); i++){
-    	vertindex[i] = 0;
+    MeshValidity result;
+
+    result.tested = result.basic = result.manifoldTested = result.manifold = false;
+    result.euler = 0;
+    if(policy == ValidationPolicy::OFF)
+        return result;
+    stats::Span span(timeValidate);
+
+    // refused validation is left untested rather than reported as invalid
+    std::int64_t footprint = validationFootprint((std::int64_t) verts.size(), (std::int64_t) tris.size());
+    if(!stats::fitsMemoryBudget(footprint))
+    {
+        cerr << "Error Mesh::validate: validating needs about " << footprint << " bytes, with " << stats::memoryInUse()
+             << " in use the memory budget of " << stats::getMemoryBudget() << " would be exceeded" << endl;
+        return result;
     }
-    
-    
-    for (int i=0; i<(int)edges.size(); i++){
-    	if (vertindex.find(edges[i].v[0]) != vertindex.end()){
-    		vertindex[edges[i].v[0]] += 1;
-    	}
-    	
-    	if (vertindex.find(edges[i].v[1]) != vertindex.end()){
-    		vertindex[edges[i].v[1]] += 1;
-    	}
+
+    // both tests work from the same edge list, so build it only once
+    cgp::BoundBox bbox = getBounds();
+    vector<Edge> edges = createEdges(range.sub(0.0f, 0.5f));
+    if(range.cancelled())
+        return result;
+    stats::MemoryCharge edgemem;
+    edgemem.set(memTopology, vectorBytes(edges));
+
+    {
+        stats::Span basicspan(timeCheckBasic);
+        result.basic = checkBasic(edges, bbox);
     }
-    
-    for (int i=0; i<(int)verts.size(); i++){
-    	if (vertindex[i] == 0){
-    		flag = false;
-    		break;
-    	}
+    result.euler = eulerchar;
+    if(policy != ValidationPolicy::BASIC)
+    {
+        stats::Span manifoldspan(timeCheckManifold);
+        result.manifold = checkManifold(edges, range.sub(0.5f, 1.0f));
+        if(range.cancelled())
+            return result; // not yet marked as tested
+        result.manifoldTested = true;
     }
-    
-	// checks for out of bounds edges
-	for (int i=0; i<(int)edges.size(); i++){
-		if (verts[edges[i].v[0]].x < bbox.min.x || verts[edges[i].v[0]].y < bbox.min.y || verts[edges[i].v[0]].z < bbox.min.z){
-			flag = false;
-			break;
-		}
-		else if (verts[edges[i].v[0]].x > bbox.max.x || verts[edges[i].v[0]].y > bbox.max.y || verts[edges[i].v[0]].z > bbox.max.z){
-			flag = false;
-			break;
-		}
-		if (verts[edges[i].v[1]].x < bbox.min.x || verts[edges[i].v[1]].y < bbox.min.y || verts[edges[i].v[1]].z < bbox.min.z){
-			flag = false;
-			break;
-		}
-		else if (verts[edges[i].v[1]].x > bbox.max.x || verts[edges[i].v[1]].y > bbox.max.y || verts[edges[i].v[1]].z > bbox.max.z){
-			flag = false;
-			break;
-		}
-	}
-	
-   
-        
-    return flag;
+    result.tested = true;
+    return result;
 }
 
-bool Mesh::manifoldValidity()
+void Mesh::validate(ValidationPolicy policy, Progress * progress, std::function<void(const MeshValidity &)> listener)
 {
-    // stub, needs completing
-    cgp::BoundBox bbox;
-    for(int i = 0; i < (int) verts.size(); i++)
-        bbox.includePnt(verts[i]);
-    bool flag = true;
-    long key;
-    vector<Edge> edges = createEdges(bbox);
-    
-    // checks if euler's characteristic is divisible by 2
-    if (eulerchar%2 == 0){
-    	flag = true;
+    cancelValidation(); // results of an earlier validation would only be overwritten
+    if(policy == ValidationPolicy::BACKGROUND)
+    {
+        // the worker owns a snapshot, so the caller is free to edit or discard this mesh meanwhile
+        std::shared_ptr<Mesh> snapshot = std::make_shared<Mesh>();
+        std::shared_ptr<std::promise<MeshValidity>> promise = std::make_shared<std::promise<MeshValidity>>();
+        std::shared_ptr<Progress> token = std::make_shared<Progress>();
+        snapshot->verts = verts;
+        snapshot->tris = tris;
+        snapshot->chargeMemory();
+        validity = promise->get_future().share();
+        validator.progress = token;
+        validator.thread = std::thread([snapshot, promise, token, listener]()
+        {
+            MeshValidity result = snapshot->runValidation(ValidationPolicy::FULL, ProgressRange(token.get()));
+            promise->set_value(result);
+            if(token->cancelled()) // whoever cancelled no longer wants the results
+                return;
+            reportValidity(result);
+            if(listener)
+                listener(result);
+        });
+        if(progress != NULL)
+            progress->update(1.0f);
+        return;
     }
-    else{
-    	flag = false;
+
+    MeshValidity result = runValidation(policy, ProgressRange(progress, 0.8f, 1.0f));
+    reportValidity(result);
+    if(progress != NULL && !progress->cancelled())
+        progress->update(1.0f);
+
+    std::promise<MeshValidity> ready;
+    ready.set_value(result);
+    validity = ready.get_future().share();
+    if(listener)
+        listener(result);
+}
+
+void Mesh::cancelValidation()
+{
+    validator.stop();
+}
+
+bool Mesh::validityReady()
+{
+    return !validity.valid() || validity.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+MeshValidity Mesh::getValidity()
+{
+    MeshValidity result;
+
+    if(!validity.valid())
+    {
+        result.tested = result.basic = result.manifoldTested = result.manifold = false;
+        result.euler = 0;
+        return result;
     }
-    
-    // checks that all edges have 2 incident triangles
-    if (flag == true){
-		unordered_map<int,int> edgeindex;
-		for (int i=0; i<(int)edges.size();i++){
-			if (hashVert(verts[edges[i].v[0]],bbox) == 0){
-				key = hashVert(verts[edges[i].v[1]],bbox);
-			}
-			else if (hashVert(verts[edges[i].v[1]],bbox) == 0){
-				key = hashVert(verts[edges[i].v[0]],bbox);
-			}
-			else{
-				key = hashVert(verts[edges[i].v[0]],bbox) * hashVert(verts[edges[i].v[1]],bbox);
-			}
+    result = validity.get();
+    if(result.tested)
+        eulerchar = result.euler;
+    return result;
+}
+
+void Mesh::decimate(Mesh &preview, int maxtris)
+{
+    int t, p, stride;
+    Triangle tri;
+    cgp::Vector n, evec[2];
+
+    preview.verts.clear();
+    preview.norms.clear();
+    preview.tris.clear();
+    if(tris.empty() || maxtris <= 0)
+        return;
+
+    // keep every stride-th triangle
+    stride = ((int) tris.size() + maxtris - 1) / maxtris;
+    for(t = 0; t < (int) tris.size(); t += stride)
+    {
+        // face normal from the vertices, since STL normals are not always filled in
+        evec[0].diff(verts[tris[t].v[0]], verts[tris[t].v[1]]);
+        evec[1].diff(verts[tris[t].v[0]], verts[tris[t].v[2]]);
+        n.cross(evec[0], evec[1]);
+        n.normalize();
+
+        tri.n = n;
+        for(p = 0; p < 3; p++)
+        {
+            tri.v[p] = (int) preview.verts.size();
+            preview.verts.push_back(verts[tris[t].v[p]]);
+            preview.norms.push_back(n);
+        }
+        preview.tris.push_back(tri);
+    }
+}
+
+void Mesh::takeGeometry(Mesh &from)
+{
+    cancelValidation();
+    verts = std::move(from.verts);
+    norms = std::move(from.norms);
+    tris = std::move(from.tris);
+    eulerchar = from.eulerchar;
+    validity = from.validity;
+    from.validity = std::shared_future<MeshValidity>();
+    validator.thread = std::move(from.validator.thread);
+    validator.progress = std::move(from.validator.progress);
+    boundspheres.clear();
+    from.verts.clear();
+    from.norms.clear();
+    from.tris.clear();
+    chargeMemory();
+    from.chargeMemory();
+}
+
+/// Key identifying an undirected edge by its vertex indices, independent of direction
+static inline uint64_t edgeKey(int a, int b)
+{
+    if(a > b)
+        std::swap(a, b);
+    return ((uint64_t) (uint32_t) a << 32) | (uint64_t) (uint32_t) b;
+}
+
+int Mesh::labelShells(std::vector<int> &shell, int numthreads)
+{
+    DisjointSets sets((int) verts.size());
+    std::vector<int> id(verts.size(), -1);
+    int t, v, numshells = 0;
+
+    parallel::forChunks(0, (int) tris.size(), numthreads, [this, &sets](int, int first, int last)
+    {
+        for(int t = first; t < last; t++)
+        {
+            sets.unite(tris[t].v[0], tris[t].v[1]);
+            sets.unite(tris[t].v[0], tris[t].v[2]);
+        }
+    });
+
+    shell.resize(tris.size());
+    parallel::forChunks(0, (int) tris.size(), numthreads, [this, &sets, &shell](int, int first, int last)
+    {
+        for(int t = first; t < last; t++)
+            shell[t] = sets.find(tris[t].v[0]);
+    });
+
+    // roots are the lowest vertex of each shell, so numbering them in vertex order is deterministic
+    for(t = 0; t < (int) tris.size(); t++)
+        id[shell[t]] = 0;
+    for(v = 0; v < (int) verts.size(); v++)
+        if(id[v] == 0)
+            id[v] = numshells++;
+    for(t = 0; t < (int) tris.size(); t++)
+        shell[t] = id[shell[t]];
+    return numshells;
+}
+
+void Mesh::shellStats(std::vector<ShellStats> &stats, int numthreads)
+{
+    const int blocksize = 8192; // triangles per partial sum, fixed so that results do not depend on threads
+    std::vector<int> shell, start, fill, order(tris.size()), vertshell(verts.size(), 0);
+    ShellStats empty;
+    int numshells, numblocks, numparts, t, s, b, c, p;
+
+    numshells = labelShells(shell, numthreads);
+    empty.numtris = 0;
+    empty.volume = empty.area = 0.0;
+    empty.closed = true;
+
+    // bucket triangles by shell, keeping triangle order within each shell
+    start.assign(numshells + 1, 0);
+    for(t = 0; t < (int) tris.size(); t++)
+        start[shell[t] + 1]++;
+    for(s = 0; s < numshells; s++)
+        start[s + 1] += start[s];
+    fill.assign(start.begin(), start.end() - 1);
+    for(t = 0; t < (int) tris.size(); t++)
+    {
+        order[fill[shell[t]]++] = t;
+        for(p = 0; p < 3; p++)
+            vertshell[tris[t].v[p]] = shell[t];
+    }
+
+    // each fixed block of the bucketed triangles spans a run of shells, and keeps one partial sum per shell
+    numblocks = ((int) tris.size() + blocksize - 1) / blocksize;
+    std::vector<std::vector<std::pair<int, ShellStats>>> partial(numblocks);
+    parallel::forChunks(0, numblocks, numthreads, [&](int, int firstblock, int lastblock)
+    {
+        cgp::Vector e0, e1, n;
+
+        for(int b = firstblock; b < lastblock; b++)
+        {
+            int last = std::min((b+1) * blocksize, (int) tris.size());
+            for(int i = b * blocksize; i < last; i++)
+            {
+                int t = order[i];
+                if(partial[b].empty() || partial[b].back().first != shell[t])
+                    partial[b].push_back(std::make_pair(shell[t], empty));
+                ShellStats &st = partial[b].back().second;
+                const cgp::Point &p0 = verts[tris[t].v[0]], &p1 = verts[tris[t].v[1]], &p2 = verts[tris[t].v[2]];
+
+                st.numtris++;
+                st.bbox.includePnt(p0); st.bbox.includePnt(p1); st.bbox.includePnt(p2);
+
+                // signed volume of the tetrahedron formed with the origin, by the divergence theorem
+                st.volume += ((double) p0.x * ((double) p1.y * p2.z - (double) p1.z * p2.y)
+                            - (double) p0.y * ((double) p1.x * p2.z - (double) p1.z * p2.x)
+                            + (double) p0.z * ((double) p1.x * p2.y - (double) p1.y * p2.x)) / 6.0;
+                e0.diff(p0, p1); e1.diff(p0, p2);
+                n.cross(e0, e1);
+                st.area += 0.5 * (double) n.length();
+            }
+        }
+    });
+
+    // partial sums combined in block order, so the result is the same for any number of threads
+    std::vector<CompensatedSum<double>> volume(numshells), area(numshells);
+    stats.assign(numshells, empty);
+    for(b = 0; b < numblocks; b++)
+        for(const std::pair<int, ShellStats> &part: partial[b])
+        {
+            ShellStats &st = stats[part.first];
+            st.numtris += part.second.numtris;
+            st.bbox.includePnt(part.second.bbox.min);
+            st.bbox.includePnt(part.second.bbox.max);
+            volume[part.first].add(part.second.volume);
+            area[part.first].add(part.second.area);
+        }
+    for(s = 0; s < numshells; s++)
+    {
+        stats[s].volume = volume[s].value();
+        stats[s].area = area[s].value();
+    }
+
+    // a shell is open if any of its edges does not have exactly two triangles. Edge keys are scattered into
+    // one bucket per part by a hash of the key, so that each part counts its own edges in a single pass.
+    numparts = parallel::numChunks(0, (int) tris.size(), numthreads);
+    std::vector<int> bucketstart(numparts * numparts + 1, 0); // indexed by part then by the chunk filling it
+    std::vector<uint64_t> keys(tris.size() * 3);
+    auto partOf = [numparts](uint64_t key) { return (int) (((key * 0x9E3779B97F4A7C15ULL) >> 40) % (uint64_t) numparts); };
+    parallel::forChunks(0, (int) tris.size(), numparts, [&](int chunk, int first, int last)
+    {
+        for(int t = first; t < last; t++)
+            for(int p = 0; p < 3; p++)
+                bucketstart[partOf(edgeKey(tris[t].v[p], tris[t].v[(p+1)%3])) * numparts + chunk + 1]++;
+    });
+    for(c = 0; c < numparts * numparts; c++)
+        bucketstart[c + 1] += bucketstart[c];
+    parallel::forChunks(0, (int) tris.size(), numparts, [&](int chunk, int first, int last)
+    {
+        std::vector<int> next(numparts);
+        for(int part = 0; part < numparts; part++)
+            next[part] = bucketstart[part * numparts + chunk];
+        for(int t = first; t < last; t++)
+            for(int p = 0; p < 3; p++)
+            {
+                uint64_t key = edgeKey(tris[t].v[p], tris[t].v[(p+1)%3]);
+                keys[next[partOf(key)]++] = key;
+            }
+    });
+
+    std::vector<std::vector<int>> openshells(numparts);
+    parallel::forChunks(0, numparts, numparts, [&](int part, int, int)
+    {
+        int first = bucketstart[part * numparts], last = bucketstart[(part + 1) * numparts];
+        uts::flat_map<uint64_t, int> count; // edge key to incident triangles
+        count.reserve((last - first) / 2 + 1);
+        for(int k = first; k < last; k++)
+            (* count.insert(keys[k], 0).first)++;
+        count.forEach([&](uint64_t key, int incident)
+        {
+            if(incident != 2) // the shell of an edge is the shell of either of its vertices
+                openshells[part].push_back(vertshell[(int) (key >> 32)]);
+        });
+    });
+    for(p = 0; p < numparts; p++)
+        for(int open: openshells[p])
+            stats[open].closed = false;
+}
+
+/// Eberly's polynomial subexpressions for integrating over a triangle with coordinates w0, w1, w2 along one axis
+static inline void massSubexpressions(double w0, double w1, double w2, double &f1, double &f2, double &f3,
+                                      double &g0, double &g1, double &g2)
+{
+    double temp0 = w0 + w1, temp1 = w0 * w0, temp2 = temp1 + w1 * temp0;
+
+    f1 = temp0 + w2;
+    f2 = temp2 + w2 * f1;
+    f3 = w0 * temp1 + w1 * temp2 + w2 * f2;
+    g0 = f2 + w0 * (f1 + w0);
+    g1 = f2 + w1 * (f1 + w1);
+    g2 = f2 + w2 * (f1 + w2);
+}
+
+void Mesh::massProperties(MassProperties &props, int numthreads)
+{
+    const int blocksize = 8192; // triangles per partial sum, fixed so that results do not depend on threads
+    const int numterms = 11;    // volume integrals 1, x, y, z, x^2, y^2, z^2, xy, yz, zx, then area
+    const double mult[numterms] = {1.0/6.0, 1.0/24.0, 1.0/24.0, 1.0/24.0, 1.0/60.0, 1.0/60.0, 1.0/60.0,
+                                   1.0/120.0, 1.0/120.0, 1.0/120.0, 0.5};
+    int numblocks = ((int) tris.size() + blocksize - 1) / blocksize;
+    std::vector<double> blocksums(numblocks * numterms, 0.0);
+    CompensatedSum<double> total[numterms];
+    double integral[numterms], mass, cx, cy, cz;
+    int b, i;
+
+    parallel::forChunks(0, numblocks, numthreads, [&](int, int firstblock, int lastblock)
+    {
+        for(int b = firstblock; b < lastblock; b++)
+        {
+            double sum[numterms] = {0.0};
+            int last = std::min((b+1) * blocksize, (int) tris.size());
+
+            for(int t = b * blocksize; t < last; t++)
+            {
+                const cgp::Point &p0 = verts[tris[t].v[0]], &p1 = verts[tris[t].v[1]], &p2 = verts[tris[t].v[2]];
+                double x0 = p0.x, y0 = p0.y, z0 = p0.z, x1 = p1.x, y1 = p1.y, z1 = p1.z, x2 = p2.x, y2 = p2.y, z2 = p2.z;
+                double f1x, f2x, f3x, g0x, g1x, g2x, f1y, f2y, f3y, g0y, g1y, g2y, f1z, f2z, f3z, g0z, g1z, g2z;
+
+                // unnormalised face normal, its length is twice the triangle area
+                double a1 = x1 - x0, b1 = y1 - y0, c1 = z1 - z0, a2 = x2 - x0, b2 = y2 - y0, c2 = z2 - z0;
+                double d0 = b1 * c2 - b2 * c1, d1 = a2 * c1 - a1 * c2, d2 = a1 * b2 - a2 * b1;
+
+                massSubexpressions(x0, x1, x2, f1x, f2x, f3x, g0x, g1x, g2x);
+                massSubexpressions(y0, y1, y2, f1y, f2y, f3y, g0y, g1y, g2y);
+                massSubexpressions(z0, z1, z2, f1z, f2z, f3z, g0z, g1z, g2z);
+
+                sum[0] += d0 * f1x;
+                sum[1] += d0 * f2x;
+                sum[2] += d1 * f2y;
+                sum[3] += d2 * f2z;
+                sum[4] += d0 * f3x;
+                sum[5] += d1 * f3y;
+                sum[6] += d2 * f3z;
+                sum[7] += d0 * (y0 * g0x + y1 * g1x + y2 * g2x);
+                sum[8] += d1 * (z0 * g0y + z1 * g1y + z2 * g2y);
+                sum[9] += d2 * (x0 * g0z + x1 * g1z + x2 * g2z);
+                sum[10] += sqrt(d0 * d0 + d1 * d1 + d2 * d2);
+            }
+            std::copy(sum, sum + numterms, blocksums.begin() + b * numterms);
+        }
+    });
+
+    // combine blocks in order, with compensation so that many small blocks do not lose precision
+    for(b = 0; b < numblocks; b++)
+        for(i = 0; i < numterms; i++)
+            total[i].add(blocksums[b * numterms + i]);
+    for(i = 0; i < numterms; i++)
+        integral[i] = total[i].value() * mult[i];
+
+    mass = integral[0];
+    props.volume = mass;
+    props.area = integral[10];
+    for(i = 0; i < 3; i++)
+    {
+        props.centroid[i] = 0.0;
+        props.inertia[i][0] = props.inertia[i][1] = props.inertia[i][2] = 0.0;
+    }
+    if(mass == 0.0)
+        return;
+
+    cx = integral[1] / mass; cy = integral[2] / mass; cz = integral[3] / mass;
+    props.centroid[0] = cx; props.centroid[1] = cy; props.centroid[2] = cz;
+
+    // inertia relative to the centroid, by the parallel axis theorem
+    props.inertia[0][0] = integral[5] + integral[6] - mass * (cy * cy + cz * cz);
+    props.inertia[1][1] = integral[4] + integral[6] - mass * (cz * cz + cx * cx);
+    props.inertia[2][2] = integral[4] + integral[5] - mass * (cx * cx + cy * cy);
+    props.inertia[0][1] = props.inertia[1][0] = -(integral[7] - mass * cx * cy);
+    props.inertia[1][2] = props.inertia[2][1] = -(integral[8] - mass * cy * cz);
+    props.inertia[0][2] = props.inertia[2][0] = -(integral[9] - mass * cz * cx);
+}
+
+void Mesh::splitShells(std::vector<Mesh> &shells, int numthreads)
+{
+    std::vector<int> shell, remap(verts.size(), -1);
+    std::vector<std::vector<int>> shelltris;
+    bool hasnorms = (norms.size() == verts.size());
+    int t, numshells;
+
+    numshells = labelShells(shell, numthreads);
+    shelltris.resize(numshells);
+    for(t = 0; t < (int) tris.size(); t++)
+        shelltris[shell[t]].push_back(t);
+
+    // shells have disjoint vertex sets, so each can renumber its own vertices without synchronisation
+    shells.clear();
+    shells.resize(numshells);
+    parallel::forChunks(0, numshells, numthreads, [&](int, int first, int last)
+    {
+        for(int s = first; s < last; s++)
+        {
+            Mesh &m = shells[s];
+            for(int t: shelltris[s])
+            {
+                Triangle tri = tris[t];
+                for(int p = 0; p < 3; p++)
+                {
+                    int v = tri.v[p];
+                    if(remap[v] < 0)
+                    {
+                        remap[v] = (int) m.verts.size();
+                        m.verts.push_back(verts[v]);
+                        if(hasnorms)
+                            m.norms.push_back(norms[v]);
+                    }
+                    tri.v[p] = remap[v];
+                }
+                m.tris.push_back(tri);
+            }
+        }
+    });
+}
+
+/// Key identifying a directed edge from a to b
+static inline uint64_t halfEdgeKey(int a, int b)
+{
+    return ((uint64_t) (uint32_t) a << 32) | (uint64_t) (uint32_t) b;
+}
+
+/// Hash of the sorted vertex indices of a triangle, for duplicate detection
+struct TriKeyHash
+{
+    size_t operator()(const std::array<int, 3> &k) const
+    {
+        return (size_t) ((uint64_t) k[0] * 73856093ULL ^ (uint64_t) k[1] * 19349663ULL ^ (uint64_t) k[2] * 83492791ULL);
+    }
+};
+
+/// Twice the area of a triangle
+static inline float triArea2(const cgp::Point &p0, const cgp::Point &p1, const cgp::Point &p2)
+{
+    cgp::Vector e0, e1, n;
+
+    e0.diff(p0, p1); e1.diff(p0, p2);
+    n.cross(e0, e1);
+    return n.length();
+}
+
+void Mesh::removeBadTriangles(int &degenerate, int &duplicates)
+{
+    uts::flat_map<std::array<int, 3>, char, TriKeyHash> seen;
+    int t, kept = 0;
+
+    degenerate = duplicates = 0;
+    seen.reserve(tris.size());
+    for(t = 0; t < (int) tris.size(); t++)
+    {
+        const Triangle &tri = tris[t];
+        std::array<int, 3> key = {{tri.v[0], tri.v[1], tri.v[2]}};
+
+        if(key[0] == key[1] || key[1] == key[2] || key[2] == key[0]
+           || triArea2(verts[key[0]], verts[key[1]], verts[key[2]]) == 0.0f)
+        {
+            degenerate++;
+            continue;
+        }
+        std::sort(key.begin(), key.end());
+        if(!seen.insert(key, 0).second)
+        {
+            duplicates++;
+            continue;
+        }
+        tris[kept++] = tri;
+    }
+    tris.resize(kept);
+}
+
+void Mesh::orientConsistently(std::vector<char> &flips)
+{
+    // triangles on either side of each edge, -1 if absent, or -2 if the edge has more than two triangles
+    uts::flat_map<uint64_t, std::pair<int, int>> edgetris;
+    std::vector<char> visited(tris.size(), 0);
+    std::vector<int> stack;
+    int t, p;
+
+    edgetris.reserve(tris.size() * 3 / 2);
+    for(t = 0; t < (int) tris.size(); t++)
+        for(p = 0; p < 3; p++)
+        {
+            auto ins = edgetris.insert(edgeKey(tris[t].v[p], tris[t].v[(p+1)%3]), std::make_pair(t, -1));
+            if(!ins.second)
+            {
+                if(ins.first->second == -1)
+                    ins.first->second = t;
+                else
+                    ins.first->second = -2;
+            }
+        }
+
+    // flood fill from each unvisited triangle, making each neighbour agree with the triangle it was reached from
+    for(t = 0; t < (int) tris.size(); t++)
+    {
+        if(visited[t])
+            continue;
+        visited[t] = 1;
+        stack.push_back(t);
+        while(!stack.empty())
+        {
+            int cur = stack.back();
+            stack.pop_back();
+            for(p = 0; p < 3; p++)
+            {
+                int a = tris[cur].v[p], b = tris[cur].v[(p+1)%3], q;
+                const std::pair<int, int> &across = * edgetris.find(edgeKey(a, b));
+                int nb = (across.first == cur) ? across.second : across.first;
+
+                if(nb < 0 || visited[nb]) // boundary or non-manifold edge, or already fixed
+                    continue;
+
+                // a consistent neighbour traverses the shared edge from b to a, so the edge is oriented
+                for(q = 0; q < 3; q++)
+                    if(tris[nb].v[q] == a && tris[nb].v[(q+1)%3] == b)
+                    {
+                        std::swap(tris[nb].v[1], tris[nb].v[2]);
+                        flips[nb] ^= 1;
+                        break;
+                    }
+                visited[nb] = 1;
+                stack.push_back(nb);
+            }
+        }
+    }
+}
+
+int Mesh::fillLoop(const std::vector<int> &loop, int maxdphole)
+{
+    int n = (int) loop.size(), i, k, m, len, added = 0;
+    Triangle tri;
+
+    // the loop follows boundary half-edges, so new triangles run the other way to pair up with them.
+    // A loop through collinear vertices or a pinched vertex gives slivers, which are left out.
+    auto addTri = [this, &tri, &added](int a, int b, int c)
+    {
+        if(a == b || b == c || c == a || triArea2(verts[a], verts[b], verts[c]) == 0.0f)
+            return;
+        tri.v[0] = a; tri.v[1] = b; tri.v[2] = c;
+        tris.push_back(tri);
+        added++;
+    };
+
+    if(n < 3)
+        return 0;
+    if(n > maxdphole)
+    {
+        cgp::Point centre(0.0f, 0.0f, 0.0f);
+        int c = (int) verts.size();
+
+        for(i = 0; i < n; i++)
+        {
+            centre.x += verts[loop[i]].x; centre.y += verts[loop[i]].y; centre.z += verts[loop[i]].z;
+        }
+        centre.x /= (float) n; centre.y /= (float) n; centre.z /= (float) n;
+        verts.push_back(centre);
+        for(i = 0; i < n; i++)
+            addTri(loop[(i+1)%n], loop[i], c);
+        return added;
+    }
+
+    // minimum total area triangulation of the polygon, weight[i][k] covering loop vertices i..k
+    std::vector<float> weight(n * n, 0.0f);
+    std::vector<int> split(n * n, -1);
+    for(len = 2; len < n; len++)
+        for(i = 0; i + len < n; i++)
+        {
+            k = i + len;
+            float best = HUGE_VALF;
+            for(m = i + 1; m < k; m++)
+            {
+                float w = weight[i*n+m] + weight[m*n+k] + triArea2(verts[loop[i]], verts[loop[m]], verts[loop[k]]);
+                if(w < best)
+                {
+                    best = w;
+                    split[i*n+k] = m;
+                }
+            }
+            weight[i*n+k] = best;
+        }
+
+    std::vector<std::pair<int, int>> pending(1, std::make_pair(0, n-1));
+    while(!pending.empty())
+    {
+        i = pending.back().first; k = pending.back().second;
+        pending.pop_back();
+        if(k - i < 2)
+            continue;
+        m = split[i*n+k];
+        addTri(loop[k], loop[m], loop[i]);
+        pending.push_back(std::make_pair(i, m));
+        pending.push_back(std::make_pair(m, k));
+    }
+    return added;
+}
+
+void Mesh::fillHoles(int maxdphole, RepairReport &report)
+{
+    uts::flat_map<uint64_t, char> halfedges;
+    std::vector<std::pair<int, int>> boundary; // boundary half-edges as (tail, head)
+    std::vector<char> used;
+    std::vector<int> loop;
+    int t, p, b, numtris = (int) tris.size();
+
+    halfedges.reserve(tris.size() * 3);
+    for(t = 0; t < numtris; t++)
+        for(p = 0; p < 3; p++)
+            halfedges.insert(halfEdgeKey(tris[t].v[p], tris[t].v[(p+1)%3]), 0);
+
+    // a half-edge without its reverse lies on the boundary
+    for(t = 0; t < numtris; t++)
+        for(p = 0; p < 3; p++)
+        {
+            int a = tris[t].v[p], c = tris[t].v[(p+1)%3];
+            if(halfedges.find(halfEdgeKey(c, a)) == nullptr)
+                boundary.push_back(std::make_pair(a, c));
+        }
+
+    // sorted by tail, so that the half-edges leaving a vertex are found by binary search
+    std::sort(boundary.begin(), boundary.end());
+    used.resize(boundary.size(), 0);
+    for(b = 0; b < (int) boundary.size(); b++)
+    {
+        if(used[b])
+            continue;
+
+        // follow boundary half-edges head to tail until returning to the start
+        int start = boundary[b].first, cur = b;
+        bool closed = false;
+        loop.clear();
+        while(cur >= 0)
+        {
+            used[cur] = 1;
+            loop.push_back(boundary[cur].first);
+            int next = boundary[cur].second;
+            if(next == start)
+            {
+                closed = true;
+                break;
+            }
+            cur = -1;
+            for(auto out = std::lower_bound(boundary.begin(), boundary.end(), std::make_pair(next, -1));
+                out != boundary.end() && out->first == next; out++)
+                if(!used[out - boundary.begin()])
+                {
+                    cur = (int) (out - boundary.begin());
+                    break;
+                }
+        }
+        if(closed && (int) loop.size() >= 3)
+        {
+            report.filltris += fillLoop(loop, maxdphole);
+            report.holes++;
+        }
+        else
+            report.unfilled++;
+    }
+}
+
+void Mesh::orientOutward(std::vector<char> &flips)
+{
+    std::vector<int> shell;
+    std::vector<double> volume;
+    int t;
+
+    flips.resize(tris.size(), 0);
+    volume.resize(labelShells(shell), 0.0);
+    for(t = 0; t < (int) tris.size(); t++)
+    {
+        const cgp::Point &p0 = verts[tris[t].v[0]], &p1 = verts[tris[t].v[1]], &p2 = verts[tris[t].v[2]];
+        volume[shell[t]] += (double) p0.x * ((double) p1.y * p2.z - (double) p1.z * p2.y)
+                          - (double) p0.y * ((double) p1.x * p2.z - (double) p1.z * p2.x)
+                          + (double) p0.z * ((double) p1.x * p2.y - (double) p1.y * p2.x);
+    }
+    for(t = 0; t < (int) tris.size(); t++)
+        if(volume[shell[t]] < 0.0)
+        {
+            std::swap(tris[t].v[1], tris[t].v[2]);
+            flips[t] ^= 1;
+        }
+}
+
+void Mesh::compactVerts()
+{
+    std::vector<int> remap(verts.size(), -1);
+    std::vector<cgp::Point> cleanverts;
+    int t, p;
+
+    for(t = 0; t < (int) tris.size(); t++)
+        for(p = 0; p < 3; p++)
+        {
+            int &v = tris[t].v[p];
+            if(remap[v] < 0)
+            {
+                remap[v] = (int) cleanverts.size();
+                cleanverts.push_back(verts[v]);
+            }
+            v = remap[v];
+        }
+    verts = std::move(cleanverts);
+}
+
+bool Mesh::repair(RepairReport &report, int maxdphole, Progress * progress)
+{
+    std::vector<char> flips;
+    ProgressRange range(progress);
+    int numtris;
+
+    report.degenerate = report.duplicates = report.flipped = 0;
+    report.holes = report.unfilled = report.filltris = 0;
+
+    removeBadTriangles(report.degenerate, report.duplicates);
+    numtris = (int) tris.size();
+    flips.resize(numtris, 0);
+
+    // every stage leaves a consistent mesh, so a cancel skips those remaining but still tidies up below
+    if(range.update(0.2f))
+    {
+        orientConsistently(flips);
+        if(range.update(0.4f))
+        {
+            fillHoles(maxdphole, report); // new triangles are appended, so flips still lines up with the originals
+            if(range.update(0.7f))
+                orientOutward(flips);
+        }
+    }
+    report.flipped = (int) std::count(flips.begin(), flips.begin() + numtris, 1);
+    compactVerts();
+
+    // geometry has changed, so normals and any earlier validation are stale
+    deriveFaceNorms();
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+    return range.update(1.0f);
+}
+
+IntersectionSearch Mesh::selfIntersections(std::vector<std::pair<int, int>> &pairs, bool stopatfirst, int numthreads, Progress * progress)
+{
+    std::vector<cgp::BoundBox> boxes(tris.size());
+    std::atomic<bool> found(false);
+    std::atomic<long> done(0); // triangles tested, counted a check interval at a time
+    ProgressRange range(progress, 0.1f, 1.0f); // building the hierarchy takes the first tenth
+    BVH bvh;
+    int numchunks, c;
+
+    pairs.clear();
+    parallel::forChunks(0, (int) tris.size(), numthreads, [this, &boxes](int, int first, int last)
+    {
+        for(int t = first; t < last; t++)
+            for(int p = 0; p < 3; p++)
+                boxes[t].includePnt(verts[tris[t].v[p]]);
+    });
+    bvh.build(boxes);
+    if(!range.update(0.0f))
+        return IntersectionSearch::CANCELLED;
+
+    numchunks = parallel::numChunks(0, (int) tris.size(), numthreads);
+    std::vector<std::vector<std::pair<int, int>>> chunkpairs(numchunks);
+    parallel::forChunks(0, (int) tris.size(), numthreads, [&](int chunk, int first, int last)
+    {
+        for(int t = first; t < last && !(stopatfirst && found.load(std::memory_order_relaxed)); t++)
+        {
+            const Triangle &a = tris[t];
+            if(t > first && (t - first) % ProgressRange::defaultInterval == 0)
+            {
+                // workers share the count, and the first reports the fraction for all of them
+                long sofar = done.fetch_add(ProgressRange::defaultInterval, std::memory_order_relaxed) + ProgressRange::defaultInterval;
+                if(range.cancelled() || (chunk == 0 && !range.update((float) sofar / (float) tris.size())))
+                    break;
+            }
+            bvh.overlap(boxes[t], [&](int u)
+            {
+                const Triangle &b = tris[u];
+                int i, j, shared = 0, sa[3], sb[3];
+                bool hit;
+
+                if(u <= t) // each pair is tested once, from its lower index
+                    return true;
+                for(i = 0; i < 3; i++)
+                    for(j = 0; j < 3; j++)
+                        if(a.v[i] == b.v[j])
+                        {
+                            sa[shared] = i;
+                            sb[shared] = j;
+                            shared++;
+                        }
+                statTriTriTests.add();
+                switch(shared)
+                {
+                    case 0:
+                        hit = triTriIntersect(verts[a.v[0]], verts[a.v[1]], verts[a.v[2]], verts[b.v[0]], verts[b.v[1]], verts[b.v[2]]);
+                        break;
+                    case 1:
+                        // the triangles meet at the shared vertex, and any further contact reaches an opposite edge
+                        hit = segTriIntersect(verts[a.v[(sa[0]+1)%3]], verts[a.v[(sa[0]+2)%3]], verts[b.v[0]], verts[b.v[1]], verts[b.v[2]])
+                           || segTriIntersect(verts[b.v[(sb[0]+1)%3]], verts[b.v[(sb[0]+2)%3]], verts[a.v[0]], verts[a.v[1]], verts[a.v[2]]);
+                        break;
+                    case 2:
+                        // triangles on a shared edge only overlap if folded flat onto each other
+                        hit = foldedOver(verts[a.v[sa[0]]], verts[a.v[sa[1]]], verts[a.v[3-sa[0]-sa[1]]], verts[b.v[3-sb[0]-sb[1]]]);
+                        break;
+                    default: // duplicate
+                        hit = true;
+                        break;
+                }
+                if(hit)
+                {
+                    chunkpairs[chunk].push_back(std::make_pair(t, u));
+                    if(stopatfirst)
+                    {
+                        found.store(true, std::memory_order_relaxed);
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+    });
+
+    for(c = 0; c < numchunks; c++)
+        pairs.insert(pairs.end(), chunkpairs[c].begin(), chunkpairs[c].end());
+    std::sort(pairs.begin(), pairs.end());
+    if(stopatfirst && pairs.size() > 1)
+        pairs.resize(1);
+    // a cancel that arrived after the search stopped at its first intersection cut nothing short
+    if(range.cancelled() && !(stopatfirst && !pairs.empty()))
+        return IntersectionSearch::CANCELLED;
+    range.update(1.0f);
+    return pairs.empty() ? IntersectionSearch::NONE : IntersectionSearch::FOUND;
+}
+
+void Mesh::voxelise(VoxelGrid &grid, int resolution, int numthreads)
+{
+    ::voxelise(verts, tris, grid, resolution, numthreads);
+}
+
+void Mesh::fromVoxels(const VoxelGrid &grid, int numthreads)
+{
+    polygonise(grid, verts, tris, numthreads);
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+}
+
+void Mesh::generateIcosphere(int levels, float radius)
+{
+    icosphere(levels, radius, verts, tris);
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+}
+
+void Mesh::generateTorus(int genus, int resolution, int numthreads)
+{
+    genusTorus(genus, resolution, verts, tris, numthreads);
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+}
+
+void Mesh::generateGyroid(int cells, int resolution, int numthreads)
+{
+    gyroid(cells, resolution, verts, tris, numthreads);
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+}
+
+void Mesh::generateSoup(float duplicates, int holes, unsigned int seed)
+{
+    vector<cgp::Point> soupverts;
+    vector<Triangle> souptris;
+
+    triangleSoup(verts, tris, duplicates, holes, seed, soupverts, souptris);
+    verts.swap(soupverts);
+    tris.swap(souptris);
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+}
+
+void Mesh::distanceField(DistanceGrid &grid, float voxelsize, float bandwidth, int numthreads)
+{
+    ::distanceField(verts, tris, grid, voxelsize, bandwidth, numthreads);
+}
+
+float Mesh::sdfVoxelSize(float feature)
+{
+    cgp::Vector extent = getBounds().getDiag();
+
+    // a few samples across the feature, but no more than 512 along the longest side
+    return max(feature / 3.0f, max(extent.i, max(extent.j, extent.k)) / 512.0f);
+}
+
+bool Mesh::hollow(float thickness, float voxelsize, int numthreads)
+{
+    DistanceGrid grid;
+    vector<cgp::Point> innerverts;
+    vector<Triangle> innertris;
+    int offset;
+
+    if(thickness <= 0.0f || tris.empty())
+        return false;
+    if(voxelsize <= 0.0f)
+        voxelsize = sdfVoxelSize(thickness);
+
+    // the band must reach past the inset level for it to be interpolated correctly
+    ::distanceField(verts, tris, grid, voxelsize, thickness + 2.0f * voxelsize, numthreads);
+    isosurface(grid.dist, grid.origin, grid.voxelsize, -thickness, innerverts, innertris, numthreads);
+    if(innertris.empty())
+        return false;
+
+    // reverse the winding so that the inset shell faces into the cavity
+    offset = (int) verts.size();
+    verts.insert(verts.end(), innerverts.begin(), innerverts.end());
+    for(Triangle &tri: innertris)
+    {
+        std::swap(tri.v[1], tri.v[2]);
+        for(int p = 0; p < 3; p++)
+            tri.v[p] += offset;
+        tri.n.i = -tri.n.i; tri.n.j = -tri.n.j; tri.n.k = -tri.n.k;
+        tris.push_back(tri);
+    }
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+    return true;
+}
+
+bool Mesh::offsetAlongNormals(float distance, int numthreads)
+{
+    vector<int> ringstart(verts.size() + 1, 0), ring, fill, canon(verts.size()), order(verts.size());
+    vector<cgp::Point> moved(verts.size());
+    std::atomic<bool> folded(false);
+    int t, p, numverts = (int) verts.size();
+
+    // vertices at exactly the same position share the lowest of their indices, so that unwelded seams stay closed
+    for(p = 0; p < numverts; p++)
+        order[p] = p;
+    std::sort(order.begin(), order.end(), [this](int a, int b)
+    {
+        const cgp::Point &pa = verts[a], &pb = verts[b];
+        if(pa.x != pb.x) return pa.x < pb.x;
+        if(pa.y != pb.y) return pa.y < pb.y;
+        if(pa.z != pb.z) return pa.z < pb.z;
+        return a < b;
+    });
+    for(p = 0; p < numverts; p++)
+    {
+        const cgp::Point &cur = verts[order[p]];
+        bool same = p > 0 && verts[order[p-1]].x == cur.x && verts[order[p-1]].y == cur.y && verts[order[p-1]].z == cur.z;
+        canon[order[p]] = same ? canon[order[p-1]] : order[p];
+    }
+
+    // triangles around each shared vertex, by counting sort
+    for(t = 0; t < (int) tris.size(); t++)
+        for(p = 0; p < 3; p++)
+            ringstart[canon[tris[t].v[p]] + 1]++;
+    for(p = 0; p < numverts; p++)
+        ringstart[p + 1] += ringstart[p];
+    ring.resize(ringstart[numverts]);
+    fill.assign(ringstart.begin(), ringstart.end() - 1);
+    for(t = 0; t < (int) tris.size(); t++)
+        for(p = 0; p < 3; p++)
+            ring[fill[canon[tris[t].v[p]]]++] = t;
+
+    parallel::forChunks(0, numverts, numthreads, [&](int, int first, int last)
+    {
+        for(int v = first; v < last; v++)
+        {
+            cgp::Vector n(0.0f, 0.0f, 0.0f), fn;
+            float mindot = 1.0f;
+
+            if(canon[v] != v) // moved with the vertex it shares a position with, below
+                continue;
+
+            // weight faces by their angle at the vertex, so that the normal does not depend on how faces are split
+            for(int r = ringstart[v]; r < ringstart[v + 1]; r++)
+            {
+                const Triangle &tri = tris[ring[r]];
+                int c = (canon[tri.v[0]] == v) ? 0 : ((canon[tri.v[1]] == v) ? 1 : 2);
+                cgp::Vector e0, e1, x;
+                e0.diff(verts[v], verts[tri.v[(c + 1) % 3]]);
+                e1.diff(verts[v], verts[tri.v[(c + 2) % 3]]);
+                x.cross(e0, e1);
+                fn = tri.n;
+                fn.normalize();
+                fn.mult(atan2(x.length(), e0.dot(e1))); // better conditioned than acos for thin triangles
+                n.add(fn);
+            }
+            n.normalize();
+            for(int r = ringstart[v]; r < ringstart[v + 1]; r++)
+            {
+                fn = tris[ring[r]].n;
+                fn.normalize();
+                mindot = min(mindot, n.dot(fn));
+            }
+            // the face most oblique to the vertex normal moves by distance * mindot, so lengthen to compensate,
+            // within limits since very sharp creases would send the vertex far away
+            n.mult(distance / max(mindot, 0.5f));
+            n.pntplusvec(verts[v], &moved[v]);
+        }
+    });
+    for(p = 0; p < numverts; p++)
+        moved[p] = moved[canon[p]];
+
+    // a triangle whose normal reverses has been folded over by neighbouring vertices passing each other
+    parallel::forChunks(0, (int) tris.size(), numthreads, [&](int, int first, int last)
+    {
+        cgp::Vector e0, e1, n, fn;
+        for(int t = first; t < last && !folded; t++)
+        {
+            e0.diff(moved[tris[t].v[0]], moved[tris[t].v[1]]);
+            e1.diff(moved[tris[t].v[0]], moved[tris[t].v[2]]);
+            n.cross(e0, e1);
+            fn = tris[t].n;
+            if(n.dot(fn) <= 0.0f)
+                folded = true;
+        }
+    });
+    if(folded)
+        return false;
+    verts.swap(moved);
+    return true;
+}
+
+bool Mesh::offset(float distance, float voxelsize, int numthreads)
+{
+    DistanceGrid grid;
+    vector<cgp::Point> newverts;
+    vector<Triangle> newtris;
+    vector<double> chunklen;
+    double edgelen = 0.0;
+    int numchunks;
+
+    if(tris.empty())
+        return false;
+    if(distance == 0.0f)
+        return true;
+    deriveFaceNorms();
+
+    // mean edge length, as a measure of the scale of surface detail
+    numchunks = parallel::numChunks(0, (int) tris.size(), numthreads);
+    chunklen.assign(numchunks, 0.0);
+    parallel::forChunks(0, (int) tris.size(), numthreads, [&](int chunk, int first, int last)
+    {
+        cgp::Vector e;
+        for(int t = first; t < last; t++)
+            for(int p = 0; p < 3; p++)
+            {
+                e.diff(verts[tris[t].v[p]], verts[tris[t].v[(p + 1) % 3]]);
+                chunklen[chunk] += e.length();
+            }
+    });
+    for(double len: chunklen)
+        edgelen += len;
+    edgelen /= 3.0 * (double) tris.size();
+
+    if(fabs(distance) > 0.5 * edgelen || !offsetAlongNormals(distance, numthreads))
+    {
+        if(voxelsize <= 0.0f)
+            voxelsize = sdfVoxelSize(fabs(distance));
+        ::distanceField(verts, tris, grid, voxelsize, fabs(distance) + 2.0f * voxelsize, numthreads);
+        isosurface(grid.dist, grid.origin, grid.voxelsize, distance, newverts, newtris, numthreads);
+        if(newtris.empty())
+            return false;
+        // already welded, since vertices are shared through the lattice edges they lie on
+        verts.swap(newverts);
+        tris.swap(newtris);
+    }
+
+    deriveFaceNorms();
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+    return true;
+}
+
+bool Mesh::intersectsMesh(Mesh &other, int numthreads)
+{
+    std::vector<cgp::BoundBox> boxes(other.tris.size());
+    std::atomic<bool> found(false);
+    BVH bvh;
+
+    if(!boxOverlap(getBounds(), other.getBounds()))
+        return false;
+    parallel::forChunks(0, (int) other.tris.size(), numthreads, [&other, &boxes](int, int first, int last)
+    {
+        for(int t = first; t < last; t++)
+            for(int p = 0; p < 3; p++)
+                boxes[t].includePnt(other.verts[other.tris[t].v[p]]);
+    });
+    bvh.build(boxes);
+
+    parallel::forChunks(0, (int) tris.size(), numthreads, [&](int, int first, int last)
+    {
+        for(int t = first; t < last && !found.load(std::memory_order_relaxed); t++)
+        {
+            const Triangle &a = tris[t];
+            cgp::BoundBox box;
+            for(int p = 0; p < 3; p++)
+                box.includePnt(verts[a.v[p]]);
+            bvh.overlap(box, [&](int u)
+            {
+                const Triangle &b = other.tris[u];
+                statTriTriTests.add();
+                if(triTriIntersect(verts[a.v[0]], verts[a.v[1]], verts[a.v[2]],
+                                   other.verts[b.v[0]], other.verts[b.v[1]], other.verts[b.v[2]]))
+                {
+                    found.store(true, std::memory_order_relaxed);
+                    return false;
+                }
+                return !found.load(std::memory_order_relaxed);
+            });
+        }
+    });
+    return found;
+}
+
+bool Mesh::boolean(Mesh &other, BooleanOp op, float voxelsize, int numthreads)
+{
+    vector<cgp::Point> newverts;
+    vector<Triangle> newtris;
+
+    if(tris.empty() && other.tris.empty())
+        return false;
+
+    if(!intersectsMesh(other, numthreads))
+    {
+        // every shell lies wholly inside or outside the other solid, so one vertex decides which
+        Mesh * operand[2] = {this, &other};
+        vector<int> shell[2];
+        vector<int> rep[2];
+        vector<char> inside[2];
+
+        for(int m = 0; m < 2; m++)
+        {
+            Mesh &cur = * operand[m], &opp = * operand[1 - m];
+            int numshells = cur.labelShells(shell[m], numthreads);
+            rep[m].assign(numshells, -1);
+            for(int t = (int) cur.tris.size() - 1; t >= 0; t--)
+                rep[m][shell[m][t]] = cur.tris[t].v[0];
+            inside[m].assign(numshells, 0);
+            parallel::forChunks(0, numshells, numthreads, [&](int, int first, int last)
+            {
+                for(int s = first; s < last; s++)
+                    inside[m][s] = pointInside(cur.verts[rep[m][s]], opp.verts, opp.tris);
+            });
+        }
+
+        // shells of the first operand survive on the outside of the second except in an intersection, and
+        // those of the second survive on the inside of the first except in a union, facing inward for a difference
+        for(int m = 0; m < 2; m++)
+        {
+            Mesh &cur = * operand[m];
+            int offset = (int) newverts.size();
+            bool keepinside = (op == BooleanOp::INTERSECTION) || (m == 1 && op == BooleanOp::DIFFERENCE);
+            newverts.insert(newverts.end(), cur.verts.begin(), cur.verts.end());
+            for(int t = 0; t < (int) cur.tris.size(); t++)
+                if((bool) inside[m][shell[m][t]] == keepinside)
+                {
+                    Triangle tri = cur.tris[t];
+                    for(int p = 0; p < 3; p++)
+                        tri.v[p] += offset;
+                    if(m == 1 && op == BooleanOp::DIFFERENCE)
+                        std::swap(tri.v[1], tri.v[2]);
+                    newtris.push_back(tri);
+                }
+        }
+        if(newtris.empty())
+            return false;
+        verts.swap(newverts);
+        tris.swap(newtris);
+        compactVerts();
+    }
+    else
+    {
+        DistanceGrid field[2], combined;
+        cgp::BoundBox bbox = getBounds(), otherbox = other.getBounds();
+        float band, pad;
+
+        if(voxelsize <= 0.0f)
+            voxelsize = max(sdfVoxelSize(0.0f), other.sdfVoxelSize(0.0f));
+        band = 3.0f * voxelsize;
+        pad = (ceil(band / voxelsize) + 1.0f) * voxelsize;
+        bbox.includePnt(otherbox.min);
+        bbox.includePnt(otherbox.max);
+
+        // both fields on one lattice, so that they can be combined sample by sample
+        for(int m = 0; m < 2; m++)
+        {
+            field[m].origin = cgp::Point(bbox.min.x - pad, bbox.min.y - pad, bbox.min.z - pad);
+            field[m].voxelsize = voxelsize;
+            field[m].bandwidth = band;
+        }
+        fillDistances(verts, tris, field[0], numthreads);
+        fillDistances(other.verts, other.tris, field[1], numthreads);
+        combineDistances(field[0], field[1], op, combined, numthreads);
+        isosurface(combined.dist, combined.origin, combined.voxelsize, 0.0f, newverts, newtris, numthreads);
+        if(newtris.empty())
+            return false;
+        verts.swap(newverts);
+        tris.swap(newtris);
+    }
+
+    deriveFaceNorms();
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+    return true;
+}
+
+/// Half-edge t * 3 + e of triangle t, from v[e] to v[(e + 1) % 3], keyed by its undirected edge
+struct HalfEdgeRecord
+{
+    uint64_t key;   ///< undirected edge key, see edgeKey
+    int halfedge;   ///< half-edge index
+};
+
+/**
+ * Sort the half-edges of a triangle list by undirected edge, so that the half-edges of each edge are adjacent
+ * and shared edges can be numbered once
+ * @param tris          triangles
+ * @param[out] records  one record per half-edge, sorted by key and then by half-edge index
+ * @param numthreads    number of threads to use, 0 for one per core
+ */
+static void sortHalfEdges(const vector<Triangle> &tris, vector<HalfEdgeRecord> &records, int numthreads)
+{
+    records.resize(tris.size() * 3);
+    parallel::forChunks(0, (int) tris.size(), numthreads, [&tris, &records](int, int first, int last)
+    {
+        for(int t = first; t < last; t++)
+            for(int e = 0; e < 3; e++)
+                records[t * 3 + e] = {edgeKey(tris[t].v[e], tris[t].v[(e + 1) % 3]), t * 3 + e};
+    });
+    std::sort(records.begin(), records.end(), [](const HalfEdgeRecord &a, const HalfEdgeRecord &b)
+    {
+        return a.key < b.key || (a.key == b.key && a.halfedge < b.halfedge);
+    });
+}
+
+int Mesh::subdividePass(float tolerance, float cosfeature, int numthreads)
+{
+    vector<HalfEdgeRecord> records;
+    vector<int> triedge(tris.size() * 3), edgefirst, edgepoint, triout(tris.size() + 1, 0);
+    vector<cgp::Point> points;
+    vector<Triangle> newtris;
+    int numedges = 0, numsplit = 0, t, e;
+
+    sortHalfEdges(tris, records, numthreads);
+    for(e = 0; e < (int) records.size(); e++)
+    {
+        if(e == 0 || records[e].key != records[e - 1].key)
+        {
+            edgefirst.push_back(e);
+            numedges++;
+        }
+        triedge[records[e].halfedge] = numedges - 1;
+    }
+    edgefirst.push_back((int) records.size());
+
+    // edge points on the cubic through the ends matching their normals (as for the edges of PN triangles)
+    edgepoint.assign(numedges, -1);
+    points.resize(numedges);
+    parallel::forChunks(0, numedges, numthreads, [&](int, int first, int last)
+    {
+        for(int e = first; e < last; e++)
+        {
+            if(edgefirst[e + 1] - edgefirst[e] != 2) // boundary or non-manifold edges are left straight
+                continue;
+            int h0 = records[edgefirst[e]].halfedge, h1 = records[edgefirst[e] + 1].halfedge;
+            cgp::Vector fa = tris[h0 / 3].n, fb = tris[h1 / 3].n, fab, n[2], d;
+            if(fa.dot(fb) < cosfeature) // crease
+                continue;
+            int ends[2] = {tris[h0 / 3].v[h0 % 3], tris[h0 / 3].v[(h0 % 3 + 1) % 3]};
+            fab = fa; fab.add(fb); fab.normalize();
+            for(int i = 0; i < 2; i++)
+            {
+                // a vertex normal bent by a nearby crease does not describe this edge, so use the faces instead
+                n[i] = norms[ends[i]];
+                if(n[i].dot(fa) < cosfeature || n[i].dot(fb) < cosfeature)
+                    n[i] = fab;
+            }
+            const cgp::Point &p0 = verts[ends[0]], &p1 = verts[ends[1]];
+            d.diff(p0, p1);
+            float w0 = d.dot(n[0]), w1 = -d.dot(n[1]);
+
+            // midpoint of the Bezier with inner control points (2 p0 + p1 - w0 n0) / 3 and (2 p1 + p0 - w1 n1) / 3
+            cgp::Vector offset(-(w0 * n[0].i + w1 * n[1].i) / 8.0f, -(w0 * n[0].j + w1 * n[1].j) / 8.0f,
+                               -(w0 * n[0].k + w1 * n[1].k) / 8.0f);
+            if(offset.length() > tolerance)
+            {
+                points[e] = cgp::Point(0.5f * (p0.x + p1.x) + offset.i, 0.5f * (p0.y + p1.y) + offset.j,
+                                       0.5f * (p0.z + p1.z) + offset.k);
+                edgepoint[e] = 0;
+            }
+        }
+    });
+
+    // number the new vertices in edge order
+    for(e = 0; e < numedges; e++)
+        if(edgepoint[e] == 0)
+        {
+            edgepoint[e] = (int) verts.size();
+            verts.push_back(points[e]);
+            numsplit++;
+        }
+    if(numsplit == 0)
+        return 0;
+
+    // each triangle becomes one more triangle than it has split edges
+    for(t = 0; t < (int) tris.size(); t++)
+    {
+        int count = 1;
+        for(e = 0; e < 3; e++)
+            count += (edgepoint[triedge[t * 3 + e]] >= 0);
+        triout[t + 1] = triout[t] + count;
+    }
+    newtris.resize(triout[tris.size()]);
+    parallel::forChunks(0, (int) tris.size(), numthreads, [&](int, int first, int last)
+    {
+        for(int t = first; t < last; t++)
+        {
+            Triangle * out = &newtris[triout[t]];
+            int split[3], numsplit = 0, r = 0;
+
+            for(int e = 0; e < 3; e++)
+            {
+                split[e] = edgepoint[triedge[t * 3 + e]];
+                numsplit += (split[e] >= 0);
+            }
+            auto emit = [&out](int a, int b, int c) { out->v[0] = a; out->v[1] = b; out->v[2] = c; out++; };
+
+            if(numsplit == 0)
+            {
+                * out = tris[t];
+                continue;
+            }
+            if(numsplit == 3)
+            {
+                const int * v = tris[t].v;
+                emit(v[0], split[0], split[2]);
+                emit(split[0], v[1], split[1]);
+                emit(split[2], split[1], v[2]);
+                emit(split[0], split[1], split[2]);
+                continue;
+            }
+            // rotate so that edge 0 (v0 v1) is split and, with two splits, edge 2 (v2 v0) is not
+            while(split[r] < 0 || (numsplit == 2 && split[(r + 2) % 3] >= 0))
+                r++;
+            int v0 = tris[t].v[r], v1 = tris[t].v[(r + 1) % 3], v2 = tris[t].v[(r + 2) % 3];
+            int m0 = split[r], m1 = split[(r + 1) % 3];
+            if(numsplit == 1)
+            {
+                emit(v0, m0, v2);
+                emit(m0, v1, v2);
+            }
+            else
+            {
+                // corner triangle at v1, then the remaining quad split along its shorter diagonal
+                cgp::Vector d0, d1;
+                emit(m0, v1, m1);
+                d0.diff(verts[v0], verts[m1]);
+                d1.diff(verts[m0], verts[v2]);
+                if(d0.sqrdlength() <= d1.sqrdlength())
+                {
+                    emit(v0, m0, m1);
+                    emit(v0, m1, v2);
+                }
+                else
+                {
+                    emit(v0, m0, v2);
+                    emit(m0, m1, v2);
+                }
+            }
+        }
+    });
+    tris.swap(newtris);
+    return numsplit;
+}
+
+int Mesh::subdivide(float tolerance, float featureangle, int maxpasses, int numthreads)
+{
+    float cosfeature = cos(featureangle * PI / 180.0f);
+    int pass, split, total = 0;
+
+    for(pass = 0; pass < maxpasses; pass++)
+    {
+        deriveFaceNorms();
+        deriveVertNorms();
+        split = subdividePass(tolerance, cosfeature, numthreads);
+        total += split;
+        if(split == 0)
+            break;
+    }
+    deriveFaceNorms();
+    deriveVertNorms();
+    if(total > 0)
+    {
+        boundspheres.clear();
+        validity = std::shared_future<MeshValidity>();
+    }
+    return total;
+}
+
+void Mesh::smooth(int iterations, float lambda, float mu, float featureangle, int numthreads)
+{
+    vector<HalfEdgeRecord> records;
+    vector<int> offsets(verts.size() + 1, 0), neighbours, fill;
+    vector<char> sharp, pinned(verts.size(), 0);
+    vector<pair<int, int>> edges;
+    vector<cgp::Point> buffer(verts.size());
+    float cosfeature = cos(featureangle * PI / 180.0f);
+    int numverts = (int) verts.size(), e, f, v;
+
+    if(iterations <= 0 || tris.empty())
+        return;
+    if(featureangle > 0.0f)
+        deriveFaceNorms();
+
+    // unique edges, flagging boundary, non-manifold and (optionally) sharp edges as features
+    sortHalfEdges(tris, records, numthreads);
+    for(e = 0; e < (int) records.size(); e = f)
+    {
+        f = e + 1;
+        while(f < (int) records.size() && records[f].key == records[e].key)
+            f++;
+        const Triangle &tri = tris[records[e].halfedge / 3];
+        edges.push_back(make_pair(tri.v[records[e].halfedge % 3], tri.v[(records[e].halfedge % 3 + 1) % 3]));
+        bool feature = false;
+        if(featureangle > 0.0f)
+        {
+            if(f - e != 2)
+                feature = true;
+            else
+            {
+                cgp::Vector na = tris[records[e].halfedge / 3].n, nb = tris[records[e + 1].halfedge / 3].n;
+                feature = na.dot(nb) < cosfeature;
+            }
+        }
+        sharp.push_back(feature);
+    }
+
+    // vertex neighbours in compressed sparse row form, with feature neighbours first
+    for(auto &edge: edges)
+    {
+        offsets[edge.first + 1]++;
+        offsets[edge.second + 1]++;
+    }
+    for(v = 0; v < numverts; v++)
+        offsets[v + 1] += offsets[v];
+    neighbours.resize(offsets[numverts]);
+    fill.assign(offsets.begin(), offsets.end() - 1);
+    vector<int> numsharp(numverts, 0);
+    for(int pass = 0; pass < 2; pass++)
+        for(e = 0; e < (int) edges.size(); e++)
+            if((bool) sharp[e] == (pass == 0))
+            {
+                neighbours[fill[edges[e].first]++] = edges[e].second;
+                neighbours[fill[edges[e].second]++] = edges[e].first;
+                if(pass == 0)
+                {
+                    numsharp[edges[e].first]++;
+                    numsharp[edges[e].second]++;
+                }
+            }
+
+    // a vertex on a feature line moves only along it, and one where lines meet or end does not move at all
+    vector<int> count(numverts);
+    for(v = 0; v < numverts; v++)
+    {
+        count[v] = (numsharp[v] == 0) ? offsets[v + 1] - offsets[v] : numsharp[v];
+        pinned[v] = (numsharp[v] != 0 && numsharp[v] != 2) || count[v] == 0;
+    }
+
+    // alternate shrinking and inflating Laplacian steps (Taubin), each a sweep from one buffer into the other
+    for(int it = 0; it < 2 * iterations; it++)
+    {
+        float factor = (it % 2 == 0) ? lambda : mu;
+        parallel::forChunks(0, numverts, numthreads, [&](int, int first, int last)
+        {
+            for(int v = first; v < last; v++)
+            {
+                const cgp::Point &p = verts[v];
+                if(pinned[v])
+                {
+                    buffer[v] = p;
+                    continue;
+                }
+                float x = 0.0f, y = 0.0f, z = 0.0f, w = 1.0f / (float) count[v];
+                for(int n = offsets[v]; n < offsets[v] + count[v]; n++)
+                {
+                    const cgp::Point &q = verts[neighbours[n]];
+                    x += q.x; y += q.y; z += q.z;
+                }
+                buffer[v] = cgp::Point(p.x + factor * (x * w - p.x), p.y + factor * (y * w - p.y), p.z + factor * (z * w - p.z));
+            }
+        });
+        verts.swap(buffer);
+    }
+
+    deriveFaceNorms();
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+}
+
+void Mesh::remesh(float targetlen, int iterations, RemeshReport &report, float featureangle, int numthreads)
+{
+    HalfEdgeMesh hem;
+
+    hem.build(verts, tris);
+    isotropicRemesh(hem, verts, tris, targetlen, iterations, report, featureangle, numthreads);
+    hem.extract(verts, tris);
+    deriveVertNorms();
+    boundspheres.clear();
+    validity = std::shared_future<MeshValidity>();
+}
+
+bool Mesh::writeSTL(string filename)
+{
+    ofstream outfile;
+    int t, p, numt;
+    unsigned short val;
+
+    outfile.open((char *) filename.c_str(), ios_base::out | ios_base::binary);
+    if(outfile.is_open())
+    {
+        outfile.write("File Generated by Tesselator. Binary STL", 80); // skippable header
+        numt = (int) tris.size();
+        outfile.write((char *) &numt, 4); // number of triangles
+
+        for(t = 0; t < numt; t++)
+        {
+            // normal
+            outfile.write((char *) &tris[t].n.i, 4);
+            outfile.write((char *) &tris[t].n.j, 4);
+            outfile.write((char *) &tris[t].n.k, 4);
+
+            // triangle vertices
+            for(p = 0; p < 3; p++)
+            {
+                outfile.write((char *) &verts[tris[t].v[p]].x, 4);
+                outfile.write((char *) &verts[tris[t].v[p]].y, 4);
+                outfile.write((char *) &verts[tris[t].v[p]].z, 4);
+            }
+
+            // attribute byte count - null
+            val = 0;
+            outfile.write((char *) &val, 2);
+        }
+
+        // tidy up
+        outfile.close();
+    }
+    else
+    {
+        cerr << "Error Mesh::writeSTL: unable to open " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+// finds all the edges based on the triangles in tris, stores edges in a vector
+// uses a hash map keyed by the welded vertex indices to keep track of which edges are in the vector already
+vector<Edge> Mesh::createEdges(const ProgressRange &range){
+	stats::Span span(timeCreateEdges);
+	Arena arena;
+	ArenaFlatMap<uint64_t, int> index{ArenaAllocator<std::pair<uint64_t, int> >(arena)};
+	std::pair<int *, bool> found;
+	vector<Edge> edges;
+	uint64_t key = 0;
+	int pos = 0;
+	// a closed mesh has one and a half edges per triangle
+	index.reserve(tris.size() * 3 / 2);
+	edges.reserve(tris.size() * 3 / 2);
+	// loops through all the triangles
+	for (int i=0; i<(int)tris.size(); i++){
+		Edge temp1,temp2,temp3;
+		bool incpos1 = false, incpos2 = false, incpos3 = false;
+		
+		// an incomplete edge list is no use to anyone, so a cancel discards it
+		if (!range.check(i, (long) tris.size())){
+			edges.clear();
+			return edges;
+		}
+		
+		// first edge of triangle
+		temp1.v[0] = tris[i].v[0];
+		temp1.v[1] = tris[i].v[1];
+		temp1.oriented = false;
+		key = edgeKey(temp1.v[0], temp1.v[1]);
+		
+		found = index.insert(key, pos);
+		if (found.second){
+			edges.push_back(temp1);
+			incpos1 = true;
+		}
+		else{
+			if (edges[*found.first].v[1] == temp1.v[0] && edges[*found.first].v[0] == temp1.v[1]){
+    			edges[*found.first].oriented = true;
+    		}	
+		}
+		if (incpos1 == true){
+			pos += 1;
+		}
+		
+		//second edge of triangle
+		temp2.v[0] = tris[i].v[1];
+		temp2.v[1] = tris[i].v[2];
+		temp2.oriented = false;
+		key = edgeKey(temp2.v[0], temp2.v[1]);
+		
+		found = index.insert(key, pos);
+		if (found.second){
+			edges.push_back(temp2);
+			incpos2 = true;
+		}
+		else{
+			if (edges[*found.first].v[1] == temp2.v[0] && edges[*found.first].v[0] == temp2.v[1]){
+    			edges[*found.first].oriented = true;
+    		}	
+		}
+		if (incpos2 == true){
+			pos += 1;
+		}
+		
+		//third edge of triangle
+		temp3.v[0] = tris[i].v[2];
+		temp3.v[1] = tris[i].v[0];
+		temp3.oriented = false;
+		key = edgeKey(temp3.v[0], temp3.v[1]);
+		
+		found = index.insert(key, pos);
+		if (found.second){
+			edges.push_back(temp3);
+			incpos3 = true;
+		}
+		else{
+			if (edges[*found.first].v[1] == temp3.v[0] && edges[*found.first].v[0] == temp3.v[1]){
+    			edges[*found.first].oriented = true;
+    		}	
+		}
+		if (incpos3 == true){
+			pos += 1;
+		}
+		
+	}
+	
+	stats::MemoryCharge indexmem;
+	indexmem.set(memTopology, vectorBytes(edges) + (std::int64_t) arena.bytesReserved());
+	//cerr < "gethere" << endl;
+	return edges;
+}
+
+cgp::BoundBox Mesh::getBounds()
+{
+    cgp::BoundBox bbox;
+    for(int i = 0; i < (int) verts.size(); i++)
+        bbox.includePnt(verts[i]);
+    return bbox;
+}
+
+// checks for basic validity of model
+bool Mesh::basicValidity()
+{
+    cgp::BoundBox bbox = getBounds();
+    return checkBasic(createEdges(), bbox);
+}
+
+bool Mesh::checkBasic(const vector<Edge> &edges, cgp::BoundBox &bbox)
+{
+    bool flag = true;
+    
+    // calculates euler's characteristic
+    int V = (int) verts.size();
+    int E = (int) edges.size();
+    int F = (int) tris.size();
+    eulerchar = V - E + F;
+    
+    for (int i=0; i<(int)edges.size(); i++){
+    	if (edges[i].oriented == false){
+    		break;
+    	}
+    }
+    
+    // checks if there are dangling vertices, counting edges at each vertex in a table indexed by vertex
+    Arena arena;
+    uts::arena_vector<int> vertindex(verts.size(), 0, ArenaAllocator<int>(arena));
+    
+    for (int i=0; i<(int)edges.size(); i++){
+    	vertindex[edges[i].v[0]] += 1;
+    	vertindex[edges[i].v[1]] += 1;
+    }
+    
+    for (int i=0; i<(int)verts.size(); i++){
+    	if (vertindex[i] == 0){
+    		flag = false;
+    		break;
+    	}
+    }
+    
+	// checks for out of bounds edges
+	for (int i=0; i<(int)edges.size(); i++){
+		if (verts[edges[i].v[0]].x < bbox.min.x || verts[edges[i].v[0]].y < bbox.min.y || verts[edges[i].v[0]].z < bbox.min.z){
+			flag = false;
+			break;
+		}
+		else if (verts[edges[i].v[0]].x > bbox.max.x || verts[edges[i].v[0]].y > bbox.max.y || verts[edges[i].v[0]].z > bbox.max.z){
+			flag = false;
+			break;
+		}
+		if (verts[edges[i].v[1]].x < bbox.min.x || verts[edges[i].v[1]].y < bbox.min.y || verts[edges[i].v[1]].z < bbox.min.z){
+			flag = false;
+			break;
+		}
+		else if (verts[edges[i].v[1]].x > bbox.max.x || verts[edges[i].v[1]].y > bbox.max.y || verts[edges[i].v[1]].z > bbox.max.z){
+			flag = false;
+			break;
+		}
+	}
+	
+   
+        
+    return flag;
+}
+
+bool Mesh::manifoldValidity()
+{
+    return checkManifold(createEdges());
+}
+
+bool Mesh::checkManifold(const vector<Edge> &edges, const ProgressRange &range)
+{
+    bool flag = true;
+    uint64_t key;
+    Arena arena; // tables for this check, freed together on return
+    
+    // checks if euler's characteristic is divisible by 2, computed here so as not to depend on basicValidity
+    int euler = (int) verts.size() - (int) edges.size() + (int) tris.size();
+    if (euler%2 == 0){
+    	flag = true;
+    }
+    else{
+    	flag = false;
+    }
+    
+    // checks that all edges have 2 incident triangles
+    if (flag == true){
+		ArenaFlatMap<uint64_t, int> edgeindex{ArenaAllocator<std::pair<uint64_t, int> >(arena)};
+		// the pass over triangles hashes twice as many edges as each pass over the edge list
+		ProgressRange keying = range.sub(0.0f, 0.25f), counting = range.sub(0.25f, 0.75f), checking = range.sub(0.75f, 1.0f);
+		edgeindex.reserve(edges.size());
+		for (int i=0; i<(int)edges.size();i++){
+			if (!keying.check(i, (long) edges.size()))
+				return false;
+			key = edgeKey(edges[i].v[0], edges[i].v[1]);
 			
 			edgeindex[key] = 0;
 		}
 		
 		for (int i=0; i<(int)tris.size();i++){
 			Edge edge1, edge2, edge3;
-			long key1, key2, key3;
+			uint64_t key1, key2, key3;
+			if (!counting.check(i, (long) tris.size()))
+				return false;
 			edge1.v[0] = tris[i].v[0];
 			edge1.v[1] = tris[i].v[1];
 			edge2.v[0] = tris[i].v[1];
@@ -666,63 +2421,33 @@ bool Mesh::manifoldValidity()
 			edge3.v[1] = tris[i].v[0];
 			
 			// creating the hash keys
-			if (hashVert(verts[edge1.v[0]],bbox) == 0){
-				key1 = hashVert(verts[edge1.v[1]],bbox);
-			}
-			else if (hashVert(verts[edge1.v[1]],bbox) == 0){
-				key1 = hashVert(verts[edge1.v[0]],bbox);
-			}
-			else{
-				key1 = hashVert(verts[edge1.v[0]],bbox) * hashVert(verts[edge1.v[1]],bbox);
-			}
+			key1 = edgeKey(edge1.v[0], edge1.v[1]);
 			
-			if (hashVert(verts[edge2.v[0]],bbox) == 0){
-				key2 = hashVert(verts[edge2.v[1]],bbox);
-			}
-			else if (hashVert(verts[edge2.v[1]],bbox) == 0){
-				key2 = hashVert(verts[edge2.v[0]],bbox);
-			}
-			else{
-				key2 = hashVert(verts[edge2.v[0]],bbox) * hashVert(verts[edge2.v[1]],bbox);
-			}
+			key2 = edgeKey(edge2.v[0], edge2.v[1]);
 			
-			if (hashVert(verts[edge3.v[0]],bbox) == 0){
-				key3 = hashVert(verts[edge3.v[1]],bbox);
-			}
-			else if (hashVert(verts[edge3.v[1]],bbox) == 0){
-				key3 = hashVert(verts[edge3.v[0]],bbox);
-			}
-			else{
-				key3 = hashVert(verts[edge3.v[0]],bbox) * hashVert(verts[edge3.v[1]],bbox);
-			}
+			key3 = edgeKey(edge3.v[0], edge3.v[1]);
 			
 			
-			if (edgeindex.find(key1) != edgeindex.end()){
-				edgeindex[key1] += 1;
+			int * count;
+			if ((count = edgeindex.find(key1)) != nullptr){
+				*count += 1;
 			}
-			if (edgeindex.find(key2) != edgeindex.end()){
-				edgeindex[key2] += 1;
+			if ((count = edgeindex.find(key2)) != nullptr){
+				*count += 1;
 			}
-			if (edgeindex.find(key3) != edgeindex.end()){
-				edgeindex[key3] += 1;
+			if ((count = edgeindex.find(key3)) != nullptr){
+				*count += 1;
 			}
 			
 		}
 		// final check to see if incident triangles is == 2
 		for (int i=0; i<(int)edges.size(); i++){
-			if (hashVert(verts[edges[i].v[0]],bbox) == 0){
-				key = hashVert(verts[edges[i].v[1]],bbox);
-			}
-			else if (hashVert(verts[edges[i].v[1]],bbox) == 0){
-				key = hashVert(verts[edges[i].v[0]],bbox);
-			}
-			else{
-				key = hashVert(verts[edges[i].v[0]],bbox) * hashVert(verts[edges[i].v[1]],bbox);
-			}
+			if (!checking.check(i, (long) edges.size()))
+				return false;
+			key = edgeKey(edges[i].v[0], edges[i].v[1]);
 			
 			if (edgeindex[key] != 2){
 				flag = false;
-				cerr << edgeindex[key] << endl;
 				break;
 			}
 		}
@@ -731,10 +2456,7 @@ bool Mesh::manifoldValidity()
     
     // checks that all vertices have closed rings of traingle around them
     if (flag == true){
-		unordered_map<int,int> vertindex;
-		for (int i=0; i<(int)verts.size(); i++){
-			vertindex[i] = 0;
-		}
+		uts::arena_vector<int> vertindex(verts.size(), 0, ArenaAllocator<int>(arena));
 		
 		for (int i=0; i<(int)edges.size(); i++){
 			vertindex[edges[i].v[0]] += 1;
@@ -754,31 +2476,53 @@ bool Mesh::manifoldValidity()
 }
 
 // returns euler's characteristic
-int Mesh::getEuler(){
+int Mesh::getEuler() const {
+	// a BACKGROUND validation delivers the characteristic with its results rather than through eulerchar
+	if(validity.valid()){
+		const MeshValidity &result = validity.get();
+		if(result.tested)
+			return result.euler;
+	}
 	return eulerchar;
 }
 
 // returns verts vector
-vector<cgp::Point> Mesh::getVerts(){
+const vector<cgp::Point> &Mesh::getVerts() const {
 	return verts;
 }
 
-// resets verts vector
+// returns tris vector
+const vector<Triangle> &Mesh::getTris() const {
+	return tris;
+}
+
+// resets verts vector, taking over the storage of pnt
 void Mesh::setVerts(vector<cgp::Point> pnt){
-	verts.clear();
-	verts = pnt;
+	verts = std::move(pnt);
+	chargeMemory();
+}
+
+// adds vertices to the end of the verts vector
+int Mesh::appendVerts(const vector<cgp::Point> &pnts){
+	int first = (int) verts.size();
+	verts.insert(verts.end(), pnts.begin(), pnts.end());
+	chargeMemory();
+	return first;
+}
+
+// changes each vertex in place
+void Mesh::transformVerts(const std::function<void(int, cgp::Point &)> &f){
+	for (int i=0; i<(int)verts.size(); i++)
+		f(i, verts[i]);
 }
 
 // returns the edges vector
 vector<Edge> Mesh::getEdges(){
-	cgp::BoundBox bbox;
-    for(int i = 0; i < (int) verts.size(); i++)
-        bbox.includePnt(verts[i]);
-	return createEdges(bbox);	
+	return createEdges();
 }
 
 // checks that edges are in bounds
-bool Mesh::checkEdgeBound(vector<Edge> edges){
+bool Mesh::checkEdgeBound(const vector<Edge> &edges) const {
 	cgp::BoundBox bbox;
     for(int i = 0; i < (int) verts.size()-2; i++)
         bbox.includePnt(verts[i]);
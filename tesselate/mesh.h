@@ -10,11 +10,18 @@
 #include <vector>
 #include <stdio.h>
 #include <iostream>
+#include <future>
+#include <functional>
+#include <thread>
+#include <memory>
+#include <common/progress.h>
+#include <common/stats.h>
 #include "renderer.h"
 
 using namespace std;
 
 const int sphperdim = 20;
+const int weldcells = 2500; ///< fewest cells along each axis of the grid on which mergeVerts welds, see Mesh::weldCells
 
 /**
  * A triangle in 3D space, with 3 indices into a vertex list and an outward facing normal. Triangle winding is counterclockwise.
@@ -35,6 +42,114 @@ struct Edge
     bool oriented;
 };
 
+struct VoxelGrid;
+struct DistanceGrid;
+struct RemeshReport;
+
+/**
+ * Boolean combination of two solids
+ */
+enum class BooleanOp
+{
+    UNION,          ///< points inside either solid
+    INTERSECTION,   ///< points inside both solids
+    DIFFERENCE      ///< points inside the first solid but not the second
+};
+
+/**
+ * How much validity testing to perform when a mesh is loaded
+ */
+enum class ValidationPolicy
+{
+    OFF,        ///< no validation
+    BASIC,      ///< basic validity only
+    FULL,       ///< basic and manifold validity, sharing a single edge list
+    BACKGROUND, ///< basic and manifold validity on a worker thread, without blocking the caller
+};
+
+/**
+ * Outcome of mesh validation
+ */
+struct MeshValidity
+{
+    bool tested;            ///< true if basic validity was tested, otherwise all other fields are meaningless
+    bool basic;             ///< outcome of the basic validity test
+    bool manifoldTested;    ///< true if manifold validity was tested
+    bool manifold;          ///< outcome of the manifold validity test, false if not tested
+    int euler;              ///< Euler characteristic V - E + F
+};
+
+/**
+ * Outcome of a search for self-intersections, see @a Mesh::selfIntersections
+ */
+enum class IntersectionSearch
+{
+    NONE,       ///< the whole mesh was searched and no triangles intersect
+    FOUND,      ///< the whole mesh was searched, or searched until the first intersection, and triangles intersect
+    CANCELLED,  ///< the search was cancelled part way, so intersections may have been missed
+};
+
+/**
+ * Handle on the worker thread of a BACKGROUND validation. A copy of a mesh does not share its worker, so
+ * copying gives an idle handle and leaves the original's worker alone.
+ */
+struct ValidationWorker
+{
+    std::thread thread;                 ///< running worker, if joinable
+    std::shared_ptr<Progress> progress; ///< cancellation, shared with the worker
+
+    ValidationWorker(){}
+    ValidationWorker(const ValidationWorker &){}
+    ValidationWorker &operator=(const ValidationWorker &){ return *this; }
+    ~ValidationWorker(){ stop(); }
+
+    /// Cancel the worker, if any, and wait for it to return
+    void stop()
+    {
+        if(progress)
+            progress->cancel();
+        if(thread.joinable())
+            thread.join();
+        progress.reset();
+    }
+};
+
+/**
+ * Summary of a single connected shell of triangles, see @a Mesh::shellStats
+ */
+struct ShellStats
+{
+    int numtris;            ///< number of triangles in the shell
+    cgp::BoundBox bbox;     ///< bounding box of the shell's vertices
+    double volume;          ///< signed enclosed volume, positive for outward facing triangles. Only meaningful if closed.
+    double area;            ///< total surface area
+    bool closed;            ///< true if every edge of the shell has exactly two incident triangles
+};
+
+/**
+ * Integral properties of a closed mesh treated as a solid of unit density, see @a Mesh::massProperties
+ */
+struct MassProperties
+{
+    double volume;          ///< signed enclosed volume, positive for outward facing triangles
+    double area;            ///< total surface area
+    double centroid[3];     ///< centre of mass (x, y, z)
+    double inertia[3][3];   ///< inertia tensor about the centroid, symmetric
+};
+
+/**
+ * Counts of the changes made by @a Mesh::repair
+ */
+struct RepairReport
+{
+    int degenerate;         ///< triangles removed for having zero area or a repeated vertex
+    int duplicates;         ///< triangles removed for repeating the vertices of an earlier triangle
+    int flipped;            ///< original triangles whose winding was reversed
+    int holes;              ///< boundary loops filled
+    int unfilled;           ///< boundary chains that could not be closed into a loop, usually at non-manifold vertices
+    int filltris;           ///< triangles added to fill holes
+};
+
 /**
  * A sphere in 3D space, consisting of a center and radius. Used for bounding sphere hierarchy acceleration.
  */
@@ -59,6 +174,9 @@ public:
  */
 class Mesh
 {
+    friend class TestMesh;      ///< unit tests exercise welding on its own
+    friend class BenchMesh;     ///< benchmarks time the stages of readSTL separately
+
 private:
     std::vector<cgp::Point> verts; ///< vertices of the tesselation structure
     std::vector<cgp::Vector> norms;  ///< per vertex normals
@@ -69,6 +187,9 @@ private:
     float xrot, yrot, zrot;     ///< rotation angles about x, y, and z axes
     std::vector<Sphere> boundspheres; ///< bounding sphere accel structure
     int eulerchar;
+    std::shared_future<MeshValidity> validity; ///< result of the last call to validate, possibly still pending
+    ValidationWorker validator; ///< worker running a BACKGROUND validation, stopped before the next one starts or the mesh is cleared
+    stats::MemoryCharge memory; ///< bytes of verts, norms and tris
 
     /**
      * Search list of vertices to find matching point
@@ -77,7 +198,7 @@ private:
      * @retval true  if the point is found in the vertex list,
      * @retval false otherwise
      */
-    bool findVert(cgp::Point pnt, int &idx);
+    bool findVert(const cgp::Point &pnt, int &idx) const;
 
     /**
      * Search a list of edges to find matching edge
@@ -87,25 +208,131 @@ private:
      * @retval true  if the point is found in the vertex list,
      * @retval false otherwise
      */
-    bool findEdge(vector<Edge> edges, Edge e, int &idx);
+    bool findEdge(const vector<Edge> &edges, const Edge &e, int &idx) const;
 
     /**
      * Construct a hash key based on a 3D point
      * @param pnt   point to convert to key
      * @param bbox  bounding box enclosing all mesh vertices
+     * @param cells number of grid cells along each axis, from @ref weldCells
      * @retval hash key
      */
-    long hashVert(cgp::Point pnt, cgp::BoundBox bbox);
+    long hashVert(const cgp::Point &pnt, const cgp::BoundBox &bbox, long cells) const;
 
-    /// Connect triangles together by merging duplicate vertices
-    void mergeVerts();
+    /**
+     * Connect triangles together by merging duplicate vertices
+     * @param range     progress reporting and cancellation
+     * @retval true  if the vertices were merged,
+     * @retval false if cancelled or the memory budget would be exceeded, leaving the mesh unchanged
+     */
+    bool mergeVerts(const ProgressRange &range = ProgressRange());
 
     /// Generate vertex normals by averaging normals of the surrounding faces
     void deriveVertNorms();
 
+    /// Bounding box enclosing all vertices
+    cgp::BoundBox getBounds();
+
     /// Generate face normals from triangle vertex positions
     void deriveFaceNorms();
 
+    /**
+     * Update the bytes charged to the mesh core memory account from the capacity of verts, norms and tris.
+     * Called wherever these are replaced wholesale, including deriveVertNorms, which ends most edits.
+     */
+    void chargeMemory();
+
+    /**
+     * Remove triangles with a repeated vertex, zero area, or the same vertices as an earlier triangle
+     * @param[out] degenerate   number of degenerate triangles removed
+     * @param[out] duplicates   number of duplicate triangles removed
+     */
+    void removeBadTriangles(int &degenerate, int &duplicates);
+
+    /**
+     * Flip triangles so that neighbours across every two-triangle edge traverse it in opposite directions
+     * @param[in,out] flips     toggled for each triangle flipped, one entry per triangle
+     */
+    void orientConsistently(std::vector<char> &flips);
+
+    /**
+     * Find boundary loops and close them with new triangles
+     * @param maxdphole     largest hole filled by minimum area triangulation
+     * @param[out] report   holes, unfilled and filltris are updated
+     */
+    void fillHoles(int maxdphole, RepairReport &report);
+
+    /**
+     * Triangulate a single boundary loop
+     * @param loop          vertex indices in the order of the boundary half-edges
+     * @param maxdphole     largest loop triangulated by minimum area, larger loops are fanned about a new centroid vertex
+     * @retval number of triangles added, which leaves out any with zero area or a repeated vertex
+     */
+    int fillLoop(const std::vector<int> &loop, int maxdphole);
+
+    /**
+     * Flip every shell with negative signed volume so that it faces outward
+     * @param[in,out] flips     toggled for each triangle flipped, extended to one entry per triangle
+     */
+    void orientOutward(std::vector<char> &flips);
+
+    /// Remove vertices not referenced by any triangle, renumbering the rest
+    void compactVerts();
+
+    /**
+     * Spacing of distance samples for a distance field operation, fine enough to resolve a feature of the
+     * given size but no finer than 512 samples along the longest side, so that the lattice stays tractable
+     * @param feature   smallest distance that must be resolved, such as a wall thickness or offset
+     */
+    float sdfVoxelSize(float feature);
+
+    /**
+     * Move every vertex along its normal, lengthened at creases so that adjoining faces move by the full distance.
+     * Vertices at exactly the same position move together, and every vertex keeps its index.
+     * @param distance      offset distance, positive outward
+     * @param numthreads    number of threads to use, 0 for one per core
+     * @retval true  if the vertices were moved,
+     * @retval false if this would fold a triangle over, in which case the mesh is unchanged
+     */
+    bool offsetAlongNormals(float distance, int numthreads);
+
+    /**
+     * Test whether any triangle of this mesh intersects any triangle of another, see @a boolean
+     * @param other         mesh to test against
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    bool intersectsMesh(Mesh &other, int numthreads);
+
+    /**
+     * Single pass of adaptive subdivision, see @a subdivide. Face and vertex normals must be current.
+     * @param tolerance     largest chord error left unsplit
+     * @param cosfeature    cosine of the crease angle
+     * @param numthreads    number of threads to use, 0 for one per core
+     * @retval number of edges split
+     */
+    int subdividePass(float tolerance, float cosfeature, int numthreads);
+
+    /**
+     * Basic validity tests on a precomputed edge list, see @a basicValidity
+     * @param edges     edges of the mesh, as produced by @a createEdges
+     * @param bbox      bounding box enclosing all mesh vertices
+     */
+    bool checkBasic(const vector<Edge> &edges, cgp::BoundBox &bbox);
+
+    /**
+     * Manifold validity tests on a precomputed edge list, see @a manifoldValidity
+     * @param edges     edges of the mesh, as produced by @a createEdges
+     * @param range     progress reporting and cancellation, false is returned if cancelled
+     */
+    bool checkManifold(const vector<Edge> &edges, const ProgressRange &range = ProgressRange());
+
+    /**
+     * Run the tests requested by a policy on the calling thread
+     * @param policy    tests to run, BACKGROUND is treated as FULL
+     * @param range     progress reporting and cancellation. If cancelled the result has tested set to false.
+     */
+    MeshValidity runValidation(ValidationPolicy policy, const ProgressRange &range = ProgressRange());
+
     /**
      * Composite rotations, translation and scaling into a single transformation matrix
      * @param tfm   composited transformation matrix
@@ -120,7 +347,7 @@ public:
 
     ~Mesh();
 
-    /// Remove all vertices and triangles, resetting the structure
+    /// Remove all vertices and triangles, resetting the structure and stopping any BACKGROUND validation
     void clear();
 
     /// Test whether mesh is empty of any geometry (true if empty, false otherwise)
@@ -150,11 +377,11 @@ public:
     /**
      * Generate triangle mesh geometry for OpenGL rendering
      * @param view      current view parameters
-     * @param[out] sdd  openGL parameters required to draw this geometry
-     * @retval true  if buffers are bound successfully, in which case sdd is valid,
+     * @param[out] sdds openGL parameters required to draw this geometry, appended with one entry per spatial chunk
+     * @retval true  if buffers are bound successfully, in which case sdds holds the new chunks,
      * @retval false otherwise
      */
-    bool genGeometry(View * view, ShapeDrawData &sdd);
+    bool genGeometry(View * view, std::vector<ShapeDrawData> &sdds);
 
     /**
      * Scale geometry to fit bounding cube centered at origin
@@ -163,12 +390,294 @@ public:
     void boxFit(float sidelen);
 
     /**
-     * Read in triangle mesh from STL format binary file
+     * Read in triangle mesh from STL format binary file. Equivalent to @a parseSTL followed by @a weld and @a validate.
+     * @param filename      name of file to load (STL format)
+     * @param validation    validity tests to run once loaded
+     * @param progress      optional progress reporting and cancellation, may be NULL
+     * @retval true  if load succeeds,
+     * @retval false otherwise, including when cancelled, in which case the mesh is left empty.
+     */
+    bool readSTL(string filename, ValidationPolicy validation = ValidationPolicy::FULL, Progress * progress = NULL);
+
+    /**
+     * Read the raw triangle soup from an STL format binary file. Vertices are not merged, so each triangle
+     * has its own three vertices, and no vertex normals are derived. Reports progress over [0, 0.6].
      * @param filename  name of file to load (STL format)
+     * @param progress  optional progress reporting and cancellation, may be NULL
      * @retval true  if load succeeds,
-     * @retval false otherwise.
+     * @retval false otherwise, including when cancelled, in which case the mesh is left empty.
+     */
+    bool parseSTL(string filename, Progress * progress = NULL);
+
+    /**
+     * Turn a triangle soup into a connected mesh by merging coincident vertices and deriving vertex normals.
+     * Reports progress over [0.6, 0.8].
+     * @param progress  optional progress reporting and cancellation, may be NULL
+     * @retval true  if welding completes,
+     * @retval false if cancelled or over the memory budget, in which case the mesh is left empty.
+     */
+    bool weld(Progress * progress = NULL);
+
+    /**
+     * Run validity tests and report the outcome on cerr. Results are available from @a getValidity.
+     * With the BACKGROUND policy the tests run on a snapshot of the mesh in a worker thread, and this returns
+     * immediately; otherwise progress is reported over [0.8, 1].
+     * @param policy    which tests to run and where
+     * @param progress  optional progress reporting, may be NULL. A cancel during the tests, or tests that
+     *                  would go over the memory budget, leave the result with tested set to false.
+     * @param listener  optional callback receiving the results. For BACKGROUND it is called on the worker
+     *                  thread unless the validation is cancelled, otherwise before returning.
+     */
+    void validate(ValidationPolicy policy = ValidationPolicy::FULL, Progress * progress = NULL,
+                  std::function<void(const MeshValidity &)> listener = nullptr);
+
+    /**
+     * Stop a BACKGROUND validation still running and wait for its worker, which sees the cancel within a few
+     * milliseconds. The result then has tested set to false and the listener is not called. Called from
+     * the thread that owns the mesh, as are clear, takeGeometry and the destructor, which all do this first.
+     */
+    void cancelValidation();
+
+    /// Test whether results of the last validation are available without waiting
+    bool validityReady();
+
+    /**
+     * Results of the last validation, waiting for a BACKGROUND validation to finish if necessary. If no
+     * validation has been run since the mesh was loaded, the result has tested set to false.
+     */
+    MeshValidity getValidity();
+
+    /**
+     * Label connected shells, where triangles sharing a vertex belong to the same shell. Runs in near-linear
+     * time using a concurrent union-find over vertices, so the mesh should have been welded first.
+     * @param[out] shell    shell index of each triangle. Shells are numbered in order of their lowest vertex index.
+     * @param numthreads    number of threads to use, 0 for one per core
+     * @retval number of shells
+     */
+    int labelShells(std::vector<int> &shell, int numthreads = 0);
+
+    /**
+     * Compute triangle count, bounding box, signed volume, area and closedness for every connected shell
+     * @param[out] stats    statistics for each shell, indexed as in @a labelShells
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void shellStats(std::vector<ShellStats> &stats, int numthreads = 0);
+
+    /**
+     * Compute volume, surface area, centroid and inertia tensor from surface integrals over the triangles,
+     * by the divergence theorem. Only meaningful for closed meshes with consistent outward winding.
+     * Triangles are summed in fixed size blocks combined with compensated summation, so the result is
+     * identical for any number of threads.
+     * @param[out] props    mass properties, with centroid and inertia zero if the volume is zero
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void massProperties(MassProperties &props, int numthreads = 0);
+
+    /**
+     * Split each connected shell into an independent mesh with its own compacted vertex list. Vertex normals
+     * are carried across if present. Transformation and colour settings are not.
+     * @param[out] shells   one mesh per shell, indexed as in @a labelShells
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void splitShells(std::vector<Mesh> &shells, int numthreads = 0);
+
+    /**
+     * Repair common defects in a welded mesh, in linear time: remove degenerate and duplicate triangles, make
+     * winding consistent so that every interior edge is oriented, fill boundary loops and finally turn each
+     * shell outward facing. Holes of up to @a maxdphole vertices are filled by a minimum area triangulation,
+     * larger holes by a fan around their centroid. Unused vertices are removed and normals are rederived.
+     * @param[out] report   what was changed
+     * @param maxdphole     largest hole filled by minimum area triangulation, which is cubic in hole size
+     * @param progress      optional progress reporting and cancellation, may be NULL. A cancel is seen between
+     *                      stages, after which the remaining stages are skipped but the mesh is still tidied up.
+     * @retval true  if the repair ran to completion,
+     * @retval false if it was cancelled, leaving the mesh partly repaired
+     */
+    bool repair(RepairReport &report, int maxdphole = 128, Progress * progress = NULL);
+
+    /**
+     * Find pairs of triangles that intersect each other, using a bounding volume hierarchy over the triangles as
+     * a broad phase and running exact tests in parallel. Contact at a shared vertex or edge does not count:
+     * triangles sharing one vertex intersect if either opposite edge meets the other triangle, triangles sharing
+     * an edge if they are folded flat onto each other, and duplicate triangles always.
+     * @param[out] pairs    intersecting pairs (a, b) with a < b, sorted. With @a stopatfirst, at most one pair.
+     * @param stopatfirst   stop as soon as any intersection is found, for a quick pass/fail test
+     * @param numthreads    number of threads to use, 0 for one per core
+     * @param progress      optional progress reporting and cancellation, may be NULL. If cancelled, the search
+     *                      stops early with only the pairs found so far.
+     * @return FOUND if any intersection was found, NONE if the search completed without finding one, and
+     *         CANCELLED if it was cancelled first, whether or not pairs were found
+     */
+    IntersectionSearch selfIntersections(std::vector<std::pair<int, int>> &pairs, bool stopatfirst = false, int numthreads = 0,
+                           Progress * progress = NULL);
+
+    /**
+     * Convert a closed mesh into solid voxels, see ::voxelise
+     * @param[out] grid     solid voxels
+     * @param resolution    number of voxels along the longest side of the bounding box
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void voxelise(VoxelGrid &grid, int resolution, int numthreads = 0);
+
+    /**
+     * Replace the geometry of this mesh with the boundary of a set of solid voxels, see ::polygonise.
+     * Normals are derived and any earlier validation is discarded.
+     * @param grid          voxels to convert
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void fromVoxels(const VoxelGrid &grid, int numthreads = 0);
+
+    /**
+     * Replace the geometry of this mesh with a subdivided icosahedron, see ::icosphere.
+     * Normals are derived and any earlier validation is discarded.
+     * @param levels    number of rounds of subdivision, giving 20 * 4^levels triangles
+     * @param radius    sphere radius
+     */
+    void generateIcosphere(int levels, float radius = 1.0f);
+
+    /**
+     * Replace the geometry of this mesh with a closed surface of the given genus, see ::genusTorus.
+     * Normals are derived and any earlier validation is discarded.
+     * @param genus         number of holes, at least 1
+     * @param resolution    samples across the diameter of one ring
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void generateTorus(int genus, int resolution, int numthreads = 0);
+
+    /**
+     * Replace the geometry of this mesh with a cube of gyroid cells, see ::gyroid.
+     * Normals are derived and any earlier validation is discarded.
+     * @param cells         unit cells along each side of the cube
+     * @param resolution    samples across one cell
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void generateGyroid(int cells, int resolution, int numthreads = 0);
+
+    /**
+     * Turn this welded mesh into an unwelded triangle soup with repeated triangles and holes, see ::triangleSoup.
+     * Normals are derived and any earlier validation is discarded.
+     * @param duplicates    number of extra copies of triangles, as a fraction of the surviving triangles
+     * @param holes         number of single triangle holes to cut
+     * @param seed          seed for the pseudo-random choices
+     */
+    void generateSoup(float duplicates, int holes, unsigned int seed = 1);
+
+    /**
+     * Number of cells along each axis of the grid on which mergeVerts welds, each a fraction of the bounding box
+     * diagonal. Vertices sharing a cell are merged, so the grid gets finer with the square root of the triangle
+     * count to keep the typical edge several cells long whatever the size of the mesh.
+     * @param numtris   number of triangles being welded
+     * @retval cells along each axis, at least @ref weldcells and at most 2^20
+     */
+    static long weldCells(long numtris);
+
+    /**
+     * Compute the signed distance field of a closed mesh within a narrow band about its surface, see ::distanceField
+     * @param[out] grid     distance samples
+     * @param voxelsize     spacing between samples
+     * @param bandwidth     distance from the surface within which samples are exact
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void distanceField(DistanceGrid &grid, float voxelsize, float bandwidth, int numthreads = 0);
+
+    /**
+     * Hollow out a closed mesh, leaving a wall of the given thickness. The inset surface is extracted from the
+     * signed distance field and added to the mesh as a separate shell facing into the cavity. Normals are
+     * derived and any earlier validation is discarded.
+     * @param thickness     wall thickness
+     * @param voxelsize     spacing of distance samples, 0 to choose one from the thickness and mesh size
+     * @param numthreads    number of threads to use, 0 for one per core
+     * @retval true  if a cavity was added,
+     * @retval false if the mesh is too thin anywhere to contain one, in which case it is unchanged
+     */
+    bool hollow(float thickness, float voxelsize = 0.0f, int numthreads = 0);
+
+    /**
+     * Offset every surface of a closed mesh, outward for a positive distance and inward for a negative one.
+     * Offsets that are small compared to the mesh edges move each vertex along its normal. Larger offsets, or any
+     * that would fold a triangle over, instead rebuild the surface as a level set of the signed distance field.
+     * Moved vertices keep their indices, and a rebuilt surface is welded through its lattice edges. Either way
+     * normals are derived and any earlier validation discarded.
+     * @param distance      offset distance
+     * @param voxelsize     spacing of distance samples, if they are needed, 0 to choose one from the distance and mesh size
+     * @param numthreads    number of threads to use, 0 for one per core
+     * @retval true  if the mesh was offset,
+     * @retval false if an inward offset leaves nothing, in which case the mesh is unchanged
+     */
+    bool offset(float distance, float voxelsize = 0.0f, int numthreads = 0);
+
+    /**
+     * Replace this mesh with an approximate voxel boolean combination of itself and another closed mesh. The
+     * result is the zero level set of the combined signed distance fields, which is closed and manifold but
+     * resamples the whole surface and rounds features smaller than the voxel size. Only when the surfaces do not
+     * meet at all are whole shells kept, dropped or turned inside out instead, leaving them as they were.
+     * Normals are derived and any earlier validation is discarded.
+     * @param other         second operand, unchanged
+     * @param op            combination, this op other
+     * @param voxelsize     spacing of distance samples, if they are needed, 0 to choose one from the mesh sizes
+     * @param numthreads    number of threads to use, 0 for one per core
+     * @retval true  if the result is not empty,
+     * @retval false if the result is empty, in which case the mesh is unchanged
+     */
+    bool boolean(Mesh &other, BooleanOp op, float voxelsize = 0.0f, int numthreads = 0);
+
+    /**
+     * Adaptively subdivide a welded mesh to reduce faceting. Each pass places a point on every edge shared by two
+     * triangles on the cubic curve through its ends that matches their normals, and splits the edge there if
+     * that point is further than the tolerance from the edge (its chord error). Triangles are split 1-to-2, 1-to-3
+     * or 1-to-4 according to how many of their edges are split, so the result stays welded without a re-merge.
+     * Edges where the faces meet at more than the feature angle are creases and are never curved. Edge points
+     * and new triangles are computed in parallel. Normals are derived and any earlier validation is discarded.
+     * @param tolerance     largest chord error left unsplit
+     * @param featureangle  smallest angle between face normals, in degrees, treated as a crease
+     * @param maxpasses     maximum number of subdivision passes
+     * @param numthreads    number of threads to use, 0 for one per core
+     * @retval number of edges split
+     */
+    int subdivide(float tolerance, float featureangle = 30.0f, int maxpasses = 4, int numthreads = 0);
+
+    /**
+     * Smooth a welded mesh without shrinking it (Taubin's lambda|mu method), alternating Laplacian steps of
+     * opposite sign over the vertex neighbours, which are held in compressed sparse row form. Each step reads one
+     * vertex buffer and writes the other, in parallel. With a feature angle, edges where the faces meet at more
+     * than that angle, and boundary edges, are features: vertices on a single feature line move only along it,
+     * and vertices where feature lines meet or end stay put. Normals are derived and any earlier validation is
+     * discarded.
+     * @param iterations    number of shrink and inflate step pairs
+     * @param lambda        shrinking step factor, between 0 and 1
+     * @param mu            inflating step factor, negative and slightly larger in magnitude than lambda
+     * @param featureangle  smallest angle between face normals, in degrees, treated as a feature, 0 to smooth everywhere
+     * @param numthreads    number of threads to use, 0 for one per core
+     */
+    void smooth(int iterations, float lambda = 0.5f, float mu = -0.53f, float featureangle = 0.0f, int numthreads = 0);
+
+    /**
+     * Remesh a welded mesh towards equilateral triangles of a target edge length, see ::isotropicRemesh.
+     * Boundaries, non-manifold edges and creases are kept. Normals are derived and any earlier validation is
+     * discarded.
+     * @param targetlen     target edge length
+     * @param iterations    number of rounds of split, collapse, flip and relax
+     * @param[out] report   counts of each operation and throughput
+     * @param featureangle  smallest angle between face normals, in degrees, treated as a crease, 0 for none
+     * @param numthreads    number of threads to use, 0 for one per core
      */
-    bool readSTL(string filename);
+    void remesh(float targetlen, int iterations, RemeshReport &report, float featureangle = 45.0f, int numthreads = 0);
+
+    /**
+     * Build a reduced copy of the mesh for quick display by keeping a regular subset of triangles. Triangles
+     * are unconnected and carry their face normal at each vertex, so this can be applied to a raw soup.
+     * @param[out] preview  mesh receiving the reduced geometry, previous contents are discarded
+     * @param maxtris       maximum number of triangles to keep
+     */
+    void decimate(Mesh &preview, int maxtris);
+
+    /**
+     * Move the vertices, normals and triangles of another mesh into this one, leaving the other empty.
+     * Transformation and colour settings of this mesh are retained. A BACKGROUND validation of this mesh is
+     * cancelled, and one running on the other mesh moves across along with its results.
+     * @param from  mesh to take geometry from
+     */
+    void takeGeometry(Mesh &from);
 
     /**
      * Write triangle mesh to STL format binary file
@@ -178,7 +687,12 @@ public:
      */
     bool writeSTL(string filename);
     
-    vector<Edge> createEdges(cgp::BoundBox bbox);
+    /**
+     * Build the list of distinct edges of the triangles
+     * @param range     progress reporting and cancellation. If cancelled the list returned is empty.
+     * @return edges, each marked oriented if its two triangles traverse it in opposite directions
+     */
+    vector<Edge> createEdges(const ProgressRange &range = ProgressRange());
     /**
      * Basic mesh validity tests - report euler's characteristic, no dangling vertices, edge indices within bounds of the vertex list
      * @retval true if basic validity tests are passed,
@@ -190,22 +704,46 @@ public:
     /**
      * Check that the mesh is a closed two-manifold - every edge has two incident triangles, every vertex has
      *                                                a closed ring of triangles around it
-     * This test does not include self-intersection of individual triangles as this is outside the scope.
+     * This test does not include self-intersection of individual triangles, see @a selfIntersections for that.
      * @retval true if the mesh is two-manifold,
      * @retval false otherwise
      * @todo manifoldValidity requires completing for CGP Prac1
      */
     bool manifoldValidity();
     
-    int getEuler();
-    
-    vector<cgp::Point> getVerts();
-    
+    /// Euler characteristic from the last validation, waiting for a BACKGROUND validation to finish if necessary
+    int getEuler() const;
+
+    /// Vertex positions, without copying. The reference is invalidated when the vertices are next changed.
+    const vector<cgp::Point> &getVerts() const;
+
+    /// Triangles indexing into @ref getVerts, without copying. The reference is invalidated when the triangles are next changed.
+    const vector<Triangle> &getTris() const;
+
+    /**
+     * Replace the vertices, keeping the triangles. The argument is moved into the mesh, so passing
+     * std::move of an array or a temporary avoids a copy.
+     * @param pnt   new vertex positions
+     */
     void setVerts(vector<cgp::Point> pnt);
-    
+
+    /**
+     * Add vertices after the existing ones, leaving the triangles unchanged
+     * @param pnts  vertices to add
+     * @return index of the first added vertex
+     */
+    int appendVerts(const vector<cgp::Point> &pnts);
+
+    /**
+     * Change every vertex in place, without copying the vertex array out and back
+     * @param f     called with the index and a reference to each vertex in turn
+     */
+    void transformVerts(const std::function<void(int, cgp::Point &)> &f);
+
+    /// Edges of the triangles, built afresh by @ref createEdges and returned without a further copy
     vector<Edge> getEdges();
-    
-    bool checkEdgeBound(vector<Edge> edges);
+
+    bool checkEdgeBound(const vector<Edge> &edges) const;
 };
 
 #endif
@@ -3,6 +3,12 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <set>
+#include <common/stats.h>
+
+static stats::Counter statChunksDrawn("render.chunksDrawn");       ///< chunks submitted for drawing
+static stats::Counter statChunksCulled("render.chunksCulled");     ///< chunks rejected by the frustum test
+static stats::Counter statChunksOccluded("render.chunksOccluded"); ///< chunks found hidden by occlusion queries
 
 Renderer::Renderer(QGLWidget *drawTo, const std::string& dir)
 {
@@ -10,6 +16,12 @@ Renderer::Renderer(QGLWidget *drawTo, const std::string& dir)
     shaderDir = dir;
     shadersReady = false;
 
+    // culling
+    frustumCulling = true;
+    occlusionCulling = false;
+    vaoBox = vboBox = iboBox = 0;
+    numDrawn = numCulled = numOccluded = 0;
+
     // lights
     pointLight = glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
     directionalLight[0] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
@@ -87,6 +99,115 @@ void Renderer::initShaders(void)
     std::cout << "done!\n";
 }
 
+bool Renderer::inFrustum(const ShapeDrawData &sdd, const glm::mat4x4 &mvp)
+{
+    glm::vec4 row[4], plane;
+    glm::vec3 pvert;
+    int r, p, a;
+
+    if(sdd.boundmin[0] > sdd.boundmax[0]) // no bounds available, so assume visible
+        return true;
+
+    for(r = 0; r < 4; r++)
+        row[r] = glm::vec4(mvp[0][r], mvp[1][r], mvp[2][r], mvp[3][r]);
+
+    // clip planes extracted from the composite matrix: left, right, bottom, top, near, far
+    for(p = 0; p < 6; p++)
+    {
+        if(p % 2 == 0)
+            plane = row[3] + row[p/2];
+        else
+            plane = row[3] - row[p/2];
+
+        // corner of the box furthest along the plane normal
+        for(a = 0; a < 3; a++)
+            pvert[a] = (plane[a] >= 0.0f) ? sdd.boundmax[a] : sdd.boundmin[a];
+
+        if(plane.x * pvert.x + plane.y * pvert.y + plane.z * pvert.z + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void Renderer::initOcclusionProxy()
+{
+    if(vaoBox != 0) // already created
+        return;
+
+    GLfloat corners[24] = { 0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+                            0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 1.0f };
+    GLuint faces[36] = { 0, 2, 1,  0, 3, 2,  4, 5, 6,  4, 6, 7,  0, 1, 5,  0, 5, 4,
+                         3, 7, 6,  3, 6, 2,  0, 4, 7,  0, 7, 3,  1, 2, 6,  1, 6, 5 };
+
+    glGenVertexArrays(1, &vaoBox); CE();
+    glBindVertexArray(vaoBox); CE();
+
+    glGenBuffers(1, &vboBox); CE();
+    glBindBuffer(GL_ARRAY_BUFFER, vboBox); CE();
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW); CE();
+
+    glGenBuffers(1, &iboBox); CE();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboBox); CE();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW); CE();
+
+    // position only, remaining attributes take their constant defaults
+    glEnableVertexAttribArray(0); CE();
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (void*)(0)); CE();
+
+    glBindVertexArray(0); CE();
+}
+
+bool Renderer::crossesNearPlane(const ShapeDrawData &sdd, const glm::mat4x4 &mvp)
+{
+    for(int c = 0; c < 8; c++)
+    {
+        glm::vec4 corner = mvp * glm::vec4((c & 1) ? sdd.boundmax[0] : sdd.boundmin[0],
+                                           (c & 2) ? sdd.boundmax[1] : sdd.boundmin[1],
+                                           (c & 4) ? sdd.boundmax[2] : sdd.boundmin[2], 1.0f);
+        if(corner.z < -corner.w) // in front of the near plane in clip space, which includes points behind the eye
+            return true;
+    }
+    return false;
+}
+
+void Renderer::collectOcclusionResults()
+{
+    std::set<std::pair<GLuint, GLuint> > live;
+    GLuint available, samples;
+
+    for(int i = 0; i < (int) drawCallData.size(); i++)
+        live.insert(std::make_pair(drawCallData[i].VAO, drawCallData[i].indexOffset));
+
+    numOccluded = 0;
+    std::map<std::pair<GLuint, GLuint>, OcclusionQuery>::iterator it = queries.begin();
+    while(it != queries.end())
+    {
+        OcclusionQuery &query = it->second;
+        if(query.issued)
+        {
+            // never wait on the GPU, a result that is not yet ready is simply not counted
+            glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available); CE();
+            if(available == GL_TRUE)
+            {
+                glGetQueryObjectuiv(query.id, GL_QUERY_RESULT, &samples); CE();
+                if(samples == 0)
+                    numOccluded++;
+            }
+            query.issued = false;
+        }
+
+        // buffers are regenerated on geometry updates, so queries for chunks that are gone are released
+        if(live.count(it->first) == 0)
+        {
+            glDeleteQueries(1, &query.id); CE();
+            it = queries.erase(it);
+        }
+        else
+            it++;
+    }
+    statChunksOccluded.add(numOccluded);
+}
+
 void Renderer::draw(View * view)
 {
     if (!shadersReady) // not compiled!
@@ -117,12 +238,82 @@ void Renderer::draw(View * view)
 
     glUseProgram(programID); CE();
 
+    // reject chunks outside the frustum and order the remainder front to back, so that occlusion
+    // queries test against as much of the depth buffer as possible
+    std::vector<std::pair<float, int> > order;
+    cgp::Point cop = view->getCOP();
+
+    if(occlusionCulling)
+        collectOcclusionResults();
+    else
+    {
+        // results from before occlusion culling was switched off no longer describe the scene
+        for(std::map<std::pair<GLuint, GLuint>, OcclusionQuery>::iterator it = queries.begin(); it != queries.end(); it++)
+            it->second.issued = false;
+        numOccluded = 0;
+    }
+    numDrawn = numCulled = 0;
     for (int i = 0; i < (int)drawCallData.size(); i++)
     {
+        if(frustumCulling && !inFrustum(drawCallData[i], MVP))
+        {
+            numCulled++;
+            continue;
+        }
+        cgp::Point centre = cgp::Point(0.5f * (drawCallData[i].boundmin[0] + drawCallData[i].boundmax[0]),
+                                       0.5f * (drawCallData[i].boundmin[1] + drawCallData[i].boundmax[1]),
+                                       0.5f * (drawCallData[i].boundmin[2] + drawCallData[i].boundmax[2]));
+        order.push_back(std::make_pair((float) cop.dist(centre), i));
+    }
+
+    if(occlusionCulling)
+    {
+        std::sort(order.begin(), order.end());
+        initOcclusionProxy();
+    }
+
+    for (int c = 0; c < (int)order.size(); c++)
+    {
+        int i = order[c].second;
+        bool conditional = false;
+
         glUniformMatrix4fv(glGetUniformLocation(programID, "MV"), 1, GL_FALSE, glm::value_ptr(MVmx) ); CE();
-        glUniformMatrix4fv(glGetUniformLocation(programID, "MVproj"), 1, GL_FALSE, glm::value_ptr(MVP) ); CE();
         glUniformMatrix3fv(glGetUniformLocation(programID, "normMx"), 1, GL_FALSE, glm::value_ptr(normalMatrix)); CE();
 
+        const GLfloat * bmin = drawCallData[i].boundmin;
+        const GLfloat * bmax = drawCallData[i].boundmax;
+        if(occlusionCulling && bmin[0] <= bmax[0] && !crossesNearPlane(drawCallData[i], MVP))
+        {
+            OcclusionQuery &query = queries[std::make_pair(drawCallData[i].VAO, drawCallData[i].indexOffset)];
+            if(query.id == 0)
+            {
+                glGenQueries(1, &query.id); CE();
+            }
+
+            // rasterize the bounding box into the query without touching colour or depth
+            glm::mat4x4 boxMx = glm::translate(glm::mat4(1.0f), glm::vec3(bmin[0], bmin[1], bmin[2]));
+            boxMx = glm::scale(boxMx, glm::vec3(bmax[0]-bmin[0], bmax[1]-bmin[1], bmax[2]-bmin[2]));
+            boxMx = MVP * boxMx;
+
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); CE();
+            glDepthMask(GL_FALSE); CE();
+            glDisable(GL_CULL_FACE); CE();
+            glUniformMatrix4fv(glGetUniformLocation(programID, "MVproj"), 1, GL_FALSE, glm::value_ptr(boxMx) ); CE();
+            glBeginQuery(GL_SAMPLES_PASSED, query.id); CE();
+            glBindVertexArray(vaoBox); CE();
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)(0)); CE();
+            glEndQuery(GL_SAMPLES_PASSED); CE();
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE); CE();
+            glDepthMask(GL_TRUE); CE();
+            glEnable(GL_CULL_FACE); CE();
+            query.issued = true;
+
+            // the GPU discards the chunk if no box fragment survived, without a round trip to the CPU
+            glBeginConditionalRender(query.id, GL_QUERY_NO_WAIT); CE();
+            conditional = true;
+        }
+        glUniformMatrix4fv(glGetUniformLocation(programID, "MVproj"), 1, GL_FALSE, glm::value_ptr(MVP) ); CE();
+
         glm::vec4 MatDiffuse = glm::vec4(drawCallData[i].diffuse[0], drawCallData[i].diffuse[1],
                                          drawCallData[i].diffuse[2], drawCallData[i].diffuse[3]); // diffuse colour
         glm::vec4 MatAmbient = glm::vec4(drawCallData[i].ambient[0], drawCallData[i].ambient[1],
@@ -143,10 +334,19 @@ void Renderer::draw(View * view)
         glUniform1f(glGetUniformLocation(programID, "shiny"), shinySpec); CE();
 
         glBindVertexArray(drawCallData[i].VAO); CE();
-        glDrawElements(GL_TRIANGLES, drawCallData[i].indexBufSize, GL_UNSIGNED_INT, (void*)(0)); CE();
+        glDrawElements(GL_TRIANGLES, drawCallData[i].indexBufSize, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * drawCallData[i].indexOffset)); CE();
         glBindVertexArray(0); CE();
+
+        if(conditional)
+        {
+            glEndConditionalRender(); CE();
+        }
+        numDrawn++;
     }
     
+    statChunksDrawn.add(numDrawn);
+    statChunksCulled.add(numCulled);
+
     // unbind vao
     glBindVertexArray(0); CE();
 
@@ -17,6 +17,15 @@
 #include <QGLWidget>
 #include "shape.h"
 
+/**
+ * Hardware occlusion query belonging to one chunk, kept across frames so its result can be read without stalling
+ */
+struct OcclusionQuery
+{
+    GLuint id;      ///< query object
+    bool issued;    ///< whether the query was issued in the previous frame
+};
+
 /**
  * Class for managing OpenGL 3.2 rendering
  */
@@ -43,6 +52,40 @@ private:
     std::map<std::string, shaderProgram*> shaders;  ///< available shaders
     std::vector<ShapeDrawData> drawCallData;        ///< drawing state for scene shapes
 
+    bool frustumCulling;            ///< skip chunks whose bounding box lies outside the view frustum
+    bool occlusionCulling;          ///< test chunks against the depth buffer with hardware occlusion queries
+    std::map<std::pair<GLuint, GLuint>, OcclusionQuery> queries; ///< occlusion query per chunk, keyed by VAO and index offset
+    GLuint vaoBox, vboBox, iboBox;  ///< unit cube used as an occlusion proxy for chunk bounding boxes
+    int numDrawn;                   ///< chunks submitted in the last draw() call
+    int numCulled;                  ///< chunks rejected by the frustum test in the last draw() call
+    int numOccluded;                ///< chunks found hidden by occlusion queries of the previous frame
+
+    /**
+     * Test a chunk's world-space bounding box against the view frustum
+     * @param sdd   drawing state for the chunk, including its bounding box
+     * @param mvp   composite model-view-projection matrix
+     * @retval true if the bounding box is at least partially inside the frustum,
+     * @retval false if it is entirely outside one of the frustum planes
+     */
+    bool inFrustum(const ShapeDrawData &sdd, const glm::mat4x4 &mvp);
+
+    /**
+     * Test whether any part of a chunk's bounding box lies in front of the near plane. Such a box is partly
+     * clipped away when rasterized, so an occlusion query on it could wrongly report a visible chunk as hidden.
+     * @param sdd   drawing state for the chunk, including its bounding box
+     * @param mvp   composite model-view-projection matrix
+     * @retval true if at least one corner of the box is nearer than the near plane,
+     * @retval false otherwise
+     */
+    bool crossesNearPlane(const ShapeDrawData &sdd, const glm::mat4x4 &mvp);
+
+    /// Create the unit cube used to rasterize bounding boxes during occlusion queries
+    void initOcclusionProxy();
+
+    /// Gather results of the previous frame's occlusion queries without stalling the pipeline,
+    /// and release queries whose chunks are no longer drawn
+    void collectOcclusionResults();
+
 public:
 
     /// constructor
@@ -144,6 +187,24 @@ public:
         drawCallData = indata;
     }
 
+    /// Enable or disable CPU-side rejection of chunks outside the view frustum (on by default)
+    void setFrustumCulling(bool enable){ frustumCulling = enable; }
+
+    /**
+     * Enable or disable hardware occlusion queries (off by default). Chunks are drawn front to back and each is
+     * conditionally rendered on whether its bounding box passes the depth test against chunks drawn before it.
+     */
+    void setOcclusionCulling(bool enable){ occlusionCulling = enable; }
+
+    /// Number of chunks submitted for drawing in the last draw() call
+    int getChunksDrawn() const { return numDrawn; }
+
+    /// Number of chunks skipped by frustum culling in the last draw() call
+    int getChunksCulled() const { return numCulled; }
+
+    /// Number of chunks reported hidden by the most recently completed occlusion queries
+    int getChunksOccluded() const { return numOccluded; }
+
     /// Initialise render object. Must be called before any other operations to set up and compile shaders
     void initShaders(void);
 
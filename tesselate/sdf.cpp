@@ -0,0 +1,223 @@
+#include "sdf.h"
+#include "bvh.h"
+#include <common/parallel.h>
+#include <common/stats.h>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+typedef SparseGrid<float> FloatGrid;
+
+static stats::Counter statDistanceQueries("sdf.distanceQueries");
+static stats::Histogram statTrianglesPerQuery("sdf.trianglesPerQuery"); ///< point-triangle distances computed per query
+
+void distanceField(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, DistanceGrid &grid,
+                   float voxelsize, float bandwidth, int numthreads)
+{
+    cgp::BoundBox bbox;
+    float pad;
+
+    // pad the bounding box by the band, so that outer samples in the band have non-negative indices
+    for(const cgp::Point &p: verts)
+        bbox.includePnt(p);
+    pad = (voxelsize > 0.0f) ? (ceil(bandwidth / voxelsize) + 1.0f) * voxelsize : 0.0f;
+    grid.origin = cgp::Point(bbox.min.x - pad, bbox.min.y - pad, bbox.min.z - pad);
+    grid.voxelsize = voxelsize;
+    grid.bandwidth = bandwidth;
+    fillDistances(verts, tris, grid, numthreads);
+}
+
+void fillDistances(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, DistanceGrid &grid, int numthreads)
+{
+    const int bs = FloatGrid::bricksize;
+    cgp::BoundBox bbox;
+    vector<cgp::BoundBox> boxes(tris.size());
+    unordered_set<uint64_t> candidates;
+    vector<uint64_t> bricklist;
+    VoxelGrid solid;
+    BVH bvh;
+    float h = grid.voxelsize, bandwidth = grid.bandwidth;
+    int t, a, numchunks;
+
+    grid.dist = FloatGrid(bandwidth);
+    grid.dims[0] = grid.dims[1] = grid.dims[2] = 0;
+    if(tris.empty() || h <= 0.0f || bandwidth <= 0.0f)
+        return;
+
+    // cover the bounding box and the band beyond it
+    for(const cgp::Point &p: verts)
+        bbox.includePnt(p);
+    cgp::Vector extent;
+    extent.diff(grid.origin, bbox.max);
+    grid.dims[0] = (int) ceil((extent.i + bandwidth) / h) + 1;
+    grid.dims[1] = (int) ceil((extent.j + bandwidth) / h) + 1;
+    grid.dims[2] = (int) ceil((extent.k + bandwidth) / h) + 1;
+
+    // inside/outside on the same lattice
+    solid.origin = grid.origin;
+    solid.voxelsize = h;
+    fillVoxels(verts, tris, solid, numthreads);
+
+    // bricks within the band of a triangle: its bounding box dilated by the bandwidth, which covers the wall
+    // thickness of an inset level, and by a further sample so that cubes straddling the band edge are sampled
+    for(t = 0; t < (int) tris.size(); t++)
+    {
+        int lo[3], hi[3];
+        for(int p = 0; p < 3; p++)
+            boxes[t].includePnt(verts[tris[t].v[p]]);
+        float dilate = bandwidth + h;
+        float bmin[3] = {boxes[t].min.x - grid.origin.x - dilate, boxes[t].min.y - grid.origin.y - dilate, boxes[t].min.z - grid.origin.z - dilate};
+        float bmax[3] = {boxes[t].max.x - grid.origin.x + dilate, boxes[t].max.y - grid.origin.y + dilate, boxes[t].max.z - grid.origin.z + dilate};
+        for(a = 0; a < 3; a++)
+        {
+            lo[a] = max(0, (int) floor(bmin[a] / h - 0.5f)) >> FloatGrid::brickbits;
+            hi[a] = min(grid.dims[a] - 1, (int) ceil(bmax[a] / h - 0.5f)) >> FloatGrid::brickbits;
+        }
+        for(int bk = lo[2]; bk <= hi[2]; bk++)
+            for(int bj = lo[1]; bj <= hi[1]; bj++)
+                for(int bi = lo[0]; bi <= hi[0]; bi++)
+                    candidates.insert(FloatGrid::brickKey(bi, bj, bk));
+    }
+    bricklist.assign(candidates.begin(), candidates.end());
+    sort(bricklist.begin(), bricklist.end());
+    bvh.build(boxes);
+
+    // sample the band, each chunk of bricks into a grid of its own
+    numchunks = parallel::numChunks(0, (int) bricklist.size(), numthreads);
+    vector<FloatGrid> partial;
+    for(int c = 0; c < numchunks; c++)
+        partial.emplace_back(bandwidth);
+    parallel::forChunks(0, (int) bricklist.size(), numthreads, [&](int chunk, int first, int last)
+    {
+        const float band2 = bandwidth * bandwidth;
+        cgp::Point closest;
+
+        for(int b = first; b < last; b++)
+        {
+            int bi, bj, bk;
+            FloatGrid::brickCoords(bricklist[b], bi, bj, bk);
+            float * data = partial[chunk].denseBrick(bi, bj, bk);
+            for(int k = 0; k < bs; k++)
+                for(int j = 0; j < bs; j++)
+                    for(int i = 0; i < bs; i++)
+                    {
+                        int vi = bi * bs + i, vj = bj * bs + j, vk = bk * bs + k;
+                        cgp::Point pnt(grid.origin.x + ((float) vi + 0.5f) * h, grid.origin.y + ((float) vj + 0.5f) * h,
+                                       grid.origin.z + ((float) vk + 0.5f) * h);
+                        float best = band2;
+                        int visited = 0;
+
+                        bvh.nearest(pnt, [&](int tri)
+                        {
+                            visited++;
+                            return pointTriSqrDist(pnt, verts[tris[tri].v[0]], verts[tris[tri].v[1]], verts[tris[tri].v[2]], closest);
+                        }, best);
+                        statDistanceQueries.add();
+                        statTrianglesPerQuery.add(visited);
+                        float d = min(sqrt(best), bandwidth);
+                        data[(k * bs + j) * bs + i] = solid.cells.get(vi, vj, vk) ? -d : d;
+                    }
+        }
+    });
+
+    // the interior beyond the band: solid tiles stay tiles, with the sampled bricks in them taking precedence
+    solid.cells.forEachTile([&](int ti, int tj, int tk, unsigned char value)
+    {
+        grid.dist.fillTile(ti, tj, tk, value ? -bandwidth : bandwidth);
+    });
+    for(int c = 0; c < numchunks; c++)
+        grid.dist.merge(partial[c]);
+    solid.cells.forEachBrick([&](int bi, int bj, int bk, const SparseGrid<unsigned char>::Brick &brick)
+    {
+        if(candidates.count(FloatGrid::brickKey(bi, bj, bk)))
+            return;
+        if(!brick.data)
+        {
+            grid.dist.fillBrick(bi, bj, bk, brick.uniform ? -bandwidth : bandwidth);
+            return;
+        }
+        float * data = grid.dist.denseBrick(bi, bj, bk);
+        for(int v = 0; v < FloatGrid::brickvoxels; v++)
+            data[v] = brick.data[v] ? -bandwidth : bandwidth;
+    });
+    grid.dist.compact();
+}
+
+void combineDistances(const DistanceGrid &a, const DistanceGrid &b, BooleanOp op, DistanceGrid &result, int numthreads)
+{
+    const int bs = FloatGrid::bricksize;
+    unordered_set<uint64_t> keys;
+    vector<uint64_t> bricklist;
+    float band = a.bandwidth;
+    int numchunks;
+
+    result.dist = FloatGrid(band);
+    result.origin = a.origin;
+    result.voxelsize = a.voxelsize;
+    result.bandwidth = band;
+    for(int d = 0; d < 3; d++)
+        result.dims[d] = max(a.dims[d], b.dims[d]);
+
+    auto combine = [op](float da, float db)
+    {
+        switch(op)
+        {
+            case BooleanOp::UNION: return min(da, db);
+            case BooleanOp::INTERSECTION: return max(da, db);
+            case BooleanOp::DIFFERENCE: return max(da, -db);
+        }
+        return da;
+    };
+
+    // outside both is outside the result for every operation, so only tiles and allocated bricks need combining,
+    // and tiles combine as a whole
+    unordered_set<uint64_t> tilekeys;
+    auto collectTile = [&tilekeys](int ti, int tj, int tk, float){ tilekeys.insert(FloatGrid::brickKey(ti, tj, tk)); };
+    a.dist.forEachTile(collectTile);
+    b.dist.forEachTile(collectTile);
+    for(uint64_t key: tilekeys)
+    {
+        int ti, tj, tk;
+        FloatGrid::brickCoords(key, ti, tj, tk);
+        int bi = ti << FloatGrid::tilebits, bj = tj << FloatGrid::tilebits, bk = tk << FloatGrid::tilebits;
+        result.dist.fillTile(ti, tj, tk, combine(a.dist.fillValue(bi, bj, bk), b.dist.fillValue(bi, bj, bk)));
+    }
+
+    auto collect = [&keys](int bi, int bj, int bk, const FloatGrid::Brick &){ keys.insert(FloatGrid::brickKey(bi, bj, bk)); };
+    a.dist.forEachBrick(collect);
+    b.dist.forEachBrick(collect);
+    bricklist.assign(keys.begin(), keys.end());
+    sort(bricklist.begin(), bricklist.end());
+
+    numchunks = parallel::numChunks(0, (int) bricklist.size(), numthreads);
+    vector<FloatGrid> partial;
+    for(int c = 0; c < numchunks; c++)
+        partial.emplace_back(band);
+    parallel::forChunks(0, (int) bricklist.size(), numthreads, [&](int chunk, int first, int last)
+    {
+        for(int n = first; n < last; n++)
+        {
+            int bi, bj, bk;
+            FloatGrid::brickCoords(bricklist[n], bi, bj, bk);
+            const FloatGrid::Brick * ba = a.dist.findBrick(bi, bj, bk), * bb = b.dist.findBrick(bi, bj, bk);
+            float fa = a.dist.fillValue(bi, bj, bk), fb = b.dist.fillValue(bi, bj, bk);
+
+            // uniform bricks, such as those deep inside either solid, stay uniform
+            if(!(ba && ba->data) && !(bb && bb->data))
+            {
+                partial[chunk].fillBrick(bi, bj, bk, combine(ba ? ba->uniform : fa, bb ? bb->uniform : fb));
+                continue;
+            }
+            float * data = partial[chunk].denseBrick(bi, bj, bk);
+            for(int k = 0; k < bs; k++)
+                for(int j = 0; j < bs; j++)
+                    for(int i = 0; i < bs; i++)
+                        data[(k * bs + j) * bs + i] = combine(ba ? ba->get(i, j, k) : fa, bb ? bb->get(i, j, k) : fb);
+        }
+    });
+    for(int c = 0; c < numchunks; c++)
+        result.dist.merge(partial[c]);
+    result.dist.compact();
+}
@@ -0,0 +1,62 @@
+#ifndef _sdf_h
+#define _sdf_h
+/**
+ * @file
+ *
+ * Narrow band signed distance fields of closed meshes, for offsetting and hollowing.
+ */
+
+#include "voxel.h"
+
+/**
+ * Signed distance to a mesh, sampled at voxel centres within a narrow band about the surface. Sample (i, j, k)
+ * lies at origin + (i + 0.5, j + 0.5, k + 0.5) * voxelsize. Distances are negative inside the mesh and clamped
+ * to [-bandwidth, bandwidth], so that regions far from the surface are held as uniform bricks: the background
+ * (+bandwidth) outside and -bandwidth inside.
+ */
+struct DistanceGrid
+{
+    SparseGrid<float> dist;     ///< signed distance samples, background +bandwidth
+    cgp::Point origin;          ///< minimum corner of voxel (0, 0, 0)
+    float voxelsize;            ///< spacing between samples
+    int dims[3];                ///< number of samples along x, y and z covering the mesh bounding box and band
+    float bandwidth;            ///< largest distance represented exactly
+};
+
+/**
+ * Compute the signed distance field of a closed mesh within a narrow band. Only bricks within the band of some
+ * triangle are sampled, each sample by a nearest triangle query on a bounding volume hierarchy bounded by the
+ * bandwidth. Bricks are processed in parallel. The sign comes from a solid voxelisation on the same lattice.
+ * @param verts, tris   mesh geometry, which should be closed for the sign to be meaningful
+ * @param[out] grid     distance samples
+ * @param voxelsize     spacing between samples
+ * @param bandwidth     distance from the surface within which samples are exact
+ * @param numthreads    number of threads to use, 0 for one per core
+ */
+void distanceField(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, DistanceGrid &grid,
+                   float voxelsize, float bandwidth, int numthreads = 0);
+
+/**
+ * Compute the signed distance field of a closed mesh on a lattice whose origin, voxel size and bandwidth are
+ * already set, see @a distanceField. Fields sampled on the same lattice can be combined voxel by voxel. The
+ * origin should lie at least the bandwidth below the mesh bounding box, and the grid dimensions are set to
+ * cover the box and band above it.
+ * @param verts, tris   mesh geometry
+ * @param[in,out] grid  grid with origin, voxelsize and bandwidth set on input, receiving distance samples
+ * @param numthreads    number of threads to use, 0 for one per core
+ */
+void fillDistances(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, DistanceGrid &grid,
+                   int numthreads = 0);
+
+/**
+ * Combine two distance fields sampled on the same lattice into the field of a boolean combination of the
+ * solids they bound: the minimum for a union, the maximum for an intersection and the maximum with the
+ * negated second field for a difference. Bricks are combined in parallel.
+ * @param a, b          fields to combine, with matching origin, voxelsize and bandwidth
+ * @param op            combination, a op b
+ * @param[out] result   combined field on the same lattice
+ * @param numthreads    number of threads to use, 0 for one per core
+ */
+void combineDistances(const DistanceGrid &a, const DistanceGrid &b, BooleanOp op, DistanceGrid &result, int numthreads = 0);
+
+#endif
@@ -2,9 +2,24 @@
 #include "shape.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <common/timer.h>
+#include <common/stats.h>
+#include <algorithm>
+#include <utility>
 
 using namespace cgp;
 
+static stats::TimeInit timeBindBuffers("shape.bindBuffers", true); ///< upload of vertex and index buffers to the GPU
+static stats::MemoryAccount memRenderStaging("render.staging");     ///< vertex and index lists built for upload
+static stats::MemoryAccount memGPUBuffers("render.gpu");            ///< vertex and index buffers uploaded to the GPU
+
+static const int chunkTris = 32768; ///< triangles per render chunk, enough to keep draw calls few but small enough to cull
+
+void ShapeGeometry::chargeStaging()
+{
+    staging.set(memRenderStaging, (std::int64_t) (verts.capacity() * sizeof(float) + indices.capacity() * sizeof(unsigned int)));
+}
+
 void ShapeGeometry::setColour(GLfloat * col)
 {
     int i;
@@ -63,6 +78,7 @@ void ShapeGeometry::genCylinder(float radius, float height, int slices, int stac
         base += slices;
         h += stepz;
     }
+    chargeStaging();
 }
 
 void ShapeGeometry::genSphereVert(float radius, float lat, float lon, glm::mat4x4 trm)
@@ -121,6 +137,7 @@ void ShapeGeometry::genSphere(float radius, int slices, int stacks, glm::mat4x4
         }
         base += slices;
     }
+    chargeStaging();
 }
 
 void ShapeGeometry::genMesh(std::vector<cgp::Point> * points, std::vector<cgp::Vector> * norms, std::vector<int> * faces, glm::mat4x4 trm)
@@ -129,6 +146,8 @@ void ShapeGeometry::genMesh(std::vector<cgp::Point> * points, std::vector<cgp::V
     glm::vec4 p;
     glm::vec3 v;
 
+    verts.reserve(verts.size() + 8 * points->size());
+    indices.reserve(indices.size() + faces->size());
     for(i = 0; i < (int) points->size(); i++)
     {
         // apply transformation
@@ -147,28 +166,108 @@ void ShapeGeometry::genMesh(std::vector<cgp::Point> * points, std::vector<cgp::V
     {
         indices.push_back((* faces)[i]);
     }
+    chargeStaging();
 }
 
-ShapeDrawData ShapeGeometry::getDrawParameters()
+void ShapeGeometry::partitionChunks(int maxtris)
 {
-    ShapeDrawData sdd;
-
-    sdd.VAO = vaoGeom;
-    for(int i = 0; i < 4; i++)
-        sdd.diffuse[i] = diffuse[i];
-    for(int i = 0; i < 4; i++)
-        sdd.specular[i] = specular[i];
-    for(int i = 0; i < 4; i++)
-        sdd.ambient[i] = ambient[i];
-    sdd.indexBufSize = (int) indices.size();
-    sdd.texID = 0;
-    sdd.current = false; // default setting
-
-    return sdd;
+    int numtris = (int) indices.size() / 3;
+    std::vector<int> order(numtris);
+    std::vector<Point> centroid(numtris);
+    std::vector<std::pair<int, int> > pending, ranges;
+    std::vector<unsigned int> sorted;
+    int t, p, a;
+
+    for(t = 0; t < numtris; t++)
+    {
+        order[t] = t;
+        centroid[t] = Point(0.0f, 0.0f, 0.0f);
+        for(p = 0; p < 3; p++)
+        {
+            const float * v = &verts[8 * indices[t*3+p]];
+            centroid[t].x += v[0] / 3.0f; centroid[t].y += v[1] / 3.0f; centroid[t].z += v[2] / 3.0f;
+        }
+    }
+
+    // median split along the longest axis of the centroid bounds
+    pending.push_back(std::make_pair(0, numtris));
+    while(!pending.empty())
+    {
+        std::pair<int, int> range = pending.back();
+        pending.pop_back();
+        if(range.second - range.first <= maxtris)
+        {
+            ranges.push_back(range);
+            continue;
+        }
+
+        BoundBox cbox;
+        for(t = range.first; t < range.second; t++)
+            cbox.includePnt(centroid[order[t]]);
+        Vector ext;
+        ext.diff(cbox.min, cbox.max);
+        a = (ext.i >= ext.j && ext.i >= ext.k) ? 0 : ((ext.j >= ext.k) ? 1 : 2);
+
+        int mid = (range.first + range.second) / 2;
+        std::nth_element(order.begin() + range.first, order.begin() + mid, order.begin() + range.second,
+                         [&centroid, a](int x, int y)
+                         {
+                            return (a == 0) ? centroid[x].x < centroid[y].x : ((a == 1) ? centroid[x].y < centroid[y].y : centroid[x].z < centroid[y].z);
+                         });
+        pending.push_back(std::make_pair(range.first, mid));
+        pending.push_back(std::make_pair(mid, range.second));
+    }
+
+    // gather each chunk's triangles into a contiguous run of the index buffer
+    chunks.clear();
+    sorted.reserve(indices.size());
+    for(int r = 0; r < (int) ranges.size(); r++)
+    {
+        ShapeChunk chunk;
+        chunk.first = (GLuint) sorted.size();
+        for(t = ranges[r].first; t < ranges[r].second; t++)
+            for(p = 0; p < 3; p++)
+            {
+                unsigned int ind = indices[order[t]*3+p];
+                const float * v = &verts[8 * ind];
+                sorted.push_back(ind);
+                chunk.bounds.includePnt(Point(v[0], v[1], v[2]));
+            }
+        chunk.count = (GLuint) sorted.size() - chunk.first;
+        chunks.push_back(chunk);
+    }
+    indices.swap(sorted);
+    chargeStaging();
+}
+
+void ShapeGeometry::getDrawParameters(std::vector<ShapeDrawData> &sdds)
+{
+    for(int c = 0; c < (int) chunks.size(); c++)
+    {
+        ShapeDrawData sdd;
+
+        sdd.VAO = vaoGeom;
+        for(int i = 0; i < 4; i++)
+            sdd.diffuse[i] = diffuse[i];
+        for(int i = 0; i < 4; i++)
+            sdd.specular[i] = specular[i];
+        for(int i = 0; i < 4; i++)
+            sdd.ambient[i] = ambient[i];
+        sdd.indexBufSize = chunks[c].count;
+        sdd.indexOffset = chunks[c].first;
+        sdd.texID = 0;
+        sdd.current = false; // default setting
+        const BoundBox &cb = chunks[c].bounds;
+        sdd.boundmin[0] = cb.min.x; sdd.boundmin[1] = cb.min.y; sdd.boundmin[2] = cb.min.z;
+        sdd.boundmax[0] = cb.max.x; sdd.boundmax[1] = cb.max.y; sdd.boundmax[2] = cb.max.z;
+        sdds.push_back(sdd);
+    }
 }
 
 bool ShapeGeometry::bindBuffers(View * view)
 {
+    stats::Span span(timeBindBuffers);
+
     if((int) indices.size() > 0)
     {
         if (vboGeom != 0)
@@ -181,6 +280,8 @@ bool ShapeGeometry::bindBuffers(View * view)
             iboGeom = 0;
         }
 
+        partitionChunks(chunkTris);
+
         // vao
         glGenVertexArrays(1, &vaoGeom);
         glBindVertexArray(vaoGeom);
@@ -195,6 +296,7 @@ bool ShapeGeometry::bindBuffers(View * view)
         glGenBuffers(1, &iboGeom);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboGeom);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*(int) indices.size(), (GLuint *) &indices[0], GL_STATIC_DRAW);
+        gpu.set(memGPUBuffers, (std::int64_t) (sizeof(GLfloat) * verts.size() + sizeof(GLuint) * indices.size()));
 
         // enable position attribute
         glEnableVertexAttribArray(0);
@@ -7,6 +7,7 @@
  */
 
 #include "view.h"
+#include <common/stats.h>
 
 /**
  * Container for rendering properties, primarily colour
@@ -18,8 +19,21 @@ struct ShapeDrawData
     GLfloat specular[4];    ///< specular colour
     GLfloat ambient[4];     ///< ambient colour
     GLuint indexBufSize;    ///< index buffer size - as required by DrawElements
+    GLuint indexOffset;     ///< position of the first index in the buffer, so that chunks can share one buffer
     bool   current;         ///< set to true is this is part of current manipulator
     GLuint texID;           ///< texture ID
+    GLfloat boundmin[3];    ///< minimum corner of world-space bounding box, used for culling
+    GLfloat boundmax[3];    ///< maximum corner of world-space bounding box, used for culling
+};
+
+/**
+ * Contiguous run of the index buffer holding a spatially compact group of triangles, which is culled as a unit
+ */
+struct ShapeChunk
+{
+    GLuint first;           ///< position of the first index in the buffer
+    GLuint count;           ///< number of indices
+    cgp::BoundBox bounds;   ///< world-space bounds of the chunk's triangles
 };
 
 /**
@@ -32,6 +46,19 @@ private:
     std::vector<unsigned int> indices;      ///< vertex indices for triangles
     GLuint vaoGeom, vboGeom, iboGeom;       ///< openGL handle for various buffers
     GLfloat diffuse[4], ambient[4], specular[4]; ///< material properties
+    std::vector<ShapeChunk> chunks;         ///< spatial partition of indices, set up by bindBuffers
+    stats::MemoryCharge staging;            ///< bytes of verts and indices
+    stats::MemoryCharge gpu;                ///< bytes of the buffers last uploaded by bindBuffers
+
+    /// Update the bytes charged for the capacity of verts and indices
+    void chargeStaging();
+
+    /**
+     * Reorder the triangles in indices so that each spatial chunk occupies a contiguous range, by splitting
+     * at the median centroid along the longest axis until no chunk exceeds maxtris triangles
+     * @param maxtris   upper bound on triangles per chunk
+     */
+    void partitionChunks(int maxtris);
 
     /**
      * Create a sphere vertex at specified integer latitude and longitude with a transformation matrix applied and append to existing geometry
@@ -66,6 +93,8 @@ public:
     {
         verts.clear();
         indices.clear();
+        chunks.clear();
+        chargeStaging(); // clearing keeps the capacity
     }
 
     /// Getter for shape colour
@@ -103,13 +132,14 @@ public:
     void genMesh(std::vector<cgp::Point> * points, std::vector<cgp::Vector> * norms, std::vector<int> * faces, glm::mat4x4 trm);
 
     /**
-     * Return data required for a draw call, such as the VAO, colour, etc.
+     * Append data required for draw calls, such as the VAO, colour, etc., with one entry per spatial chunk
+     * @param[out] sdds  drawing state for each chunk, appended to any existing entries
      */
-    ShapeDrawData getDrawParameters();
+    void getDrawParameters(std::vector<ShapeDrawData> &sdds);
 
     /**
      * Bind the appropriate OpenGL buffers for rendering the constraint shape. Only needs to be done if
-     * the shape changes.
+     * the shape changes. Triangles are regrouped into spatial chunks for culling before upload.
      * @param view      current viewpoint
      * @retval true if buffers successfully bound
      */
@@ -0,0 +1,198 @@
+/**
+ * @file
+ *
+ * Batch thumbnail generation. Renders every input mesh from a ring of viewpoints into image files using
+ * an offscreen OpenGL context, so that it can run on machines without a display server.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <boost/program_options.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include "headless.h"
+#include "renderer.h"
+#include "mesh.h"
+#include "view.h"
+#include <common/timer.h>
+#include <common/stats.h>
+#include <common/parallel.h>
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+/// Settings shared by all rendering threads
+struct ThumbnailOptions
+{
+    std::vector<std::string> meshes;    ///< STL files to render
+    std::string outdir;                 ///< directory receiving the images
+    std::string format;                 ///< image file extension, which selects the format
+    int views;                          ///< number of viewpoints per mesh, evenly spaced in azimuth
+    int size;                           ///< width and height of each image in pixels
+    float elevation;                    ///< camera elevation above the horizontal in degrees
+};
+
+/**
+ * Render meshes claimed from a shared counter until none remain. Each thread owns its own context and
+ * renderer, so the only shared state is the job counter and the failure count.
+ * @param opts          rendering settings
+ * @param claim         returns the index of the next unclaimed mesh, or -1 when none remain
+ * @param failures      number of meshes that could not be loaded or rendered
+ */
+static void renderWorker(const ThumbnailOptions &opts, const std::function<int()> &claim, std::atomic<int> &failures)
+{
+    HeadlessCanvas canvas;
+    std::vector<ShapeDrawData> sdds;
+    int i, m;
+
+    if(!canvas.init(opts.size, opts.size))
+    {
+        // leave the remaining jobs to threads that did manage to create a context, meshes that no thread
+        // could take are counted once by the caller
+        std::cerr << "Error renderWorker: unable to create an offscreen context" << std::endl;
+        return;
+    }
+
+    // same lighting setup as the interactive viewer
+    Renderer renderer(NULL, ".");
+    cgp::Vector dl = cgp::Vector(0.6f, 1.0f, 0.6f);
+    dl.normalize();
+    renderer.setPointLight(0.5f, 5.0f, 7.0f);
+    renderer.setDirectionalLight(0, dl.i, dl.j, dl.k);
+    renderer.setDirectionalLight(1, -dl.i, dl.j, -dl.k);
+    renderer.initShaders();
+
+    while((i = claim()) >= 0)
+    {
+        Mesh mesh;
+        View view;
+
+        if(!mesh.readSTL(opts.meshes[i], ValidationPolicy::OFF)) // rendering does not depend on validity
+        {
+            failures++;
+            continue;
+        }
+        mesh.boxFit(10.0f);
+
+        // geometry is independent of the viewpoint, so upload it once per mesh
+        view.setForcedFocus(cgp::Point(0.0f, 0.0f, 0.0f));
+        view.setViewScale(1.0f);
+        view.setDim(0.0f, 0.0f, (float) opts.size, (float) opts.size);
+        canvas.makeCurrent();
+        sdds.clear();
+        if(!mesh.genGeometry(&view, sdds))
+        {
+            std::cerr << "Error renderWorker: no renderable geometry in " << opts.meshes[i] << std::endl;
+            failures++;
+            continue;
+        }
+        renderer.setDrawParams(sdds);
+
+        bool saved = true;
+        for(m = 0; m < opts.views; m++)
+        {
+            std::ostringstream name;
+
+            view.setOrbit((float) m * PI2 / (float) opts.views, opts.elevation * DEG2RAD);
+            renderer.draw(&view);
+            glFinish();
+
+            name << fs::path(opts.meshes[i]).stem().string() << "_" << m << "." << opts.format;
+            if(!canvas.saveImage((fs::path(opts.outdir) / name.str()).string()))
+                saved = false;
+        }
+        if(!saved) // a mesh counts as one failure however many of its views were lost
+            failures++;
+    }
+}
+
+static po::variables_map processOptions(int argc, const char **argv)
+{
+    po::options_description desc("Options");
+    desc.add_options()
+        ("help",                                                            "Show help")
+        ("output,o",    po::value<std::string>()->default_value("."),       "Directory for output images")
+        ("views,v",     po::value<int>()->default_value(8),                 "Viewpoints per mesh")
+        ("size,s",      po::value<int>()->default_value(256),               "Image width and height in pixels")
+        ("elevation",   po::value<float>()->default_value(30.0f),           "Camera elevation in degrees")
+        ("format",      po::value<std::string>()->default_value("png"),     "Image format (file extension)")
+        ("threads,j",   po::value<int>()->default_value(0),                 "Rendering threads (0 for one per core)")
+        ("stats",                                                           "Report counts of mesh processing events and memory use")
+        ("memory-budget", po::value<long>()->default_value(0),              "Refuse to load meshes that would take memory use over this many MB (0 for no limit)")
+        ("times",                                                           "Report total time in each phase of loading and rendering")
+        ("trace",       po::value<std::string>(),                           "Write a Chrome trace (chrome://tracing) of each phase to a file");
+
+    po::options_description hidden;
+    hidden.add_options()
+        ("mesh", po::value<std::vector<std::string> >()->composing(), "STL files");
+    po::options_description all;
+    all.add(desc).add(hidden);
+    po::positional_options_description positional;
+    positional.add("mesh", -1);
+
+    try
+    {
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv)
+                  .style(po::command_line_style::default_style & ~po::command_line_style::allow_guessing)
+                  .options(all)
+                  .positional(positional)
+                  .run(), vm);
+        po::notify(vm);
+
+        if (vm.count("help") || !vm.count("mesh"))
+        {
+            std::cout << "Usage: " << argv[0] << " [options] mesh.stl...\n\n" << desc << '\n';
+            exit(vm.count("help") ? 0 : 1);
+        }
+        return vm;
+    }
+    catch (po::error &e)
+    {
+        std::cerr << e.what() << "\n\n" << desc << '\n';
+        std::exit(1);
+    }
+}
+
+int main(int argc, const char **argv)
+{
+    po::variables_map vm = processOptions(argc, argv);
+    ThumbnailOptions opts;
+    std::atomic<int> failures(0);
+    int numthreads;
+
+    opts.meshes = vm["mesh"].as<std::vector<std::string> >();
+    opts.outdir = vm["output"].as<std::string>();
+    opts.format = vm["format"].as<std::string>();
+    opts.views = std::max(1, vm["views"].as<int>());
+    opts.size = std::max(1, vm["size"].as<int>());
+    opts.elevation = vm["elevation"].as<float>();
+    fs::create_directories(fs::path(opts.outdir));
+    stats::enableStats(vm.count("stats") > 0);
+    stats::setMemoryBudget((std::int64_t) vm["memory-budget"].as<long>() << 20);
+    stats::enableTimers(vm.count("times") > 0);
+    stats::enableTracing(vm.count("trace") > 0);
+
+    numthreads = vm["threads"].as<int>();
+    failures += parallel::forClaims((int) opts.meshes.size(), numthreads, [&opts, &failures] (const std::function<int()> &claim)
+                                    {
+                                        renderWorker(opts, claim, failures);
+                                    });
+
+    stats::reportStats();
+    if(vm.count("times"))
+        stats::reportTimes();
+    if(vm.count("trace") && !stats::writeTrace(vm["trace"].as<std::string>()))
+        std::cerr << "Error thumbnail: unable to write trace " << vm["trace"].as<std::string>() << std::endl;
+
+    if(failures > 0)
+        std::cerr << failures << " thumbnail(s) failed" << std::endl;
+    return (failures > 0) ? 1 : 0;
+}
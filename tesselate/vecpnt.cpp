@@ -1,6 +1,9 @@
 #include "vecpnt.h"
 #include <stdio.h>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 using namespace std;
 using namespace cgp;
@@ -36,3 +39,300 @@ void clamp(float & t)
     if(t < 0.0f)
         t = 0.0f;
 }
+
+// Orientation predicates are exact for single precision input held in doubles: a floating point filter
+// settles almost every case, and the rest are summed exactly as an expansion of non-overlapping doubles
+// [Shewchuk 1997]. Products of two floats are exact in double, and std::fma recovers the rounding error of a third.
+
+static const double halfulp = std::numeric_limits<double>::epsilon() * 0.5;
+static const double o3dErrBound = (7.0 + 56.0 * halfulp) * halfulp;
+static const double o2dErrBound = (3.0 + 16.0 * halfulp) * halfulp;
+
+// growExpansion: add <b> exactly to expansion <e> of length <n>, dropping zero components
+static void growExpansion(double * e, int &n, double b)
+{
+    int i, m = 0;
+    double q = b, x, bv, av;
+
+    for(i = 0; i < n; i++)
+    {
+        // two-sum: x + rounding error is exactly q + e[i]
+        x = q + e[i];
+        bv = x - q;
+        av = x - bv;
+        double err = (q - av) + (e[i] - bv);
+        q = x;
+        if(err != 0.0)
+            e[m++] = err;
+    }
+    if(q != 0.0 || m == 0)
+        e[m++] = q;
+    n = m;
+}
+
+// addProduct: add <sign> * u * v * w exactly to expansion <e> of length <n>, for single precision factors
+static void addProduct(double * e, int &n, double sign, double u, double v, double w)
+{
+    double p = sign * u * v;
+    double hi = p * w;
+
+    growExpansion(e, n, hi);
+    growExpansion(e, n, std::fma(p, w, -hi));
+}
+
+// addDet: add <sign> times the determinant of rows <a,b,c> exactly to expansion <e> of length <n>
+static void addDet(double * e, int &n, double sign, const double a[3], const double b[3], const double c[3])
+{
+    addProduct(e, n, sign, a[0], b[1], c[2]);
+    addProduct(e, n, -sign, a[0], b[2], c[1]);
+    addProduct(e, n, -sign, a[1], b[0], c[2]);
+    addProduct(e, n, sign, a[1], b[2], c[0]);
+    addProduct(e, n, sign, a[2], b[0], c[1]);
+    addProduct(e, n, -sign, a[2], b[1], c[0]);
+}
+
+// orient3d: volume of tetrahedron <a,b,c,d>, or a value of the same sign, positive if d lies on the side of
+//           plane <a,b,c> that its counter-clockwise normal points to and exactly zero if the points are coplanar
+static double orient3d(const double a[3], const double b[3], const double c[3], const double d[3])
+{
+    double ax = a[0]-d[0], ay = a[1]-d[1], az = a[2]-d[2];
+    double bx = b[0]-d[0], by = b[1]-d[1], bz = b[2]-d[2];
+    double cx = c[0]-d[0], cy = c[1]-d[1], cz = c[2]-d[2];
+    double det, permanent, e[49];
+    int n = 0;
+
+    det = ax * (by * cz - bz * cy) - ay * (bx * cz - bz * cx) + az * (bx * cy - by * cx);
+    permanent = fabs(ax) * (fabs(by * cz) + fabs(bz * cy)) + fabs(ay) * (fabs(bx * cz) + fabs(bz * cx))
+              + fabs(az) * (fabs(bx * cy) + fabs(by * cx));
+    if(fabs(det) > o3dErrBound * permanent)
+        return det;
+
+    // det(a-d, b-d, c-d) is multilinear, and every term with two copies of d vanishes
+    addDet(e, n, 1.0, a, b, c);
+    addDet(e, n, -1.0, d, b, c);
+    addDet(e, n, -1.0, a, d, c);
+    addDet(e, n, -1.0, a, b, d);
+    return e[n-1]; // the largest component carries the sign
+}
+
+// orient2d: twice the signed area of triangle <a,b,c> in the plane, or a value of the same sign, which is
+//           exactly zero if the points are collinear
+static double orient2d(const double a[2], const double b[2], const double c[2])
+{
+    double left = (a[0]-c[0]) * (b[1]-c[1]), right = (a[1]-c[1]) * (b[0]-c[0]);
+    double det = left - right, e[7];
+    int n = 0;
+
+    if(fabs(det) > o2dErrBound * (fabs(left) + fabs(right)))
+        return det;
+
+    growExpansion(e, n, a[0] * b[1]);
+    growExpansion(e, n, -a[0] * c[1]);
+    growExpansion(e, n, -c[0] * b[1]);
+    growExpansion(e, n, -a[1] * b[0]);
+    growExpansion(e, n, a[1] * c[0]);
+    growExpansion(e, n, c[1] * b[0]);
+    return e[n-1];
+}
+
+// segSegIntersect2d: test whether closed segments <a,b> and <c,d> intersect in the plane
+static bool segSegIntersect2d(const double a[2], const double b[2], const double c[2], const double d[2])
+{
+    double d1 = orient2d(c, d, a), d2 = orient2d(c, d, b), d3 = orient2d(a, b, c), d4 = orient2d(a, b, d);
+
+    if(((d1 > 0.0 && d2 < 0.0) || (d1 < 0.0 && d2 > 0.0)) && ((d3 > 0.0 && d4 < 0.0) || (d3 < 0.0 && d4 > 0.0)))
+        return true;
+
+    // collinear touching cases
+    auto onSeg = [](const double p[2], const double q[2], const double r[2])
+    {
+        return std::min(p[0], q[0]) <= r[0] && r[0] <= std::max(p[0], q[0])
+            && std::min(p[1], q[1]) <= r[1] && r[1] <= std::max(p[1], q[1]);
+    };
+    return (d1 == 0.0 && onSeg(c, d, a)) || (d2 == 0.0 && onSeg(c, d, b))
+        || (d3 == 0.0 && onSeg(a, b, c)) || (d4 == 0.0 && onSeg(a, b, d));
+}
+
+// pointInTri2d: test whether point <p> lies in the closed triangle <a,b,c> in the plane
+static bool pointInTri2d(const double p[2], const double a[2], const double b[2], const double c[2])
+{
+    double d1 = orient2d(a, b, p), d2 = orient2d(b, c, p), d3 = orient2d(c, a, p);
+
+    return !((d1 < 0.0 || d2 < 0.0 || d3 < 0.0) && (d1 > 0.0 || d2 > 0.0 || d3 > 0.0));
+}
+
+// segTriCross: test whether closed segment <a,b> crosses or touches triangle <t0,t1,t2>, which it is not coplanar with
+static bool segTriCross(const double a[3], const double b[3], const double t0[3], const double t1[3], const double t2[3])
+{
+    double sa = orient3d(t0, t1, t2, a), sb = orient3d(t0, t1, t2, b);
+
+    // both endpoints strictly on one side, or the segment lies in the plane (handled as coplanar elsewhere)
+    if((sa > 0.0 && sb > 0.0) || (sa < 0.0 && sb < 0.0) || (sa == 0.0 && sb == 0.0))
+        return false;
+
+    // the segment crosses the plane: it hits the triangle if it passes on the inside of all three edges
+    double e0 = orient3d(a, b, t0, t1), e1 = orient3d(a, b, t1, t2), e2 = orient3d(a, b, t2, t0);
+    return (e0 >= 0.0 && e1 >= 0.0 && e2 >= 0.0) || (e0 <= 0.0 && e1 <= 0.0 && e2 <= 0.0);
+}
+
+// projectionAxes: find the coordinate plane <ax0,ax1> most perpendicular to the normal of triangle <a,b,c>, keeping
+//                 its orientation. Returns false if the triangle is degenerate.
+static bool projectionAxes(const double a[3], const double b[3], const double c[3], int &ax0, int &ax1)
+{
+    double n[3];
+
+    n[0] = (b[1]-a[1]) * (c[2]-a[2]) - (b[2]-a[2]) * (c[1]-a[1]);
+    n[1] = (b[2]-a[2]) * (c[0]-a[0]) - (b[0]-a[0]) * (c[2]-a[2]);
+    n[2] = (b[0]-a[0]) * (c[1]-a[1]) - (b[1]-a[1]) * (c[0]-a[0]);
+    if(n[0] == 0.0 && n[1] == 0.0 && n[2] == 0.0)
+        return false;
+    if(fabs(n[0]) >= fabs(n[1]) && fabs(n[0]) >= fabs(n[2]))
+        { ax0 = 1; ax1 = 2; }
+    else if(fabs(n[1]) >= fabs(n[2]))
+        { ax0 = 2; ax1 = 0; }
+    else
+        { ax0 = 0; ax1 = 1; }
+    return true;
+}
+
+bool triTriIntersect(cgp::Point p0, cgp::Point p1, cgp::Point p2, cgp::Point q0, cgp::Point q1, cgp::Point q2)
+{
+    double p[3][3] = {{p0.x, p0.y, p0.z}, {p1.x, p1.y, p1.z}, {p2.x, p2.y, p2.z}};
+    double q[3][3] = {{q0.x, q0.y, q0.z}, {q1.x, q1.y, q1.z}, {q2.x, q2.y, q2.z}};
+    double sq[3], sp[3];
+    int i, j, ax0, ax1;
+
+    // signed distances of each triangle's vertices from the other's plane, so disjoint sides exit early
+    for(i = 0; i < 3; i++)
+        sq[i] = orient3d(p[0], p[1], p[2], q[i]);
+    if((sq[0] > 0.0 && sq[1] > 0.0 && sq[2] > 0.0) || (sq[0] < 0.0 && sq[1] < 0.0 && sq[2] < 0.0))
+        return false;
+    for(i = 0; i < 3; i++)
+        sp[i] = orient3d(q[0], q[1], q[2], p[i]);
+    if((sp[0] > 0.0 && sp[1] > 0.0 && sp[2] > 0.0) || (sp[0] < 0.0 && sp[1] < 0.0 && sp[2] < 0.0))
+        return false;
+
+    if(sq[0] != 0.0 || sq[1] != 0.0 || sq[2] != 0.0)
+    {
+        // the intersection of non-coplanar triangles is a segment ending on an edge of one of them
+        for(i = 0; i < 3; i++)
+            if(segTriCross(p[i], p[(i+1)%3], q[0], q[1], q[2]) || segTriCross(q[i], q[(i+1)%3], p[0], p[1], p[2]))
+                return true;
+        return false;
+    }
+
+    // coplanar: project onto the plane most perpendicular to the normal and test in 2D
+    if(!projectionAxes(p[0], p[1], p[2], ax0, ax1)) // degenerate
+        return false;
+
+    double p2d[3][2], q2d[3][2];
+    for(i = 0; i < 3; i++)
+    {
+        p2d[i][0] = p[i][ax0]; p2d[i][1] = p[i][ax1];
+        q2d[i][0] = q[i][ax0]; q2d[i][1] = q[i][ax1];
+    }
+    for(i = 0; i < 3; i++)
+        for(j = 0; j < 3; j++)
+            if(segSegIntersect2d(p2d[i], p2d[(i+1)%3], q2d[j], q2d[(j+1)%3]))
+                return true;
+    return pointInTri2d(p2d[0], q2d[0], q2d[1], q2d[2]) || pointInTri2d(q2d[0], p2d[0], p2d[1], p2d[2]);
+}
+
+bool segTriIntersect(cgp::Point a, cgp::Point b, cgp::Point t0, cgp::Point t1, cgp::Point t2)
+{
+    double s[2][3] = {{a.x, a.y, a.z}, {b.x, b.y, b.z}};
+    double t[3][3] = {{t0.x, t0.y, t0.z}, {t1.x, t1.y, t1.z}, {t2.x, t2.y, t2.z}};
+    double s2d[2][2], t2d[3][2];
+    int i, ax0, ax1;
+
+    if(orient3d(t[0], t[1], t[2], s[0]) != 0.0 || orient3d(t[0], t[1], t[2], s[1]) != 0.0)
+        return segTriCross(s[0], s[1], t[0], t[1], t[2]);
+
+    // the segment lies in the plane of the triangle
+    if(!projectionAxes(t[0], t[1], t[2], ax0, ax1))
+        return false;
+    for(i = 0; i < 2; i++)
+        { s2d[i][0] = s[i][ax0]; s2d[i][1] = s[i][ax1]; }
+    for(i = 0; i < 3; i++)
+        { t2d[i][0] = t[i][ax0]; t2d[i][1] = t[i][ax1]; }
+    for(i = 0; i < 3; i++)
+        if(segSegIntersect2d(s2d[0], s2d[1], t2d[i], t2d[(i+1)%3]))
+            return true;
+    return pointInTri2d(s2d[0], t2d[0], t2d[1], t2d[2]);
+}
+
+bool foldedOver(cgp::Point e0, cgp::Point e1, cgp::Point p, cgp::Point q)
+{
+    double e[2][3] = {{e0.x, e0.y, e0.z}, {e1.x, e1.y, e1.z}};
+    double a[3] = {p.x, p.y, p.z}, b[3] = {q.x, q.y, q.z};
+    double e2d[2][2], a2d[2], b2d[2], sa, sb;
+    int i, ax0, ax1;
+
+    if(orient3d(e[0], e[1], a, b) != 0.0 || !projectionAxes(e[0], e[1], a, ax0, ax1))
+        return false;
+    for(i = 0; i < 2; i++)
+        { e2d[i][0] = e[i][ax0]; e2d[i][1] = e[i][ax1]; }
+    a2d[0] = a[ax0]; a2d[1] = a[ax1];
+    b2d[0] = b[ax0]; b2d[1] = b[ax1];
+    sa = orient2d(e2d[0], e2d[1], a2d);
+    sb = orient2d(e2d[0], e2d[1], b2d);
+    return (sa > 0.0 && sb > 0.0) || (sa < 0.0 && sb < 0.0);
+}
+
+float pointTriSqrDist(const cgp::Point &p, const cgp::Point &a, const cgp::Point &b, const cgp::Point &c, cgp::Point &closest)
+{
+    // Voronoi region classification (Ericson, Real-Time Collision Detection, 5.1.5)
+    Vector ab, ac, ap, bp, cp, d;
+    float d1, d2, d3, d4, d5, d6, va, vb, vc, v, w, denom;
+
+    ab.diff(a, b); ac.diff(a, c); ap.diff(a, p);
+    d1 = ab.dot(ap); d2 = ac.dot(ap);
+    if(d1 <= 0.0f && d2 <= 0.0f)
+        closest = a;
+    else
+    {
+        bp.diff(b, p);
+        d3 = ab.dot(bp); d4 = ac.dot(bp);
+        cp.diff(c, p);
+        d5 = ab.dot(cp); d6 = ac.dot(cp);
+        vc = d1 * d4 - d3 * d2;
+        vb = d5 * d2 - d1 * d6;
+        va = d3 * d6 - d5 * d4;
+        if(d3 >= 0.0f && d4 <= d3)
+            closest = b;
+        else if(d6 >= 0.0f && d5 <= d6)
+            closest = c;
+        else if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) // edge ab
+        {
+            v = d1 / (d1 - d3);
+            closest = Point(a.x + v * ab.i, a.y + v * ab.j, a.z + v * ab.k);
+        }
+        else if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) // edge ac
+        {
+            w = d2 / (d2 - d6);
+            closest = Point(a.x + w * ac.i, a.y + w * ac.j, a.z + w * ac.k);
+        }
+        else if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) // edge bc
+        {
+            w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            closest = Point(b.x + w * (c.x - b.x), b.y + w * (c.y - b.y), b.z + w * (c.z - b.z));
+        }
+        else // face interior
+        {
+            denom = 1.0f / (va + vb + vc);
+            v = vb * denom; w = vc * denom;
+            closest = Point(a.x + ab.i * v + ac.i * w, a.y + ab.j * v + ac.j * w, a.z + ab.k * v + ac.k * w);
+        }
+    }
+    d.diff(p, closest);
+    return d.sqrdlength();
+}
+
+float pointBoxSqrDist(const cgp::Point &p, const cgp::BoundBox &box)
+{
+    float dx = std::max(0.0f, std::max(box.min.x - p.x, p.x - box.max.x));
+    float dy = std::max(0.0f, std::max(box.min.y - p.y, p.y - box.max.y));
+    float dz = std::max(0.0f, std::max(box.min.z - p.z, p.z - box.max.z));
+
+    return dx * dx + dy * dy + dz * dz;
+}
@@ -99,7 +99,7 @@ public:
     }
 
     /// Test the equality of two points within a given tolerance
-    inline bool operator == (Point p)
+    inline bool operator == (Point p) const
     { float dx, dy, dz;
       dx = x - p.x;
       dy = y - p.y;
@@ -357,7 +357,7 @@ public:
     }
 
     /// Return the length of the diagonal of the bounding box
-    inline float diagLen()
+    inline float diagLen() const
     {
         Vector diag;
 
@@ -407,4 +407,23 @@ void rayPointDist(cgp::Point start, cgp::Vector dirn, cgp::Point query, float &t
 
 // clamp: ensure that parameter <t> falls in [0,1]
 void clamp(float & t);
+
+// triTriIntersect: Test whether triangle <p0,p1,p2> intersects triangle <q0,q1,q2>, including touching contact and
+//                  overlap of coplanar triangles. Degenerate triangles never intersect. Uses exact orientation predicates.
+bool triTriIntersect(cgp::Point p0, cgp::Point p1, cgp::Point p2, cgp::Point q0, cgp::Point q1, cgp::Point q2);
+
+// segTriIntersect: Test whether closed segment <a,b> intersects triangle <t0,t1,t2>, including touching contact and
+//                  segments lying in the plane of the triangle. Uses exact orientation predicates.
+bool segTriIntersect(cgp::Point a, cgp::Point b, cgp::Point t0, cgp::Point t1, cgp::Point t2);
+
+// foldedOver: Test whether triangles <e0,e1,p> and <e1,e0,q>, which share edge <e0,e1>, are coplanar with <p> and <q>
+//             strictly on the same side of the edge, so that one is folded flat over the other. Uses exact predicates.
+bool foldedOver(cgp::Point e0, cgp::Point e1, cgp::Point p, cgp::Point q);
+
+// pointTriSqrDist: Return the squared distance from point <p> to the closest point of triangle <a,b,c>, which is
+//                  returned in <closest>.
+float pointTriSqrDist(const cgp::Point &p, const cgp::Point &a, const cgp::Point &b, const cgp::Point &c, cgp::Point &closest);
+
+// pointBoxSqrDist: Return the squared distance from point <p> to the closest point of bounding box <box>, zero if inside.
+float pointBoxSqrDist(const cgp::Point &p, const cgp::BoundBox &box);
 #endif
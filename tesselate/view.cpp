@@ -402,6 +402,18 @@ bool View::spin()
     return false;
 }
 
+void View::setOrbit(float azimuth, float elevation)
+{
+    float a[3];
+
+    a[0] = 0.0f; a[1] = 1.0f; a[2] = 0.0f;
+    axis_to_quat(a, azimuth, curquat);
+    a[0] = 1.0f; a[1] = 0.0f; a[2] = 0.0f;
+    axis_to_quat(a, elevation, lastquat);
+    add_quats(lastquat, curquat, curquat);
+    updateDir();
+}
+
 bool View::save(const char * filename)
 {
     ofstream outfile;
@@ -208,6 +208,13 @@ public:
 
     /// Rotate the view around the focal point over a number of frames. Returns true if spin is active
     bool spin();
+
+    /**
+     * Place the viewpoint on an orbit around the focal point, as used for rendering fixed camera positions
+     * @param azimuth   rotation in radians about the vertical axis
+     * @param elevation tilt in radians about the horizontal axis, applied after the azimuth
+     */
+    void setOrbit(float azimuth, float elevation);
     
     /// Save the current view to the file named @a filename
     ///              return true if operation is successful, otherwise false
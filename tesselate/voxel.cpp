@@ -0,0 +1,445 @@
+#include "voxel.h"
+#include <common/parallel.h>
+#include <common/flat_map.h>
+#include <atomic>
+#include <array>
+#include <cstring>
+#include <unordered_set>
+
+using namespace std;
+
+typedef SparseGrid<unsigned char> CellGrid;
+
+/**
+ * Edge function of point (sx, sy) against directed 2D edge p->q, positive if the point lies to the left. It is
+ * evaluated from the lesser endpoint, so that the two triangles sharing an edge get exactly opposite values and
+ * a sample on the edge falls to exactly one of them.
+ */
+static inline double edgeFunction(double px, double py, double qx, double qy, double sx, double sy)
+{
+    if(qx < px || (qx == px && qy < py))
+        return -((px - qx) * (sy - qy) - (py - qy) * (sx - qx));
+    return (qx - px) * (sy - py) - (qy - py) * (sx - px);
+}
+
+/// Top-left fill rule for an edge of a counter-clockwise triangle, so that samples on shared edges count once
+static inline bool topLeft(double px, double py, double qx, double qy)
+{
+    return (py == qy && qx < px) || (qy < py);
+}
+
+/**
+ * Find where the vertical ray through (x, y) crosses a triangle
+ * @param p         triangle vertices
+ * @param x, y      ray position
+ * @param[out] z    height of the crossing
+ * @retval true if the ray crosses the triangle
+ */
+static bool columnCrossing(const cgp::Point * p[3], double x, double y, double &z)
+{
+    int b = 1, c = 2;
+    double area = edgeFunction(p[0]->x, p[0]->y, p[1]->x, p[1]->y, p[2]->x, p[2]->y);
+
+    if(area == 0.0) // edge-on to the ray
+        return false;
+    if(area < 0.0)
+        std::swap(b, c);
+
+    const cgp::Point &pa = * p[0], &pb = * p[b], &pc = * p[c];
+    double wa = edgeFunction(pb.x, pb.y, pc.x, pc.y, x, y);
+    double wb = edgeFunction(pc.x, pc.y, pa.x, pa.y, x, y);
+    double wc = edgeFunction(pa.x, pa.y, pb.x, pb.y, x, y);
+
+    if(wa < 0.0 || (wa == 0.0 && !topLeft(pb.x, pb.y, pc.x, pc.y)))
+        return false;
+    if(wb < 0.0 || (wb == 0.0 && !topLeft(pc.x, pc.y, pa.x, pa.y)))
+        return false;
+    if(wc < 0.0 || (wc == 0.0 && !topLeft(pa.x, pa.y, pb.x, pb.y)))
+        return false;
+    z = (wa * pa.z + wb * pb.z + wc * pc.z) / (wa + wb + wc);
+    return true;
+}
+
+bool pointInside(const cgp::Point &pnt, const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris)
+{
+    const cgp::Point * p[3];
+    double z;
+    bool inside = false;
+
+    for(const Triangle &tri: tris)
+    {
+        for(int c = 0; c < 3; c++)
+            p[c] = &verts[tri.v[c]];
+        if(columnCrossing(p, pnt.x, pnt.y, z) && z > pnt.z)
+            inside = !inside;
+    }
+    return inside;
+}
+
+void voxelise(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, VoxelGrid &grid,
+              int resolution, int numthreads)
+{
+    cgp::BoundBox bbox;
+    cgp::Vector extent;
+
+    for(const cgp::Point &p: verts)
+        bbox.includePnt(p);
+    extent = bbox.getDiag();
+    grid.origin = bbox.min;
+    grid.voxelsize = (resolution > 0 && !verts.empty()) ? max(extent.i, max(extent.j, extent.k)) / (float) resolution : 0.0f;
+    fillVoxels(verts, tris, grid, numthreads);
+}
+
+void fillVoxels(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, VoxelGrid &grid, int numthreads)
+{
+    const int bs = CellGrid::bricksize;
+    cgp::BoundBox bbox;
+    cgp::Vector extent;
+    float h = grid.voxelsize;
+    int a, t, numbands;
+
+    grid.cells = CellGrid(0);
+    grid.dims[0] = grid.dims[1] = grid.dims[2] = 0;
+    for(const cgp::Point &p: verts)
+        bbox.includePnt(p);
+    if(tris.empty() || h <= 0.0f)
+        return;
+
+    // cover the bounding box, which may not start at the origin of the grid
+    extent.diff(grid.origin, bbox.max);
+    float ext[3] = {extent.i, extent.j, extent.k};
+    for(a = 0; a < 3; a++)
+        grid.dims[a] = max(1, (int) ceil(ext[a] / h));
+
+    // rows of voxel columns a triangle can cross, from its extent in y
+    auto rowRange = [&grid, h](float ymin, float ymax, int &j0, int &j1)
+    {
+        j0 = max(0, (int) ceil((ymin - grid.origin.y) / h - 0.5f));
+        j1 = min(grid.dims[1] - 1, (int) floor((ymax - grid.origin.y) / h - 0.5f));
+    };
+
+    // bands are one brick tall in y, so that bands write disjoint bricks
+    numbands = (grid.dims[1] + bs - 1) / bs;
+    vector<vector<int>> bandtris(numbands);
+    for(t = 0; t < (int) tris.size(); t++)
+    {
+        float ymin = verts[tris[t].v[0]].y, ymax = ymin;
+        int j0, j1, band;
+        for(int p = 1; p < 3; p++)
+        {
+            ymin = min(ymin, verts[tris[t].v[p]].y);
+            ymax = max(ymax, verts[tris[t].v[p]].y);
+        }
+        rowRange(ymin, ymax, j0, j1);
+        for(band = j0 / bs; j0 <= j1 && band <= j1 / bs; band++)
+            bandtris[band].push_back(t);
+    }
+
+    numthreads = parallel::numChunks(0, numbands, numthreads);
+    vector<CellGrid> partial(numthreads); // background 0
+    atomic<int> nextband(0);
+    parallel::forChunks(0, numthreads, numthreads, [&](int thread, int, int)
+    {
+        // a dense slab one band tall, converted to bricks once all its columns are filled
+        int nx = grid.dims[0], nz = grid.dims[2];
+        int bx = (nx + bs - 1) / bs, bz = (nz + bs - 1) / bs;
+        vector<unsigned char> slab((size_t) bx * bs * bs * bz * bs);
+        vector<vector<double>> crossings(nx);
+        int band;
+
+        while((band = nextband++) < numbands)
+        {
+            std::fill(slab.begin(), slab.end(), 0);
+            for(int jj = 0; jj < bs && band * bs + jj < grid.dims[1]; jj++)
+            {
+                int j = band * bs + jj;
+                double y = grid.origin.y + (j + 0.5) * h;
+
+                for(auto &c: crossings)
+                    c.clear();
+                for(int t: bandtris[band])
+                {
+                    const cgp::Point * p[3] = {&verts[tris[t].v[0]], &verts[tris[t].v[1]], &verts[tris[t].v[2]]};
+                    float xmin = min(p[0]->x, min(p[1]->x, p[2]->x)), xmax = max(p[0]->x, max(p[1]->x, p[2]->x));
+                    float ymin = min(p[0]->y, min(p[1]->y, p[2]->y)), ymax = max(p[0]->y, max(p[1]->y, p[2]->y));
+                    int i0, i1, j0, j1;
+                    double z;
+
+                    rowRange(ymin, ymax, j0, j1);
+                    if(j < j0 || j > j1)
+                        continue;
+                    i0 = max(0, (int) ceil((xmin - grid.origin.x) / h - 0.5f));
+                    i1 = min(nx - 1, (int) floor((xmax - grid.origin.x) / h - 0.5f));
+                    for(int i = i0; i <= i1; i++)
+                        if(columnCrossing(p, grid.origin.x + (i + 0.5) * h, y, z))
+                            crossings[i].push_back(z);
+                }
+
+                // parity: voxel centres between alternate crossings are inside
+                for(int i = 0; i < nx; i++)
+                {
+                    vector<double> &c = crossings[i];
+                    sort(c.begin(), c.end());
+                    for(int s = 0; s + 1 < (int) c.size(); s += 2)
+                    {
+                        int k0 = max(0, (int) ceil((c[s] - grid.origin.z) / h - 0.5));
+                        int k1 = min(nz, (int) ceil((c[s+1] - grid.origin.z) / h - 0.5));
+                        unsigned char * column = &slab[((size_t) jj * bx * bs + i) * bz * bs];
+                        if(k1 > k0)
+                            memset(column + k0, 1, k1 - k0);
+                    }
+                }
+            }
+
+            // bricks that are entirely solid are stored as uniform, entirely empty ones not at all
+            for(int bi = 0; bi < bx; bi++)
+                for(int bk = 0; bk < bz; bk++)
+                {
+                    int count = 0;
+                    for(int jj = 0; jj < bs; jj++)
+                        for(int ii = 0; ii < bs; ii++)
+                        {
+                            const unsigned char * column = &slab[((size_t) jj * bx * bs + bi * bs + ii) * bz * bs + bk * bs];
+                            for(int kk = 0; kk < bs; kk++)
+                                count += column[kk];
+                        }
+                    if(count == 0)
+                        continue;
+                    if(count == CellGrid::brickvoxels)
+                    {
+                        partial[thread].fillBrick(bi, band, bk, 1);
+                        continue;
+                    }
+                    unsigned char * data = partial[thread].denseBrick(bi, band, bk);
+                    for(int kk = 0; kk < bs; kk++)
+                        for(int jj = 0; jj < bs; jj++)
+                            for(int ii = 0; ii < bs; ii++)
+                                data[(kk * bs + jj) * bs + ii] = slab[((size_t) jj * bx * bs + bi * bs + ii) * bz * bs + bk * bs + kk];
+                }
+        }
+    });
+
+    for(a = 0; a < numthreads; a++)
+        grid.cells.merge(partial[a]);
+    grid.cells.compact(); // solid interiors become tiles
+}
+
+/// Bias applied to lattice coordinates in an edge key, allowing negative voxel indices
+static const int latticebias = 1 << 19;
+
+/**
+ * Key for a lattice edge, given its lower end and the axes along which it steps by one
+ * @param i, j, k   lower end of the edge in voxel coordinates
+ * @param mask      bit 0 set for a step in x, bit 1 for y and bit 2 for z
+ */
+static inline uint64_t latticeEdgeKey(int i, int j, int k, int mask)
+{
+    return ((uint64_t) (i + latticebias) << 43) | ((uint64_t) (j + latticebias) << 23) | ((uint64_t) (k + latticebias) << 3)
+           | (uint64_t) mask;
+}
+
+/// Surface vertex on a lattice edge, identified by the edge so that neighbouring cubes share it
+struct EdgeVertex
+{
+    uint64_t key;       ///< lattice edge, see latticeEdgeKey
+    cgp::Point pnt;     ///< position of the crossing
+};
+
+/**
+ * Marching tetrahedra over the bricks of a sparse grid. A sample is inside if its value lies below the
+ * iso level (or above it, when @a insideabove is set), and surface vertices are placed by linear
+ * interpolation along lattice edges.
+ */
+template<typename T>
+static void marchTetrahedra(const SparseGrid<T> &field, const cgp::Point &origin, float spacing, float iso, bool insideabove,
+                            std::vector<cgp::Point> &verts, std::vector<Triangle> &tris, int numthreads)
+{
+    typedef SparseGrid<T> Grid;
+    const int bs = Grid::bricksize;
+    unordered_set<uint64_t> candidates;
+    vector<uint64_t> bricklist;
+    uts::flat_map<uint64_t, int> vertindex;
+    int numchunks, c;
+
+    verts.clear();
+    tris.clear();
+
+    // surface cubes have their lower corner in an allocated brick or in the brick just below one, or on
+    // either side of the boundary of a tile
+    auto addBelow = [&candidates](int bi, int bj, int bk)
+    {
+        for(int d = 0; d < 8; d++)
+            candidates.insert(Grid::brickKey(bi - (d & 1), bj - ((d >> 1) & 1), bk - ((d >> 2) & 1)));
+    };
+    field.forEachBrick([&addBelow](int bi, int bj, int bk, const typename Grid::Brick &){ addBelow(bi, bj, bk); });
+    field.forEachTile([&addBelow](int ti, int tj, int tk, T)
+    {
+        const int last = Grid::tilebricks - 1;
+        for(int k = 0; k <= last; k++)
+            for(int j = 0; j <= last; j++)
+                for(int i = 0; i <= last; i++)
+                    if(i == 0 || j == 0 || k == 0 || i == last || j == last || k == last)
+                        addBelow((ti << Grid::tilebits) + i, (tj << Grid::tilebits) + j, (tk << Grid::tilebits) + k);
+    });
+    bricklist.assign(candidates.begin(), candidates.end());
+    sort(bricklist.begin(), bricklist.end()); // fixed order keeps output independent of hashing and threads
+
+    // tetrahedra sharing the main diagonal of the cube, each stepping along the axes in a different order
+    static const int perms[6][3] = {{0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0}};
+
+    numchunks = parallel::numChunks(0, (int) bricklist.size(), numthreads);
+    vector<vector<array<EdgeVertex, 3>>> chunktris(numchunks);
+    parallel::forChunks(0, (int) bricklist.size(), numthreads, [&](int chunk, int first, int last)
+    {
+        float vals[bs+1][bs+1][bs+1];
+        bool in[bs+1][bs+1][bs+1];
+
+        const typename Grid::Brick * nbr[8];
+        T fill[8];
+
+        for(int b = first; b < last; b++)
+        {
+            int bi, bj, bk, i, j, k, d;
+            bool uniform = true, side[8];
+
+            // this brick's cubes reach into the next bricks along each axis, and are all on one side of the
+            // level if those bricks are uniform on that side
+            Grid::brickCoords(bricklist[b], bi, bj, bk);
+            for(d = 0; d < 8; d++)
+            {
+                int ni = bi + (d & 1), nj = bj + ((d >> 1) & 1), nk = bk + ((d >> 2) & 1);
+                nbr[d] = field.findBrick(ni, nj, nk);
+                fill[d] = nbr[d] ? nbr[d]->uniform : field.fillValue(ni, nj, nk);
+                side[d] = insideabove ? ((float) fill[d] > iso) : ((float) fill[d] < iso);
+                uniform = uniform && !(nbr[d] && nbr[d]->data) && side[d] == side[0];
+            }
+            if(uniform)
+                continue;
+
+            // gather samples at the lattice points of this brick's cubes
+            uniform = true;
+            for(i = 0; i <= bs; i++)
+                for(j = 0; j <= bs; j++)
+                    for(k = 0; k <= bs; k++)
+                    {
+                        d = (i >> Grid::brickbits) | ((j >> Grid::brickbits) << 1) | ((k >> Grid::brickbits) << 2);
+                        vals[i][j][k] = (float) ((nbr[d] && nbr[d]->data) ? nbr[d]->get(i & (bs-1), j & (bs-1), k & (bs-1)) : fill[d]);
+                        in[i][j][k] = insideabove ? (vals[i][j][k] > iso) : (vals[i][j][k] < iso);
+                        uniform = uniform && in[i][j][k] == in[0][0][0];
+                    }
+            if(uniform)
+                continue;
+
+            for(i = 0; i < bs; i++)
+                for(j = 0; j < bs; j++)
+                    for(k = 0; k < bs; k++)
+                    {
+                        int corner[3] = {bi * bs + i, bj * bs + j, bk * bs + k};
+                        float cv[8];
+                        bool cin[8];
+                        int inside = 0;
+
+                        for(d = 0; d < 8; d++)
+                        {
+                            cv[d] = vals[i + (d & 1)][j + ((d >> 1) & 1)][k + ((d >> 2) & 1)];
+                            cin[d] = in[i + (d & 1)][j + ((d >> 1) & 1)][k + ((d >> 2) & 1)];
+                            inside += cin[d];
+                        }
+                        if(inside == 0 || inside == 8)
+                            continue;
+
+                        for(int t = 0; t < 6; t++)
+                        {
+                            // tetrahedron corners as offset masks: origin, one step, two steps, opposite corner
+                            int tv[4] = {0, 1 << perms[t][0], (1 << perms[t][0]) | (1 << perms[t][1]), 7};
+                            int tin[4], tout[4], numin = 0, numout = 0;
+
+                            for(d = 0; d < 4; d++)
+                            {
+                                if(cin[tv[d]])
+                                    tin[numin++] = tv[d];
+                                else
+                                    tout[numout++] = tv[d];
+                            }
+                            if(numin == 0 || numout == 0)
+                                continue;
+
+                            // all tetrahedron edges step in the positive direction, from the lower mask to the higher
+                            auto edge = [&](int m0, int m1)
+                            {
+                                int lo = min(m0, m1), hi = max(m0, m1);
+                                float t = (cv[hi] == cv[lo]) ? 0.5f : (iso - cv[lo]) / (cv[hi] - cv[lo]);
+                                EdgeVertex ev;
+
+                                t = max(0.001f, min(0.999f, t)); // keep clear of lattice points to avoid slivers
+                                ev.key = latticeEdgeKey(corner[0] + (lo & 1), corner[1] + ((lo >> 1) & 1), corner[2] + ((lo >> 2) & 1), hi & ~lo);
+                                ev.pnt = cgp::Point(origin.x + spacing * (corner[0] + 0.5f + (lo & 1) + t * ((hi & ~lo) & 1)),
+                                                    origin.y + spacing * (corner[1] + 0.5f + ((lo >> 1) & 1) + t * (((hi & ~lo) >> 1) & 1)),
+                                                    origin.z + spacing * (corner[2] + 0.5f + ((lo >> 2) & 1) + t * (((hi & ~lo) >> 2) & 1)));
+                                return ev;
+                            };
+                            auto emit = [&](EdgeVertex e0, EdgeVertex e1, EdgeVertex e2)
+                            {
+                                // orient so that the normal points from the inside corners to the outside ones
+                                cgp::Vector v0, v1, n;
+                                float dir[3] = {0.0f, 0.0f, 0.0f};
+                                v0.diff(e0.pnt, e1.pnt); v1.diff(e0.pnt, e2.pnt);
+                                n.cross(v0, v1);
+                                for(int q = 0; q < numout; q++)
+                                    for(int a = 0; a < 3; a++)
+                                        dir[a] += (float) ((tout[q] >> a) & 1) / numout;
+                                for(int q = 0; q < numin; q++)
+                                    for(int a = 0; a < 3; a++)
+                                        dir[a] -= (float) ((tin[q] >> a) & 1) / numin;
+                                if(n.i * dir[0] + n.j * dir[1] + n.k * dir[2] < 0.0f)
+                                    std::swap(e1, e2);
+                                chunktris[chunk].push_back({{e0, e1, e2}});
+                            };
+
+                            if(numin == 1)
+                                emit(edge(tin[0], tout[0]), edge(tin[0], tout[1]), edge(tin[0], tout[2]));
+                            else if(numout == 1)
+                                emit(edge(tout[0], tin[0]), edge(tout[0], tin[1]), edge(tout[0], tin[2]));
+                            else
+                            {
+                                // quadrilateral around the two inside corners
+                                EdgeVertex q0 = edge(tin[0], tout[0]), q1 = edge(tin[0], tout[1]), q2 = edge(tin[1], tout[1]), q3 = edge(tin[1], tout[0]);
+                                emit(q0, q1, q2);
+                                emit(q0, q2, q3);
+                            }
+                        }
+                    }
+        }
+    });
+
+    // shared lattice edges give shared vertices, so the output is welded without a search for coincident points
+    for(c = 0; c < numchunks; c++)
+        for(auto &ct: chunktris[c])
+        {
+            Triangle tri;
+            cgp::Vector v0, v1;
+            for(int p = 0; p < 3; p++)
+            {
+                auto ins = vertindex.insert(ct[p].key, (int) verts.size());
+                if(ins.second)
+                    verts.push_back(ct[p].pnt);
+                tri.v[p] = * ins.first;
+            }
+            v0.diff(verts[tri.v[0]], verts[tri.v[1]]);
+            v1.diff(verts[tri.v[0]], verts[tri.v[2]]);
+            tri.n.cross(v0, v1);
+            tri.n.normalize();
+            tris.push_back(tri);
+        }
+}
+
+void polygonise(const VoxelGrid &grid, std::vector<cgp::Point> &verts, std::vector<Triangle> &tris, int numthreads)
+{
+    marchTetrahedra(grid.cells, grid.origin, grid.voxelsize, 0.5f, true, verts, tris, numthreads);
+}
+
+void isosurface(const SparseGrid<float> &field, const cgp::Point &origin, float spacing, float iso,
+                std::vector<cgp::Point> &verts, std::vector<Triangle> &tris, int numthreads)
+{
+    marchTetrahedra(field, origin, spacing, iso, false, verts, tris, numthreads);
+}
@@ -0,0 +1,337 @@
+#ifndef _voxel_h
+#define _voxel_h
+/**
+ * @file
+ *
+ * Sparse volumetric grids, voxelisation of closed meshes and isosurface extraction.
+ */
+
+#include "mesh.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+
+/**
+ * Sparse 3D grid of values stored in 8x8x8 bricks held in a hash map, so that memory follows the occupied region
+ * rather than the bounding box. Regions never written read back as the background value. A brick whose voxels
+ * all hold the same value can be stored as uniform, without per-voxel storage, and a coarser level of uniform
+ * tiles of 8x8x8 bricks holds large solid regions, so that memory follows their surface rather than their volume.
+ * Allocated bricks take precedence over the tile they lie in.
+ *
+ * Reads may run concurrently, but writes must be confined to one thread at a time. To build a grid in parallel,
+ * fill separate grids covering disjoint bricks and @a merge them.
+ */
+template<typename T>
+class SparseGrid
+{
+public:
+    static const int brickbits = 3;                     ///< log2 of brick side length
+    static const int bricksize = 1 << brickbits;        ///< voxels along each side of a brick
+    static const int brickvoxels = bricksize * bricksize * bricksize; ///< voxels in a brick
+    static const int tilebits = 3;                      ///< log2 of tile side length, in bricks
+    static const int tilebricks = 1 << tilebits;        ///< bricks along each side of a tile
+
+    /// Brick of voxels, either uniform or stored densely
+    struct Brick
+    {
+        T uniform;                  ///< value of every voxel, if data is absent
+        std::unique_ptr<T[]> data;  ///< voxels indexed by (k * bricksize + j) * bricksize + i, absent for a uniform brick
+
+        /// Value of a voxel given its coordinates within the brick
+        T get(int i, int j, int k) const { return data ? data[(k * bricksize + j) * bricksize + i] : uniform; }
+    };
+
+private:
+    static const int keybits = 21;                      ///< bits per brick coordinate in a key
+    static const int keybias = 1 << (keybits - 1);      ///< offset allowing negative brick coordinates
+
+    std::unordered_map<uint64_t, Brick> bricks; ///< allocated bricks by key
+    std::unordered_map<uint64_t, T> tiles;      ///< uniform tiles by key of their tile coordinates
+    T background;                               ///< value of voxels outside any brick or tile
+
+public:
+
+    /// Constructor, with the value of unwritten voxels
+    explicit SparseGrid(T background = T()) : background(background) {}
+
+    /// Pack brick coordinates into a map key
+    static uint64_t brickKey(int bi, int bj, int bk)
+    {
+        const uint64_t mask = (1 << keybits) - 1;
+        return (((uint64_t) (bi + keybias) & mask) << (2 * keybits)) | (((uint64_t) (bj + keybias) & mask) << keybits)
+               | ((uint64_t) (bk + keybias) & mask);
+    }
+
+    /// Unpack brick coordinates from a map key
+    static void brickCoords(uint64_t key, int &bi, int &bj, int &bk)
+    {
+        const uint64_t mask = (1 << keybits) - 1;
+        bi = (int) ((key >> (2 * keybits)) & mask) - keybias;
+        bj = (int) ((key >> keybits) & mask) - keybias;
+        bk = (int) (key & mask) - keybias;
+    }
+
+    /// Getter for the background value
+    T getBackground() const { return background; }
+
+    /// Remove all bricks and tiles
+    void clear(){ bricks.clear(); tiles.clear(); }
+
+    /// Number of allocated bricks, uniform or dense
+    int numBricks() const { return (int) bricks.size(); }
+
+    /// Number of uniform tiles
+    int numTiles() const { return (int) tiles.size(); }
+
+    /// Value of every voxel of an unallocated brick: that of the tile it lies in, if any, otherwise the background
+    T fillValue(int bi, int bj, int bk) const
+    {
+        if(tiles.empty())
+            return background;
+        auto it = tiles.find(brickKey(bi >> tilebits, bj >> tilebits, bk >> tilebits));
+        return (it == tiles.end()) ? background : it->second;
+    }
+
+    /// Find a brick by brick coordinates, NULL if not allocated
+    const Brick * findBrick(int bi, int bj, int bk) const
+    {
+        auto it = bricks.find(brickKey(bi, bj, bk));
+        return (it == bricks.end()) ? NULL : &it->second;
+    }
+
+    /// Value of a voxel
+    T get(int i, int j, int k) const
+    {
+        const Brick * b = findBrick(i >> brickbits, j >> brickbits, k >> brickbits);
+        return b ? b->get(i & (bricksize-1), j & (bricksize-1), k & (bricksize-1)) : fillValue(i >> brickbits, j >> brickbits, k >> brickbits);
+    }
+
+    /// Set the value of a voxel, allocating or densifying its brick as needed
+    void set(int i, int j, int k, T value)
+    {
+        uint64_t key = brickKey(i >> brickbits, j >> brickbits, k >> brickbits);
+        auto it = bricks.find(key);
+
+        if(it == bricks.end())
+        {
+            T fill = fillValue(i >> brickbits, j >> brickbits, k >> brickbits);
+            if(value == fill)
+                return;
+            it = bricks.emplace(key, Brick()).first;
+            it->second.uniform = fill;
+        }
+        Brick &b = it->second;
+        if(!b.data)
+        {
+            if(b.uniform == value)
+                return;
+            b.data.reset(new T[brickvoxels]);
+            std::fill(b.data.get(), b.data.get() + brickvoxels, b.uniform);
+        }
+        b.data[((k & (bricksize-1)) * bricksize + (j & (bricksize-1))) * bricksize + (i & (bricksize-1))] = value;
+    }
+
+    /**
+     * Writable voxels of a brick, allocating it and converting it to dense storage if necessary
+     * @retval pointer to brickvoxels values indexed by (k * bricksize + j) * bricksize + i
+     */
+    T * denseBrick(int bi, int bj, int bk)
+    {
+        uint64_t key = brickKey(bi, bj, bk);
+        auto it = bricks.find(key);
+
+        if(it == bricks.end())
+        {
+            it = bricks.emplace(key, Brick()).first;
+            it->second.uniform = fillValue(bi, bj, bk);
+        }
+        Brick &b = it->second;
+        if(!b.data)
+        {
+            b.data.reset(new T[brickvoxels]);
+            std::fill(b.data.get(), b.data.get() + brickvoxels, b.uniform);
+        }
+        return b.data.get();
+    }
+
+    /// Set every voxel of a brick to one value, releasing any dense storage
+    void fillBrick(int bi, int bj, int bk, T value)
+    {
+        Brick &b = bricks[brickKey(bi, bj, bk)];
+        b.data.reset();
+        b.uniform = value;
+    }
+
+    /**
+     * Set every voxel of a tile to one value, releasing the bricks within it
+     * @param ti, tj, tk    tile coordinates, each brick coordinate shifted down by @a tilebits
+     * @param value         value of the tile's voxels
+     */
+    void fillTile(int ti, int tj, int tk, T value)
+    {
+        for(int bk = 0; bk < tilebricks; bk++)
+            for(int bj = 0; bj < tilebricks; bj++)
+                for(int bi = 0; bi < tilebricks; bi++)
+                    bricks.erase(brickKey((ti << tilebits) + bi, (tj << tilebits) + bj, (tk << tilebits) + bk));
+        if(value == background)
+            tiles.erase(brickKey(ti, tj, tk));
+        else
+            tiles[brickKey(ti, tj, tk)] = value;
+    }
+
+    /**
+     * Convert dense bricks whose voxels all share a value to uniform bricks, drop uniform bricks holding the
+     * value they would read back as anyway, and replace complete tiles of uniform bricks sharing a value by a tile
+     */
+    void compact()
+    {
+        std::unordered_map<uint64_t, std::pair<T, int>> tilecount; // shared value and brick count, -1 if mixed
+        int bi, bj, bk;
+
+        for(auto it = bricks.begin(); it != bricks.end(); )
+        {
+            Brick &b = it->second;
+            brickCoords(it->first, bi, bj, bk);
+            if(b.data && std::all_of(b.data.get() + 1, b.data.get() + brickvoxels, [&b](const T &v){ return v == b.data[0]; }))
+            {
+                b.uniform = b.data[0];
+                b.data.reset();
+            }
+            if(!b.data && b.uniform == fillValue(bi, bj, bk))
+            {
+                it = bricks.erase(it);
+                continue;
+            }
+            uint64_t tkey = brickKey(bi >> tilebits, bj >> tilebits, bk >> tilebits);
+            auto ins = tilecount.emplace(tkey, std::make_pair(b.uniform, 0));
+            std::pair<T, int> &count = ins.first->second;
+            if(b.data || tiles.count(tkey) || count.second < 0 || !(count.first == b.uniform))
+                count.second = -1;
+            else
+                count.second++;
+            ++it;
+        }
+        for(auto &entry: tilecount)
+            if(entry.second.second == tilebricks * tilebricks * tilebricks)
+            {
+                brickCoords(entry.first, bi, bj, bk);
+                fillTile(bi, bj, bk, entry.second.first);
+            }
+    }
+
+    /**
+     * Move all bricks and tiles of another grid into this one. Bricks and tiles present in both are taken from
+     * the other grid, and bricks of this grid keep their precedence over tiles taken from the other.
+     * @param other     grid to take bricks and tiles from, left empty
+     */
+    void merge(SparseGrid<T> &other)
+    {
+        for(auto &entry: other.bricks)
+            bricks[entry.first] = std::move(entry.second);
+        for(auto &entry: other.tiles)
+            tiles[entry.first] = entry.second;
+        other.clear();
+    }
+
+    /// Approximate memory held by bricks and tiles, in bytes
+    size_t memoryUsage() const
+    {
+        size_t bytes = bricks.size() * (sizeof(uint64_t) + sizeof(Brick) + 2 * sizeof(void *))
+                     + tiles.size() * (sizeof(uint64_t) + sizeof(T) + 2 * sizeof(void *));
+        for(auto &entry: bricks)
+            if(entry.second.data)
+                bytes += brickvoxels * sizeof(T);
+        return bytes;
+    }
+
+    /// Call f(bi, bj, bk, brick) for every allocated brick, in no particular order
+    template<typename F>
+    void forEachBrick(F f) const
+    {
+        int bi, bj, bk;
+        for(auto &entry: bricks)
+        {
+            brickCoords(entry.first, bi, bj, bk);
+            f(bi, bj, bk, entry.second);
+        }
+    }
+
+    /// Call f(ti, tj, tk, value) for every uniform tile, in no particular order
+    template<typename F>
+    void forEachTile(F f) const
+    {
+        int ti, tj, tk;
+        for(auto &entry: tiles)
+        {
+            brickCoords(entry.first, ti, tj, tk);
+            f(ti, tj, tk, entry.second);
+        }
+    }
+};
+
+/**
+ * Solid voxelisation of a mesh. Voxel (i, j, k) is the cube of side @a voxelsize with minimum corner at
+ * origin + (i, j, k) * voxelsize and is solid if its centre is inside the mesh.
+ */
+struct VoxelGrid
+{
+    SparseGrid<unsigned char> cells;    ///< 1 for solid voxels, 0 otherwise
+    cgp::Point origin;                  ///< minimum corner of voxel (0, 0, 0)
+    float voxelsize;                    ///< side length of a voxel
+    int dims[3];                        ///< number of voxels along x, y and z covering the mesh bounding box
+};
+
+/**
+ * Voxelise a closed mesh by casting a ray along z through the centre of every column of voxels and filling
+ * between successive crossings (scanline parity). Rows of bricks are processed in parallel.
+ * @param verts, tris   mesh geometry, which should be closed for the parity fill to be meaningful
+ * @param[out] grid     solid voxels
+ * @param resolution    number of voxels along the longest side of the mesh bounding box
+ * @param numthreads    number of threads to use, 0 for one per core
+ */
+void voxelise(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, VoxelGrid &grid,
+              int resolution, int numthreads = 0);
+
+/**
+ * Voxelise a closed mesh into a grid whose origin and voxel size are already set, see @a voxelise. The grid
+ * dimensions are set to cover the mesh bounding box.
+ * @param verts, tris   mesh geometry
+ * @param[in,out] grid  grid with origin and voxelsize set on input, receiving solid voxels
+ * @param numthreads    number of threads to use, 0 for one per core
+ */
+void fillVoxels(const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris, VoxelGrid &grid, int numthreads = 0);
+
+/**
+ * Test whether a point lies inside a closed mesh, by the parity of crossings of a vertical ray above it
+ * @param pnt           point to test
+ * @param verts, tris   mesh geometry, which should be closed
+ * @retval true if the point is inside
+ */
+bool pointInside(const cgp::Point &pnt, const std::vector<cgp::Point> &verts, const std::vector<Triangle> &tris);
+
+/**
+ * Extract the boundary between solid and empty voxels as a closed, welded triangle mesh with outward facing
+ * triangles. Each cube of eight neighbouring voxel centres is split into six tetrahedra about its main diagonal
+ * and the surface is placed at edge midpoints (marching tetrahedra).
+ * @param grid              voxels to polygonise
+ * @param[out] verts, tris  extracted surface, previous contents are discarded
+ * @param numthreads        number of threads to use, 0 for one per core
+ */
+void polygonise(const VoxelGrid &grid, std::vector<cgp::Point> &verts, std::vector<Triangle> &tris, int numthreads = 0);
+
+/**
+ * Extract a level set of a sampled scalar field as a closed, welded triangle mesh, by marching tetrahedra with
+ * vertices interpolated along lattice edges. Triangles face away from the region below the iso level.
+ * @param field             samples, with sample (i, j, k) at origin + (i + 0.5, j + 0.5, k + 0.5) * spacing
+ * @param origin, spacing   placement of the samples
+ * @param iso               level to extract
+ * @param[out] verts, tris  extracted surface, previous contents are discarded
+ * @param numthreads        number of threads to use, 0 for one per core
+ */
+void isosurface(const SparseGrid<float> &field, const cgp::Point &origin, float spacing, float iso,
+                std::vector<cgp::Point> &verts, std::vector<Triangle> &tris, int numthreads = 0);
+
+#endif
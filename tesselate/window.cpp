@@ -44,10 +44,14 @@
 #include "window.h"
 #include "vecpnt.h"
 #include "common/str.h"
+#include "common/timer.h"
 #include <QMessageBox>
+#include <QInputDialog>
 
 #include <cmath>
 #include <string>
+#include <sstream>
+#include <iomanip>
 
 using namespace std;
 
@@ -212,12 +216,39 @@ Window::Window()
     createActions();
     createMenus();
 
+    // load progress in the status bar, only visible while a load is running
+    loader = NULL;
+    loadGeneration = 0;
+    validationLink = std::make_shared<ValidationLink>();
+    validationLink->window = this;
+    loadProgress = new QProgressBar;
+    loadProgress->setRange(0, 100);
+    loadProgress->setVisible(false);
+    statusBar()->addPermanentWidget(loadProgress);
+
+    // latency overlay in the corner of the render view, only visible when chosen from the view menu
+    latencyOverlay = new QLabel(perspectiveView);
+    latencyOverlay->setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 160); color: white; font-family: monospace; padding: 4px; }");
+    latencyOverlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    latencyOverlay->move(8, 8);
+    latencyOverlay->setVisible(false);
+    latencyRefresh = new QTimer(this);
+    latencyRefresh->setInterval(250);
+    connect(latencyRefresh, SIGNAL(timeout()), this, SLOT(updateLatency()));
+
     mainWidget->setLayout(mainLayout);
     setWindowTitle(tr("Tesselation Viewer"));
     mainWidget->setMouseTracking(true);
     setMouseTracking(true);
 }
 
+Window::~Window()
+{
+    // validation workers may still be running, so stop them posting to the window
+    std::lock_guard<std::mutex> guard(validationLink->lock);
+    validationLink->window = NULL;
+}
+
 void Window::keyPressEvent(QKeyEvent *e)
 {
     // pass to render window
@@ -243,6 +274,8 @@ void Window::newFile()
 {
     // clear everything and reset
     // this does not reset the volume parameters
+    cancelLoad();
+    loadGeneration++;
     perspectiveView->getXSect()->clear();
     perspectiveView->setMeshVisible(false);
     perspectiveView->setGeometryUpdate(true);
@@ -267,12 +300,29 @@ void Window::open()
         // use file extension to determine action
         if(endsWith(infile, ".stl"))
         {
-            perspectiveView->getXSect()->readSTL(infile);
-            perspectiveView->getXSect()->boxFit(10.0f);
-
-            perspectiveView->setMeshVisible(true);
-            checkModel->setChecked(true);
-            repaintAllGL();
+            // load on a worker thread, the mesh is swapped in by previewLoaded and meshLoaded
+            // validation runs afterwards without holding up display, and is reported by validationFinished
+            cancelLoad();
+            perspectiveView->getXSect()->cancelValidation();
+            loadGeneration++;
+            loader = new MeshLoader(infile, 10.0f, ValidationPolicy::BACKGROUND, this);
+            std::shared_ptr<ValidationLink> link = validationLink;
+            int generation = loadGeneration;
+            loader->setValidationListener([link, generation, fileName] (const MeshValidity &result)
+            {
+                std::lock_guard<std::mutex> guard(link->lock);
+                if(link->window != NULL)
+                    QMetaObject::invokeMethod(link->window, "validationFinished", Qt::QueuedConnection, Q_ARG(int, generation),
+                                              Q_ARG(QString, fileName), Q_ARG(bool, result.basic), Q_ARG(bool, result.manifold));
+            });
+            connect(loader, SIGNAL(progressChanged(int)), this, SLOT(loadProgressed(int)));
+            connect(loader, SIGNAL(previewReady(int)), this, SLOT(previewLoaded(int)));
+            connect(loader, SIGNAL(loadFinished(bool)), this, SLOT(meshLoaded(bool)));
+            loadProgress->setValue(0);
+            loadProgress->setVisible(true);
+            cancelLoadAct->setEnabled(true);
+            statusBar()->showMessage(tr("Loading ") + fileName);
+            loader->start();
         }
         else
         {
@@ -281,6 +331,76 @@ void Window::open()
     }
 }
 
+void Window::cancelLoad()
+{
+    if(loader != NULL)
+    {
+        // disconnect first so that signals still queued from the worker are dropped, then abandon the
+        // loader rather than wait for it, since it only stops at its next cancellation check
+        disconnect(loader, 0, this, 0);
+        loader->cancel();
+        connect(loader, SIGNAL(finished()), loader, SLOT(deleteLater()));
+        if(loader->isFinished()) // finished before the connection was made
+            loader->deleteLater();
+        loader = NULL;
+        loadProgress->setVisible(false);
+        cancelLoadAct->setEnabled(false);
+        statusBar()->showMessage(tr("Load cancelled"), 3000);
+    }
+}
+
+void Window::previewLoaded(int level)
+{
+    if(loader == NULL)
+        return;
+    perspectiveView->getXSect()->takeGeometry(* loader->getPreview(level));
+    perspectiveView->setMeshVisible(true);
+    checkModel->setChecked(true);
+    repaintAllGL();
+}
+
+void Window::meshLoaded(bool success)
+{
+    if(loader == NULL)
+        return;
+    loader->wait();
+    if(success)
+    {
+        perspectiveView->getXSect()->takeGeometry(* loader->getMesh());
+        perspectiveView->setMeshVisible(true);
+        checkModel->setChecked(true);
+        statusBar()->showMessage(tr("Loaded ") + QString::fromStdString(loader->getFilename()), 3000);
+    }
+    else
+    {
+        perspectiveView->getXSect()->clear();
+        perspectiveView->setMeshVisible(false);
+        statusBar()->showMessage(tr("Unable to load ") + QString::fromStdString(loader->getFilename()), 3000);
+    }
+    loader->deleteLater();
+    loader = NULL;
+    loadProgress->setVisible(false);
+    cancelLoadAct->setEnabled(false);
+    repaintAllGL();
+}
+
+void Window::loadProgressed(int percent)
+{
+    loadProgress->setValue(percent);
+}
+
+void Window::validationFinished(int generation, QString filename, bool basic, bool manifold)
+{
+    if(generation != loadGeneration) // from a load that has since been cancelled or replaced
+        return;
+    if(basic && manifold)
+        statusBar()->showMessage(filename + tr(" is a valid closed manifold"), 5000);
+    else if(basic)
+        statusBar()->showMessage(filename + tr(" passes basic validity but is not a closed manifold"), 5000);
+    else
+        statusBar()->showMessage(filename + tr(" does not pass basic validity"), 5000);
+}
+
 void Window::saveFile()
 {
     if(!tessfilename.isEmpty()) // save directly if we already have a file name
@@ -331,11 +451,63 @@ void Window::showModel(int show)
     repaintAllGL();
 }
 
+void Window::memoryBudget()
+{
+    bool ok;
+
+    // in MB as for the thumbnail tool's --memory-budget, applying from the next load
+    int megabytes = QInputDialog::getInt(this, tr("Memory Budget"),
+                                         tr("Refuse to load meshes that would take memory use over this many MB (0 for no limit):"),
+                                         (int) (stats::getMemoryBudget() >> 20), 0, 1 << 30, 256, &ok);
+    if(ok)
+        stats::setMemoryBudget((std::int64_t) megabytes << 20);
+}
+
 void Window::showParamOptions()
 {
     paramPanel->setVisible(showParamAct->isChecked());
 }
 
+void Window::showLatency()
+{
+    bool show = showLatencyAct->isChecked();
+
+    // the spans behind the overlay only record while timing is on
+    stats::enableTimers(show);
+    latencyOverlay->setVisible(show);
+    if(show)
+    {
+        updateLatency();
+        latencyRefresh->start();
+    }
+    else
+        latencyRefresh->stop();
+}
+
+void Window::updateLatency()
+{
+    std::ostringstream text;
+
+    text << std::left << std::setw(20) << "latency (ms)" << std::right << std::setw(9) << "p50" << std::setw(9) << "p95"
+         << std::setw(9) << "p99" << std::setw(9) << "max" << std::setw(8) << "count";
+    text << std::fixed << std::setprecision(2);
+    for(const auto &time: stats::getTimes())
+    {
+        const stats::Histogram * latency = time->latency();
+        if(latency == NULL || latency->count() == 0)
+            continue;
+        text << "\n" << std::left << std::setw(20) << time->name() << std::right
+             << std::setw(9) << latency->quantile(0.50) * 1e-3 << std::setw(9) << latency->quantile(0.95) * 1e-3
+             << std::setw(9) << latency->quantile(0.99) * 1e-3 << std::setw(9) << latency->max() * 1e-3
+             << std::setw(8) << latency->count();
+    }
+    const Renderer * renderer = perspectiveView->getRenderer();
+    text << "\n" << "chunks drawn " << renderer->getChunksDrawn() << ", culled " << renderer->getChunksCulled()
+         << ", occluded " << renderer->getChunksOccluded();
+    latencyOverlay->setText(QString::fromStdString(text.str()));
+    latencyOverlay->adjustSize();
+}
+
 void Window::createActions()
 {
     newAct = new QAction(tr("&New"), this);
@@ -357,11 +529,28 @@ void Window::createActions()
     saveAsAct->setStatusTip(tr("Save a file under name"));
     connect(saveAsAct, SIGNAL(triggered()), this, SLOT(saveAs()));
 
+    cancelLoadAct = new QAction(tr("Cancel Load"), this);
+    cancelLoadAct->setShortcut(QKeySequence(Qt::Key_Escape));
+    cancelLoadAct->setStatusTip(tr("Stop loading the current file"));
+    cancelLoadAct->setEnabled(false);
+    connect(cancelLoadAct, SIGNAL(triggered()), this, SLOT(cancelLoad()));
+
+    memoryBudgetAct = new QAction(tr("Memory Budget..."), this);
+    memoryBudgetAct->setStatusTip(tr("Limit the memory that loading and checking a mesh may take"));
+    connect(memoryBudgetAct, SIGNAL(triggered()), this, SLOT(memoryBudget()));
+
     showParamAct = new QAction(tr("Show Parameters"), this);
     showParamAct->setCheckable(true);
     showParamAct->setChecked(true);
     showParamAct->setStatusTip(tr("Hide/Show Parameters"));
     connect(showParamAct, SIGNAL(triggered()), this, SLOT(showParamOptions()));
+
+    showLatencyAct = new QAction(tr("Show Latency"), this);
+    showLatencyAct->setCheckable(true);
+    showLatencyAct->setChecked(false);
+    showLatencyAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_L));
+    showLatencyAct->setStatusTip(tr("Hide/Show frame and geometry update latencies"));
+    connect(showLatencyAct, SIGNAL(triggered()), this, SLOT(showLatency()));
 }
 
 void Window::createMenus()
@@ -371,6 +560,9 @@ void Window::createMenus()
     fileMenu->addAction(openAct);
     fileMenu->addAction(saveAct);
     fileMenu->addAction(saveAsAct);
+    fileMenu->addAction(cancelLoadAct);
+    fileMenu->addAction(memoryBudgetAct);
     viewMenu = menuBar()->addMenu(tr("&View"));
     viewMenu->addAction(showParamAct);
+    viewMenu->addAction(showLatencyAct);
 }
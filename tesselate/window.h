@@ -42,13 +42,28 @@
 #define WINDOW_H
 
 #include "glwidget.h"
+#include "loader.h"
 #include <QWidget>
 #include <QtWidgets>
 #include <string>
+#include <memory>
+#include <mutex>
 
 class QAction;
 class QMenu;
 class QLineEdit;
+class QProgressBar;
+class Window;
+
+/**
+ * Route from validation workers back to the window. Workers can outlive the window, so they post results
+ * only while holding the lock and only if the window is still set, and the window clears it when destroyed.
+ */
+struct ValidationLink
+{
+    std::mutex lock;    ///< held while posting to or clearing the window
+    Window * window;    ///< receiver of validation results, NULL once destroyed
+};
 
 enum class Transform
 {
@@ -71,7 +86,7 @@ public:
     Window();
 
     /// destructor
-    ~Window(){};
+    ~Window();
 
     /// provides ideal size for window
     QSize sizeHint() const;
@@ -108,6 +123,39 @@ public slots:
     /// make parameter panel visible
     void showParamOptions();
 
+    /// toggle the overlay of frame and geometry update latencies
+    void showLatency();
+
+    /// refresh the latency overlay from the recorded times
+    void updateLatency();
+
+    /// abandon the mesh load in progress
+    void cancelLoad();
+
+    /// ask for the memory budget that later loads are checked against
+    void memoryBudget();
+
+    /**
+     * display a decimated preview published by the mesh loader, replacing any coarser one
+     * @param level     preview level, increasing with density
+     */
+    void previewLoaded(int level);
+
+    /// swap in the fully loaded mesh, or report failure
+    void meshLoaded(bool success);
+
+    /// update the load progress indicator
+    void loadProgressed(int percent);
+
+    /**
+     * report the outcome of background validation of a loaded mesh
+     * @param generation    load that the validation belongs to, results of any but the latest are dropped
+     * @param filename      file that was loaded
+     * @param basic         outcome of the basic validity test
+     * @param manifold      outcome of the manifold validity test
+     */
+    void validationFinished(int generation, QString filename, bool basic, bool manifold);
+
 
 protected:
 
@@ -134,11 +182,22 @@ private:
     QAction *openAct;       ///< open menu response
     QAction *saveAct;       ///< save menu response
     QAction *saveAsAct;     ///< save as menu response
+    QAction *cancelLoadAct; ///< cancel load menu response
+    QAction *memoryBudgetAct;   ///< memory budget menu response
     QMenu *viewMenu;        ///< view menu response
     QAction *showParamAct;  ///< toggle param panel menu response
+    QAction *showLatencyAct;    ///< toggle latency overlay menu response
 
     QString tessfilename; ///< name of tesselation file for output
 
+    MeshLoader * loader;            ///< background mesh load in progress, NULL if none
+    QProgressBar * loadProgress;    ///< status bar indicator of load progress
+    int loadGeneration;             ///< incremented on every load or reset, to recognise results from earlier loads
+    std::shared_ptr<ValidationLink> validationLink; ///< shared with validation workers, which may outlive the window
+
+    QLabel * latencyOverlay;    ///< latency percentiles drawn over the render view
+    QTimer * latencyRefresh;    ///< periodic update of the latency overlay
+
     /// create a slider
     void addSlider(QVBoxLayout * layout, const QString &label, QSlider * slider, float startValue, float scale, float low, float high, Transform sform);
 
@@ -0,0 +1,332 @@
+/**
+ * @file
+ *
+ * Nightly benchmarks of the mesh loading and validation pipeline.
+ */
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <test/testutil.h>
+#include "bench_mesh.h"
+#include "tesselate/timer.h"
+#include "tesselate/generate.h"
+#include <common/flat_map.h>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+using namespace std;
+
+bool parseBenchSizes(const std::string &list, std::vector<long> &sizes)
+{
+    stringstream in(list);
+    string item;
+
+    sizes.clear();
+    while(getline(in, item, ','))
+    {
+        char * end;
+        double count = strtod(item.c_str(), &end);
+        string suffix(end);
+        if(suffix == "K" || suffix == "k")
+            count *= 1e3;
+        else if(suffix == "M" || suffix == "m")
+            count *= 1e6;
+        else if(!suffix.empty() || end == item.c_str())
+            return false;
+        if(count < 1.0)
+            return false;
+        if(find(sizes.begin(), sizes.end(), (long) count) == sizes.end())
+            sizes.push_back((long) count);
+    }
+    return !sizes.empty();
+}
+
+bool writeBenchCSV(const std::string &filename, const std::vector<BenchResult> &results)
+{
+    ofstream out(filename);
+
+    if(!out)
+        return false;
+    out << "stage,triangles,seconds,trispersec\n";
+    out << setprecision(9);
+    for(const BenchResult &r: results)
+        out << r.stage << "," << r.numtris << "," << r.seconds << ","
+            << ((r.seconds > 0.0) ? (double) r.numtris / r.seconds : 0.0) << "\n";
+    return (bool) out;
+}
+
+bool writeBenchJSON(const std::string &filename, const std::vector<BenchResult> &results)
+{
+    ofstream out(filename);
+
+    if(!out)
+        return false;
+    out << "[\n" << setprecision(9);
+    for(int i = 0; i < (int) results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+        out << "  {\"stage\": \"" << r.stage << "\", \"triangles\": " << r.numtris << ", \"seconds\": " << r.seconds
+            << ", \"trispersec\": " << ((r.seconds > 0.0) ? (double) r.numtris / r.seconds : 0.0) << "}"
+            << ((i + 1 < (int) results.size()) ? ",\n" : "\n");
+    }
+    out << "]\n";
+    return (bool) out;
+}
+
+bool readBenchCSV(const std::string &filename, std::vector<BenchResult> &results)
+{
+    ifstream in(filename);
+    string line;
+
+    results.clear();
+    if(!in || !getline(in, line)) // header
+        return false;
+    while(getline(in, line))
+    {
+        stringstream row(line);
+        string numtris, seconds;
+        BenchResult r;
+        if(line.empty())
+            continue;
+        if(!getline(row, r.stage, ',') || !getline(row, numtris, ',') || !getline(row, seconds, ','))
+            return false;
+        r.numtris = atol(numtris.c_str());
+        r.seconds = atof(seconds.c_str());
+        results.push_back(r);
+    }
+    return true;
+}
+
+int compareBench(const std::vector<BenchResult> &results, const std::vector<BenchResult> &baseline,
+                 double tolerance, std::string &report)
+{
+    const double noise = 0.001;
+    stringstream out;
+    int regressions = 0;
+
+    for(const BenchResult &r: results)
+        for(const BenchResult &b: baseline)
+            if(r.stage == b.stage && r.numtris == b.numtris && r.seconds > b.seconds * (1.0 + tolerance) + noise)
+            {
+                out << r.stage << " on " << r.numtris << " triangles took " << r.seconds << "s against a baseline of "
+                    << b.seconds << "s\n";
+                regressions++;
+            }
+    report = out.str();
+    return regressions;
+}
+
+/**
+ * Generate a closed mesh of about the requested number of triangles. Implicit shapes have a triangle count
+ * growing with the square of the resolution, so one is first built at a low resolution to calibrate it.
+ * The icosphere takes the subdivision level nearest in size, which is within a factor of two.
+ * @param[out] mesh     generated mesh
+ * @param shape         "torus" for a genus 3 torus, "gyroid" for a cube of 4^3 gyroid cells or "sphere"
+ * @param numtris       number of triangles wanted
+ * @retval true  if the shape is known,
+ * @retval false otherwise
+ */
+static bool generateBenchMesh(Mesh &mesh, const std::string &shape, long numtris)
+{
+    const int calibration = 32;
+    vector<ShellStats> stats;
+
+    if(shape == "sphere")
+    {
+        int levels = max(0, (int) floor(log((double) numtris / 20.0) / log(4.0) + 0.5));
+        mesh.generateIcosphere(levels);
+        return true;
+    }
+    auto make = [&](int resolution)
+    {
+        if(shape == "torus")
+            mesh.generateTorus(3, resolution);
+        else
+            mesh.generateGyroid(4, resolution);
+    };
+    if(shape != "torus" && shape != "gyroid")
+        return false;
+    make(calibration);
+    mesh.shellStats(stats);
+    double scale = sqrt((double) numtris / (double) max(1, stats.empty() ? 0 : stats[0].numtris));
+    make(max(2, (int) (calibration * scale + 0.5)));
+    return true;
+}
+
+/// Insert a key unless present, returning the value stored for it
+static int insertKey(std::unordered_map<uint64_t, int> &map, uint64_t key, int value)
+{
+    return map.insert(std::make_pair(key, value)).first->second;
+}
+
+/// Insert a key unless present, returning the value stored for it
+static int insertKey(uts::flat_map<uint64_t, int> &map, uint64_t key, int value)
+{
+    return * map.insert(key, value).first;
+}
+
+/// Value of a key known to be present
+static int findKey(const std::unordered_map<uint64_t, int> &map, uint64_t key)
+{
+    return map.find(key)->second;
+}
+
+/// Value of a key known to be present
+static int findKey(const uts::flat_map<uint64_t, int> &map, uint64_t key)
+{
+    return * map.find(key);
+}
+
+/**
+ * Weld a vertex soup with a given map type, as mergeVerts does: each position is keyed by its coordinate bits
+ * and mapped to the first index it was seen at
+ * @param keys          position keys, one per vertex of each triangle
+ * @param[out] remap    index of the first occurrence of each key
+ * @param lookup        if true, also look every key up again afterwards, as edge lookups would
+ */
+template<typename Map>
+static void weldKeys(const std::vector<uint64_t> &keys, std::vector<int> &remap, bool lookup)
+{
+    Map map;
+
+    map.reserve(keys.size() / 4);
+    remap.resize(keys.size());
+    for(int i = 0; i < (int) keys.size(); i++)
+        remap[i] = insertKey(map, keys[i], i);
+    if(lookup)
+        for(int i = 0; i < (int) keys.size(); i++)
+            remap[i] = findKey(map, keys[i]);
+}
+
+void BenchMesh::benchPipeline()
+{
+    const boost::program_options::variables_map &vm = testGetOptions();
+    string sizelist = vm.count("bench-sizes") ? vm["bench-sizes"].as<string>() : "1K,10K,100K,1M,10M,50M";
+    string shape = vm.count("bench-shape") ? vm["bench-shape"].as<string>() : "torus";
+    string output = vm.count("bench-output") ? vm["bench-output"].as<string>() : "bench_mesh";
+    string baselinefile = vm.count("bench-baseline") ? vm["bench-baseline"].as<string>() : "";
+    double tolerance = vm.count("bench-tolerance") ? vm["bench-tolerance"].as<double>() : 0.25;
+    int repeats = vm.count("bench-repeats") ? vm["bench-repeats"].as<int>() : 3;
+    vector<BenchResult> results, baseline;
+    vector<long> sizes, timed;
+    TempDirectory tmpdir("bench_mesh_tmp");
+    string infile = "bench_mesh_tmp/in.stl", outfile = "bench_mesh_tmp/out.stl";
+
+    CPPUNIT_ASSERT_MESSAGE("bad --bench-sizes list " + sizelist, parseBenchSizes(sizelist, sizes));
+    for(long size: sizes)
+    {
+        Mesh source;
+        vector<ShellStats> stats;
+        vector<BenchResult> best;
+        long numtris = 0;
+
+        CPPUNIT_ASSERT_MESSAGE("bench size " + to_string(size) + " is beyond the generator limit of "
+                               + to_string(maxGeneratedTris) + " triangles", size <= maxGeneratedTris);
+        CPPUNIT_ASSERT_MESSAGE("unknown --bench-shape " + shape, generateBenchMesh(source, shape, size));
+        source.shellStats(stats);
+        for(const ShellStats &shell: stats)
+            numtris += shell.numtris;
+
+        // the timings must be of the size asked for, and each generated mesh is timed only once
+        double slack = (shape == "sphere") ? 2.0 : 1.25;
+        CPPUNIT_ASSERT_MESSAGE("generated " + to_string(numtris) + " triangles for a bench size of " + to_string(size),
+                               numtris >= (long) ((double) size / slack) && numtris <= (long) ((double) size * slack));
+        if(find(timed.begin(), timed.end(), numtris) != timed.end())
+        {
+            cout << "bench size " << size << " generates the same " << numtris << " triangles as an earlier size, skipped" << endl;
+            continue;
+        }
+        timed.push_back(numtris);
+        CPPUNIT_ASSERT(source.writeSTL(infile));
+
+        // every load must rebuild the generated mesh, or the timings are of the wrong work
+        int numverts = (int) source.getVerts().size();
+        bool basic = source.basicValidity(), manifold = source.manifoldValidity();
+        int euler = source.getEuler();
+        CPPUNIT_ASSERT(basic && manifold);
+        source.clear();
+
+        for(int rep = 0; rep < max(1, repeats); rep++)
+        {
+            Mesh mesh;
+            vector<Edge> edges;
+            int stage = 0;
+            bool valid = false;
+            vector<uint64_t> keys;
+            vector<int> remap;
+            Timer timer;
+
+            // time one stage and keep the best over the repeats
+            auto run = [&](const char * name, const std::function<void()> &body)
+            {
+                timer.start();
+                body();
+                timer.stop();
+                if(rep == 0)
+                    best.push_back(BenchResult{name, numtris, (double) timer.peek()});
+                else
+                    best[stage].seconds = min(best[stage].seconds, (double) timer.peek());
+                stage++;
+            };
+
+            // readSTL is parseSTL followed by mergeVerts and deriveVertNorms, so its parts are timed separately
+            run("parseSTL", [&](){ CPPUNIT_ASSERT(mesh.parseSTL(infile)); });
+            CPPUNIT_ASSERT((long) mesh.getTris().size() == numtris);
+
+            // the hash tables behind mergeVerts and the edge lookups, standard against flat
+            for(const cgp::Point &pnt: mesh.getVerts())
+            {
+                uint32_t bits[3];
+                memcpy(bits, &pnt.x, sizeof(float)); memcpy(bits + 1, &pnt.y, sizeof(float)); memcpy(bits + 2, &pnt.z, sizeof(float));
+                keys.push_back(((uint64_t) bits[0] << 32 | bits[1]) ^ ((uint64_t) bits[2] * 0x9E3779B97F4A7C15ULL));
+            }
+            run("stdMapWeld", [&](){ weldKeys<std::unordered_map<uint64_t, int> >(keys, remap, false); });
+            run("flatMapWeld", [&](){ weldKeys<uts::flat_map<uint64_t, int> >(keys, remap, false); });
+            run("stdMapLookup", [&](){ weldKeys<std::unordered_map<uint64_t, int> >(keys, remap, true); });
+            run("flatMapLookup", [&](){ weldKeys<uts::flat_map<uint64_t, int> >(keys, remap, true); });
+            keys.clear();
+            run("mergeVerts", [&](){ mesh.mergeVerts(); });
+            CPPUNIT_ASSERT((int) mesh.getVerts().size() == numverts && (long) mesh.getTris().size() == numtris);
+            run("deriveVertNorms", [&](){ mesh.deriveVertNorms(); });
+            run("createEdges", [&](){ edges = mesh.createEdges(); });
+            edges.clear();
+            run("basicValidity", [&](){ valid = mesh.basicValidity(); });
+            CPPUNIT_ASSERT(valid == basic && mesh.getEuler() == euler);
+            run("manifoldValidity", [&](){ valid = mesh.manifoldValidity(); });
+            CPPUNIT_ASSERT(valid == manifold);
+            run("writeSTL", [&](){ CPPUNIT_ASSERT(mesh.writeSTL(outfile)); });
+        }
+        for(const BenchResult &r: best)
+        {
+            stringstream line;
+            line << setw(18) << left << r.stage << setw(12) << right << r.numtris << setw(12) << fixed << setprecision(4)
+                 << r.seconds << "s";
+            cout << line.str() << endl;
+        }
+        results.insert(results.end(), best.begin(), best.end());
+    }
+
+    CPPUNIT_ASSERT(writeBenchCSV(output + ".csv", results));
+    CPPUNIT_ASSERT(writeBenchJSON(output + ".json", results));
+    if(!baselinefile.empty())
+    {
+        string report;
+        CPPUNIT_ASSERT_MESSAGE("cannot read baseline " + baselinefile, readBenchCSV(baselinefile, baseline));
+        int regressions = compareBench(results, baseline, tolerance, report);
+        CPPUNIT_ASSERT_MESSAGE(report, regressions == 0);
+    }
+}
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(BenchMesh, TestSet::perNightly());
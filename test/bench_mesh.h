@@ -0,0 +1,92 @@
+#ifndef TILER_BENCH_MESH_H
+#define TILER_BENCH_MESH_H
+
+#include <string>
+#include <vector>
+#include <cppunit/extensions/HelperMacros.h>
+#include "tesselate/mesh.h"
+
+/**
+ * Timing of one stage of the mesh pipeline on a mesh of a given size
+ */
+struct BenchResult
+{
+    std::string stage;  ///< name of the Mesh method or hash table operation timed
+    long numtris;       ///< triangles in the generated mesh
+    double seconds;     ///< best elapsed time over the repeats
+};
+
+/**
+ * Benchmarks for the mesh loading and validation pipeline, run in the nightly suite. Procedurally generated
+ * closed meshes of increasing size are written to STL and each stage is timed in turn. Each generated mesh must
+ * be close to the size asked for, and sizes beyond ::maxGeneratedTris fail. Results are written as CSV and
+ * JSON and, if a baseline CSV is given, compared against it. The options are described in tilertest.
+ */
+class BenchMesh : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(BenchMesh);
+    CPPUNIT_TEST(benchPipeline);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+
+    /**
+     * Time parseSTL, mergeVerts, deriveVertNorms, createEdges, basicValidity, manifoldValidity and writeSTL, and
+     * welding the parsed vertices with std::unordered_map against uts::flat_map, with and without a second
+     * pass of lookups. Each load must reproduce the vertex and triangle counts, Euler characteristic and
+     * validity of the generated mesh.
+     */
+    void benchPipeline();
+};
+
+/**
+ * Parse a comma separated list of mesh sizes, each optionally suffixed by K or M for thousands or millions
+ * @param list      sizes such as "1K,10K,2M"
+ * @param[out] sizes    triangle counts, in the order given with repeats dropped
+ * @retval true  if every entry is a positive count,
+ * @retval false otherwise
+ */
+bool parseBenchSizes(const std::string &list, std::vector<long> &sizes);
+
+/**
+ * Write benchmark results as CSV, one row per stage and size with the columns stage, triangles, seconds and
+ * triangles per second
+ * @param filename  file to write
+ * @param results   timings to write
+ * @retval true  if the file is written,
+ * @retval false otherwise
+ */
+bool writeBenchCSV(const std::string &filename, const std::vector<BenchResult> &results);
+
+/**
+ * Write benchmark results as a JSON array of objects with the same fields as @ref writeBenchCSV
+ * @param filename  file to write
+ * @param results   timings to write
+ * @retval true  if the file is written,
+ * @retval false otherwise
+ */
+bool writeBenchJSON(const std::string &filename, const std::vector<BenchResult> &results);
+
+/**
+ * Read results written by @ref writeBenchCSV
+ * @param filename      file to read
+ * @param[out] results  timings read
+ * @retval true  if the file is read,
+ * @retval false otherwise
+ */
+bool readBenchCSV(const std::string &filename, std::vector<BenchResult> &results);
+
+/**
+ * Compare results against a baseline. A stage regresses if it is slower than its baseline time for the same
+ * size by more than the tolerance, ignoring differences below a millisecond which are timer noise.
+ * Stages or sizes missing from either list are not compared.
+ * @param results       current timings
+ * @param baseline      reference timings
+ * @param tolerance     allowed slowdown as a fraction of the baseline time
+ * @param[out] report   one line for each regression
+ * @retval number of regressions
+ */
+int compareBench(const std::vector<BenchResult> &results, const std::vector<BenchResult> &baseline,
+                 double tolerance, std::string &report);
+
+#endif /* !TILER_BENCH_MESH_H */
@@ -4,9 +4,24 @@
 
 #include <test/testutil.h>
 #include "test_mesh.h"
+#include "tesselate/voxel.h"
+#include "tesselate/sdf.h"
+#include "tesselate/halfedge.h"
+#include <common/timer.h>
+#include <common/stats.h>
+#include <common/parallel.h>
+#include <common/arena.h>
+#include <common/flat_map.h>
 #include <stdio.h>
+#include <cmath>
 #include <cstdint>
 #include <sstream>
+#include <fstream>
+#include <map>
+#include <unordered_map>
+#include <random>
+#include <atomic>
+#include <functional>
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/extensions/HelperMacros.h>
 
@@ -64,12 +79,10 @@ void TestMesh::testEulerCharacteristic(){
 
 void TestMesh::testDanglingVert(){
 	mesh->readSTL("../meshes/cube.stl");
-	vector<cgp::Point> verts = mesh->getVerts();
-	cgp::Point point = verts[0];
+	cgp::Point point = mesh->getVerts()[0];
 	point.x = point.x - 20;
 	point.y = point.y - 20;
-	verts.push_back(point);
-	mesh->setVerts(verts);
+	mesh->appendVerts({point});
 	CPPUNIT_ASSERT(!mesh->basicValidity());
 }
 
@@ -77,24 +90,901 @@ void TestMesh::testEdgeBounds(){
 	mesh->readSTL("../meshes/cube.stl");
 	vector<Edge> edges = mesh->getEdges();
 	Edge tempedge;
-	vector<cgp::Point> verts = mesh->getVerts();
+	const vector<cgp::Point> &verts = mesh->getVerts();
 	cgp::Point point1 = verts[0];
 	point1.x = point1.x - 20;
 	point1.y = point1.y + 80;
 	cgp::Point point2 = verts[1];
 	point2.x = point2.x + 50;
 	point2.y = point2.y - 20;
-	verts.push_back(point1);
-	tempedge.v[0] = verts.size()-1;
-	verts.push_back(point2);
-	tempedge.v[1] = verts.size()-1;
+	tempedge.v[0] = mesh->appendVerts({point1, point2});
+	tempedge.v[1] = tempedge.v[0] + 1;
 	edges.push_back(tempedge);
-	mesh->setVerts(verts);
 	CPPUNIT_ASSERT(!mesh->checkEdgeBound(edges));
 	CPPUNIT_ASSERT(!mesh->basicValidity());
 }
 
 
+void TestMesh::testValidationPolicy(){
+	MeshValidity full, background;
+
+	mesh->readSTL("../meshes/bunny.stl", ValidationPolicy::OFF);
+	CPPUNIT_ASSERT(!mesh->getValidity().tested);
+
+	mesh->validate(ValidationPolicy::FULL);
+	full = mesh->getValidity();
+	mesh->validate(ValidationPolicy::BACKGROUND);
+	background = mesh->getValidity();
+	CPPUNIT_ASSERT(full.tested && background.tested);
+	CPPUNIT_ASSERT(full.basic && !full.manifold); // bunny has known holes in the bottom
+	CPPUNIT_ASSERT(background.basic == full.basic && background.manifold == full.manifold);
+	CPPUNIT_ASSERT(background.euler == full.euler);
+
+	// the Euler characteristic of a background validation is available without first asking for the results
+	mesh->readSTL("../meshes/torus.stl", ValidationPolicy::OFF);
+	mesh->validate(ValidationPolicy::BACKGROUND);
+	CPPUNIT_ASSERT(full.euler != 0 && mesh->getEuler() == 0);
+
+	// cancelling waits for the worker, so the results are settled as soon as it returns
+	mesh->validate(ValidationPolicy::BACKGROUND);
+	mesh->cancelValidation();
+	CPPUNIT_ASSERT(mesh->validityReady());
+}
+
+void TestMesh::testShells(){
+	vector<ShellStats> stats;
+	vector<Mesh> shells;
+	vector<int> label;
+
+	mesh->readSTL("../meshes/sphere.stl");
+	CPPUNIT_ASSERT(mesh->labelShells(label) == 1);
+	mesh->shellStats(stats, 3);
+	CPPUNIT_ASSERT(stats.size() == 1);
+	CPPUNIT_ASSERT(stats[0].closed);
+	CPPUNIT_ASSERT(stats[0].volume > 0.0 && stats[0].area > 0.0);
+	mesh->splitShells(shells);
+	CPPUNIT_ASSERT(shells.size() == 1);
+	CPPUNIT_ASSERT(shells[0].getVerts().size() == mesh->getVerts().size());
+	CPPUNIT_ASSERT(shells[0].manifoldValidity());
+
+	mesh->readSTL("../meshes/bunny.stl");
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 1);
+	CPPUNIT_ASSERT(!stats[0].closed); // bunny has known holes in the bottom
+
+	// partial sums are taken over fixed blocks, so the statistics are bitwise identical for any thread count
+	// two spheres of 20480 and 5120 triangles, so that blocks span both shells
+	vector<ShellStats> serial;
+	Mesh other;
+	mesh->generateIcosphere(5);
+	other.generateIcosphere(4);
+	int first = mesh->appendVerts(other.getVerts());
+	mesh->transformVerts([first](int v, cgp::Point &p){
+		if(v >= first)
+			p.x += 3.0f;
+	});
+	for(Triangle t: other.getTris()){
+		for(int i = 0; i < 3; i++)
+			t.v[i] += first;
+		mesh->tris.push_back(t);
+	}
+	mesh->chargeMemory();
+	mesh->shellStats(serial, 1);
+	mesh->shellStats(stats, 5);
+	CPPUNIT_ASSERT(serial.size() == 2 && stats.size() == serial.size());
+	CPPUNIT_ASSERT(serial[0].numtris == 20480 && serial[1].numtris == 5120);
+	CPPUNIT_ASSERT(serial[0].closed && serial[1].closed);
+	for(int s = 0; s < (int) stats.size(); s++){
+		CPPUNIT_ASSERT(stats[s].numtris == serial[s].numtris && stats[s].closed == serial[s].closed);
+		CPPUNIT_ASSERT(stats[s].volume == serial[s].volume && stats[s].area == serial[s].area);
+	}
+}
+
+void TestMesh::testMassProperties(){
+	MassProperties serial, threaded;
+	vector<ShellStats> stats;
+
+	mesh->readSTL("../meshes/torus.stl");
+	mesh->massProperties(serial, 1);
+	mesh->massProperties(threaded, 7);
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(serial.volume > 0.0);
+	CPPUNIT_ASSERT(fabs(serial.volume - stats[0].volume) <= 1e-6 * serial.volume);
+	CPPUNIT_ASSERT(fabs(serial.area - stats[0].area) <= 1e-6 * serial.area);
+	CPPUNIT_ASSERT(serial.centroid[0] >= stats[0].bbox.min.x && serial.centroid[0] <= stats[0].bbox.max.x);
+	CPPUNIT_ASSERT(serial.inertia[0][0] > 0.0 && serial.inertia[1][1] > 0.0 && serial.inertia[2][2] > 0.0);
+	CPPUNIT_ASSERT(serial.inertia[0][1] == serial.inertia[1][0]);
+
+	// fixed summation order makes the result bitwise identical
+	CPPUNIT_ASSERT(serial.volume == threaded.volume && serial.area == threaded.area);
+	for(int i = 0; i < 3; i++){
+		CPPUNIT_ASSERT(serial.centroid[i] == threaded.centroid[i]);
+		for(int j = 0; j < 3; j++)
+			CPPUNIT_ASSERT(serial.inertia[i][j] == threaded.inertia[i][j]);
+	}
+}
+
+void TestMesh::testRepair(){
+	RepairReport report;
+	vector<ShellStats> stats;
+
+	mesh->readSTL("../meshes/bunny.stl");
+	mesh->repair(report);
+	CPPUNIT_ASSERT(report.holes > 0 && report.filltris > 0);
+	CPPUNIT_ASSERT(report.unfilled == 0);
+	CPPUNIT_ASSERT(mesh->basicValidity());
+	CPPUNIT_ASSERT(mesh->manifoldValidity());
+	mesh->shellStats(stats);
+	for(int s = 0; s < (int) stats.size(); s++)
+		CPPUNIT_ASSERT(stats[s].closed && stats[s].volume > 0.0);
+
+	mesh->readSTL("../meshes/sphere.stl");
+	int numverts = (int) mesh->getVerts().size();
+	mesh->repair(report);
+	CPPUNIT_ASSERT(report.degenerate == 0 && report.duplicates == 0 && report.flipped == 0);
+	CPPUNIT_ASSERT(report.holes == 0 && report.filltris == 0);
+	CPPUNIT_ASSERT((int) mesh->getVerts().size() == numverts);
+}
+
+void TestMesh::testSelfIntersection(){
+	vector<std::pair<int, int>> pairs;
+	cgp::Point a(0.0f, 0.0f, 0.0f), b(2.0f, 0.0f, 0.0f), c(0.0f, 2.0f, 0.0f);
+
+	// piercing, separated, touching at a vertex and overlapping coplanar triangles
+	CPPUNIT_ASSERT(triTriIntersect(a, b, c, cgp::Point(0.5f, 0.5f, -1.0f), cgp::Point(0.5f, 0.5f, 1.0f), cgp::Point(3.0f, 3.0f, 0.0f)));
+	CPPUNIT_ASSERT(!triTriIntersect(a, b, c, cgp::Point(0.0f, 0.0f, 1.0f), cgp::Point(2.0f, 0.0f, 1.0f), cgp::Point(0.0f, 2.0f, 1.0f)));
+	CPPUNIT_ASSERT(triTriIntersect(a, b, c, cgp::Point(2.0f, 0.0f, 0.0f), cgp::Point(3.0f, 0.0f, 1.0f), cgp::Point(3.0f, 1.0f, 1.0f)));
+	CPPUNIT_ASSERT(triTriIntersect(a, b, c, cgp::Point(0.5f, 0.5f, 0.0f), cgp::Point(3.0f, 0.5f, 0.0f), cgp::Point(0.5f, 3.0f, 0.0f)));
+
+	// segments through and beside the triangle, in and out of its plane, and triangles on a shared edge
+	CPPUNIT_ASSERT(segTriIntersect(cgp::Point(0.5f, 0.5f, -1.0f), cgp::Point(0.5f, 0.5f, 1.0f), a, b, c));
+	CPPUNIT_ASSERT(segTriIntersect(cgp::Point(-1.0f, 0.5f, 0.0f), cgp::Point(3.0f, 0.5f, 0.0f), a, b, c));
+	CPPUNIT_ASSERT(!segTriIntersect(cgp::Point(-1.0f, 3.0f, 0.0f), cgp::Point(3.0f, 3.0f, 0.0f), a, b, c));
+	CPPUNIT_ASSERT(foldedOver(a, b, c, cgp::Point(1.0f, 0.5f, 0.0f)));
+	CPPUNIT_ASSERT(!foldedOver(a, b, c, cgp::Point(1.0f, -0.5f, 0.0f)));
+	CPPUNIT_ASSERT(!foldedOver(a, b, c, cgp::Point(1.0f, 0.5f, 0.5f)));
+
+	mesh->readSTL("../meshes/torus.stl");
+	CPPUNIT_ASSERT(mesh->selfIntersections(pairs) == IntersectionSearch::NONE);
+	CPPUNIT_ASSERT(pairs.empty());
+	CPPUNIT_ASSERT(mesh->selfIntersections(pairs, true, 3) == IntersectionSearch::NONE);
+
+	// pushing a corner of the unit cube through the opposite face drives its triangles through their neighbours
+	mesh->readSTL("../meshes/cube.stl");
+	mesh->transformVerts([](int, cgp::Point &p){
+		if(p.x == 1.0f && p.y == 1.0f && p.z == 1.0f)
+			p = cgp::Point(0.5f, 0.5f, -0.5f);
+	});
+	CPPUNIT_ASSERT(mesh->selfIntersections(pairs) == IntersectionSearch::FOUND);
+	bool adjacent = false;
+	for(auto &pr: pairs)
+		for(int i = 0; i < 3; i++)
+			for(int j = 0; j < 3; j++)
+				if(mesh->getTris()[pr.first].v[i] == mesh->getTris()[pr.second].v[j])
+					adjacent = true;
+	CPPUNIT_ASSERT(adjacent);
+}
+
+void TestMesh::testVoxelise(){
+	VoxelGrid grid, serial;
+	MassProperties props, voxprops;
+	vector<ShellStats> stats;
+	Mesh voxmesh;
+	long solid = 0;
+
+	mesh->readSTL("../meshes/sphere.stl");
+	mesh->massProperties(props);
+	mesh->voxelise(grid, 48);
+	mesh->voxelise(serial, 48, 1);
+	for(int i = 0; i < grid.dims[0]; i++)
+		for(int j = 0; j < grid.dims[1]; j++)
+			for(int k = 0; k < grid.dims[2]; k++){
+				solid += grid.cells.get(i, j, k);
+				CPPUNIT_ASSERT(grid.cells.get(i, j, k) == serial.cells.get(i, j, k));
+			}
+	double voxvolume = (double) solid * grid.voxelsize * grid.voxelsize * grid.voxelsize;
+	CPPUNIT_ASSERT(fabs(voxvolume - props.volume) < 0.05 * props.volume);
+
+	voxmesh.fromVoxels(grid);
+	voxmesh.shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 1);
+	CPPUNIT_ASSERT(stats[0].closed);
+	voxmesh.massProperties(voxprops);
+	CPPUNIT_ASSERT(fabs(voxprops.volume - props.volume) < 0.05 * props.volume);
+
+	// a fine voxelisation holds its interior as tiles, which polygonise to the same closed surface
+	mesh->voxelise(grid, 256);
+	CPPUNIT_ASSERT(grid.cells.numTiles() > 0);
+	CPPUNIT_ASSERT(grid.cells.get(grid.dims[0] / 2, grid.dims[1] / 2, grid.dims[2] / 2) == 1);
+	voxmesh.fromVoxels(grid);
+	voxmesh.shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 1);
+	CPPUNIT_ASSERT(stats[0].closed);
+	voxmesh.massProperties(voxprops);
+	CPPUNIT_ASSERT(fabs(voxprops.volume - props.volume) < 0.02 * props.volume);
+}
+
+void TestMesh::testHollow(){
+	DistanceGrid grid;
+	MassProperties props, hollowprops;
+	vector<ShellStats> stats;
+
+	// a sphere, whose radius is taken as that of a ball of equal volume: samples beyond the band are clamped
+	mesh->readSTL("../meshes/sphere.stl");
+	mesh->massProperties(props);
+	double radius = cbrt(3.0 * props.volume / (4.0 * PI));
+	float wall = 0.2f * (float) radius;
+	mesh->distanceField(grid, 0.25f * wall, wall);
+	int ci = (int) ((props.centroid[0] - grid.origin.x) / grid.voxelsize), cj = (int) ((props.centroid[1] - grid.origin.y) / grid.voxelsize),
+		ck = (int) ((props.centroid[2] - grid.origin.z) / grid.voxelsize);
+	CPPUNIT_ASSERT(fabs(grid.dist.get(ci, cj, ck) + wall) < 1e-6f); // centre, beyond the band
+	CPPUNIT_ASSERT(grid.dist.get(0, 0, 0) == wall);
+
+	CPPUNIT_ASSERT(mesh->hollow(wall));
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 2);
+	CPPUNIT_ASSERT(stats[0].closed && stats[1].closed);
+	CPPUNIT_ASSERT(stats[1].volume < 0.0); // faces into the cavity
+	double cavity = 4.0 / 3.0 * PI * pow(radius - wall, 3.0);
+	CPPUNIT_ASSERT(fabs(-stats[1].volume - cavity) < 0.05 * cavity);
+	mesh->massProperties(hollowprops);
+	CPPUNIT_ASSERT(fabs(hollowprops.volume - (props.volume + stats[1].volume)) < 1e-3 * props.volume);
+
+	// too thick to leave a cavity
+	mesh->readSTL("../meshes/sphere.stl");
+	CPPUNIT_ASSERT(!mesh->hollow(1.5f * (float) radius));
+}
+
+void TestMesh::testOffset(){
+	MassProperties props, offsetprops;
+	vector<ShellStats> stats;
+
+	// small offsets move the faces of a cube by exactly the distance
+	mesh->readSTL("../meshes/cube.stl");
+	CPPUNIT_ASSERT(mesh->offset(0.05f));
+	mesh->massProperties(offsetprops);
+	CPPUNIT_ASSERT(fabs(offsetprops.volume - 1.1 * 1.1 * 1.1) < 1e-4);
+	mesh->readSTL("../meshes/cube.stl");
+	vector<Triangle> before = mesh->getTris();
+	size_t numverts = mesh->getVerts().size();
+	CPPUNIT_ASSERT(mesh->offset(-0.05f));
+	mesh->massProperties(offsetprops);
+	CPPUNIT_ASSERT(fabs(offsetprops.volume - 0.9 * 0.9 * 0.9) < 1e-4);
+	// vertices keep their indices rather than being welded afresh
+	CPPUNIT_ASSERT(mesh->getVerts().size() == numverts);
+	CPPUNIT_ASSERT(mesh->getTris().size() == before.size());
+	for(int t = 0; t < (int) before.size(); t++)
+		for(int p = 0; p < 3; p++)
+			CPPUNIT_ASSERT(mesh->getTris()[t].v[p] == before[t].v[p]);
+
+	// a large offset of the unit sphere goes through the distance field and stays closed
+	mesh->readSTL("../meshes/sphere.stl");
+	mesh->massProperties(props);
+	CPPUNIT_ASSERT(mesh->offset(0.3f));
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 1);
+	CPPUNIT_ASSERT(stats[0].closed);
+	mesh->massProperties(offsetprops);
+	CPPUNIT_ASSERT(fabs(offsetprops.volume - props.volume * 1.3 * 1.3 * 1.3) < 0.02 * offsetprops.volume);
+
+	// an inward offset past the centre leaves nothing
+	mesh->readSTL("../meshes/sphere.stl");
+	CPPUNIT_ASSERT(!mesh->offset(-1.5f));
+}
+
+void TestMesh::testBoolean(){
+	Mesh other;
+	MassProperties props;
+	vector<ShellStats> stats;
+
+	// place a copy of the unit cube scaled by s with its minimum corner at (d, d, d)
+	auto place = [&other](float s, float d){
+		other.readSTL("../meshes/cube.stl", ValidationPolicy::OFF);
+		other.transformVerts([s, d](int, cgp::Point &p){
+			p = cgp::Point(p.x * s + d, p.y * s + d, p.z * s + d);
+		});
+	};
+
+	// overlapping: through the distance field, with volumes within voxel rounding
+	const BooleanOp ops[3] = {BooleanOp::UNION, BooleanOp::INTERSECTION, BooleanOp::DIFFERENCE};
+	const double overlapvol[3] = {1.875, 0.125, 0.875};
+	for(int o = 0; o < 3; o++){
+		mesh->readSTL("../meshes/cube.stl", ValidationPolicy::OFF);
+		place(1.0f, 0.5f);
+		CPPUNIT_ASSERT(mesh->boolean(other, ops[o], 0.02f));
+		mesh->shellStats(stats);
+		CPPUNIT_ASSERT(stats.size() == 1);
+		CPPUNIT_ASSERT(stats[0].closed);
+		mesh->massProperties(props);
+		CPPUNIT_ASSERT(fabs(props.volume - overlapvol[o]) < 0.01);
+	}
+
+	// disjoint: exact, by whole shells
+	mesh->readSTL("../meshes/cube.stl", ValidationPolicy::OFF);
+	place(1.0f, 2.0f);
+	CPPUNIT_ASSERT(!mesh->boolean(other, BooleanOp::INTERSECTION));
+	CPPUNIT_ASSERT(mesh->boolean(other, BooleanOp::UNION));
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 2);
+
+	// nested: the difference leaves an inward facing cavity
+	mesh->readSTL("../meshes/cube.stl", ValidationPolicy::OFF);
+	place(0.5f, 0.25f);
+	CPPUNIT_ASSERT(mesh->boolean(other, BooleanOp::DIFFERENCE));
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 2);
+	mesh->massProperties(props);
+	CPPUNIT_ASSERT(fabs(props.volume - 0.875) < 1e-5);
+
+	// combined fields keep the interiors of the operands as tiles and uniform bricks
+	DistanceGrid fielda, fieldb, combined;
+	int dense = 0, densea = 0, denseb = 0;
+	auto countDense = [](int &count){
+		return [&count](int, int, int, const SparseGrid<float>::Brick &brick){ count += brick.data ? 1 : 0; };
+	};
+	mesh->readSTL("../meshes/sphere.stl", ValidationPolicy::OFF);
+	mesh->distanceField(fielda, 0.01f, 0.03f);
+	other.readSTL("../meshes/sphere.stl", ValidationPolicy::OFF);
+	other.transformVerts([](int, cgp::Point &p){ p.x += 0.5f; });
+	fieldb.origin = fielda.origin;
+	fieldb.voxelsize = fielda.voxelsize;
+	fieldb.bandwidth = fielda.bandwidth;
+	fillDistances(other.getVerts(), other.getTris(), fieldb);
+	combineDistances(fielda, fieldb, BooleanOp::UNION, combined);
+	CPPUNIT_ASSERT(combined.dist.numTiles() > 0);
+	fielda.dist.forEachBrick(countDense(densea));
+	fieldb.dist.forEachBrick(countDense(denseb));
+	combined.dist.forEachBrick(countDense(dense));
+	CPPUNIT_ASSERT(dense <= densea + denseb);
+	CPPUNIT_ASSERT(combined.dist.get(combined.dims[0] / 2, combined.dims[1] / 2, combined.dims[2] / 2) == -fielda.bandwidth);
+}
+
+void TestMesh::testSubdivide(){
+	MassProperties props;
+	vector<ShellStats> stats;
+
+	mesh->readSTL("../meshes/sphere.stl");
+	CPPUNIT_ASSERT(mesh->subdivide(0.001f) > 0);
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 1);
+	CPPUNIT_ASSERT(stats[0].closed);
+	CPPUNIT_ASSERT(stats[0].numtris > 960);
+	for(auto &p: mesh->getVerts())
+		CPPUNIT_ASSERT(fabs(sqrt(p.x * p.x + p.y * p.y + p.z * p.z) - 1.0f) < 0.001f);
+	mesh->massProperties(props);
+	CPPUNIT_ASSERT(fabs(props.volume - 4.0 / 3.0 * PI) < 0.01);
+
+	// every edge of a cube is either a crease or flat
+	mesh->readSTL("../meshes/cube.stl");
+	CPPUNIT_ASSERT(mesh->subdivide(0.001f) == 0);
+}
+
+void TestMesh::testSmooth(){
+	MassProperties before, after;
+
+	// radial deviation of the vertices from the unit sphere
+	auto deviation = [this](){
+		double sum = 0.0;
+		const vector<cgp::Point> &pnts = mesh->getVerts();
+		for(auto &p: pnts){
+			double r = sqrt(p.x * p.x + p.y * p.y + p.z * p.z) - 1.0;
+			sum += r * r;
+		}
+		return sqrt(sum / (double) pnts.size());
+	};
+
+	// refine the sphere and add repeatable radial noise of up to 1%
+	mesh->readSTL("../meshes/sphere.stl");
+	mesh->subdivide(0.0005f);
+	mesh->transformVerts([](int i, cgp::Point &p){
+		float s = 1.0f + 0.02f * (float) ((i * 7919) % 1000) / 1000.0f - 0.01f;
+		p = cgp::Point(p.x * s, p.y * s, p.z * s);
+	});
+	mesh->massProperties(before);
+	double noise = deviation();
+	mesh->smooth(10);
+	mesh->massProperties(after);
+	CPPUNIT_ASSERT(deviation() < 0.5 * noise);
+	CPPUNIT_ASSERT(fabs(after.volume - before.volume) < 0.01 * before.volume);
+
+	// a unit cube with each face split into a grid of 4x4 squares, written out and read back
+	TempDirectory tmpdir("smooth_tmp");
+	{
+		const int n = 4;
+		std::ofstream out("smooth_tmp/gridcube.stl", std::ios::binary);
+		char header[80] = {0};
+		uint32_t numtris = 6 * n * n * 2;
+		uint16_t attribute = 0;
+		out.write(header, 80);
+		out.write((const char *) &numtris, sizeof(numtris));
+		for(int axis = 0; axis < 3; axis++)
+			for(int side = 0; side < 2; side++)
+				for(int a = 0; a < n; a++)
+					for(int b = 0; b < n; b++){
+						// corners of the square in the face's (u, v) coordinates, wound outward
+						float u[4] = {(float) a / n, (float) (a + 1) / n, (float) (a + 1) / n, (float) a / n};
+						float v[4] = {(float) b / n, (float) b / n, (float) (b + 1) / n, (float) (b + 1) / n};
+						int order[2][3] = {{0, 1, 2}, {0, 2, 3}};
+						for(int t = 0; t < 2; t++){
+							float rec[12] = {0.0f};
+							for(int c = 0; c < 3; c++){
+								int q = order[t][side ? c : 2 - c];
+								rec[3 + 3 * c + axis] = (float) side;
+								rec[3 + 3 * c + (axis + 1) % 3] = u[q];
+								rec[3 + 3 * c + (axis + 2) % 3] = v[q];
+							}
+							out.write((const char *) rec, sizeof(rec));
+							out.write((const char *) &attribute, sizeof(attribute));
+						}
+					}
+	}
+	CPPUNIT_ASSERT(mesh->readSTL("smooth_tmp/gridcube.stl"));
+	CPPUNIT_ASSERT(mesh->getVerts().size() == 6 * 3 * 3 + 12 * 3 + 8);
+
+	// jitter the vertices within their faces and along their edges, then smooth with the cube edges as features
+	auto bound = [](float c){ return c == 0.0f || c == 1.0f; };
+	mesh->transformVerts([&bound](int i, cgp::Point &p){
+		float * c[3] = {&p.x, &p.y, &p.z};
+		for(int a = 0; a < 3; a++)
+			if(!bound(* c[a]))
+				* c[a] += 0.05f * (float) (((i + a) * 7919) % 100) / 100.0f - 0.025f;
+	});
+	vector<cgp::Point> jittered = mesh->getVerts();
+	mesh->smooth(5, 0.5f, -0.53f, 30.0f);
+	mesh->massProperties(after);
+	CPPUNIT_ASSERT(fabs(after.volume - 1.0) < 1e-5);
+
+	// corners stay put, edge vertices stay on their edges and face vertices on their (planar) faces
+	bool moved = false;
+	for(int v = 0; v < (int) jittered.size(); v++){
+		const cgp::Point &p = jittered[v], &q = mesh->getVerts()[v];
+		float pc[3] = {p.x, p.y, p.z}, qc[3] = {q.x, q.y, q.z};
+		for(int a = 0; a < 3; a++){
+			if(bound(pc[a]))
+				CPPUNIT_ASSERT(qc[a] == pc[a]);
+			else
+				CPPUNIT_ASSERT(qc[a] > 0.0f && qc[a] < 1.0f);
+			moved = moved || qc[a] != pc[a];
+		}
+	}
+	CPPUNIT_ASSERT(moved);
+}
+
+void TestMesh::testRemesh(){
+	vector<ShellStats> before, after;
+	RemeshReport report;
+
+	// a sphere remeshed at a tenth of its radius stays closed and round, with about 4 pi / (0.1^2 sqrt(3) / 4) triangles
+	mesh->readSTL("../meshes/sphere.stl");
+	mesh->shellStats(before);
+	mesh->remesh(0.1f, 5, report);
+	mesh->shellStats(after);
+	CPPUNIT_ASSERT((int) after.size() == 1);
+	CPPUNIT_ASSERT(after[0].closed);
+	CPPUNIT_ASSERT(fabs(after[0].volume - before[0].volume) < 0.02 * before[0].volume);
+	CPPUNIT_ASSERT(after[0].numtris > 2000 && after[0].numtris < 4000);
+	CPPUNIT_ASSERT(report.splits > 0 && report.collapses > 0 && report.flips > 0);
+	CPPUNIT_ASSERT(mesh->basicValidity() && mesh->manifoldValidity());
+
+	// flat cube faces stay flat, so the volume is unchanged
+	mesh->readSTL("../meshes/cube.stl");
+	mesh->remesh(0.2f, 3, report);
+	mesh->shellStats(after);
+	CPPUNIT_ASSERT(after[0].closed);
+	CPPUNIT_ASSERT(fabs(after[0].volume - 1.0) < 1e-4);
+
+	// creases are kept sharp: the corners survive, the edges gain vertices and no triangle bends around an edge
+	const vector<cgp::Point> &verts = mesh->getVerts();
+	auto coord = [](const cgp::Point &p, int d){ return (d == 0) ? p.x : ((d == 1) ? p.y : p.z); };
+	int corners = 0, edgeverts = 0;
+	for(const cgp::Point &p: verts){
+		int onface = 0;
+		for(int d = 0; d < 3; d++)
+			if(coord(p, d) == 0.0f || coord(p, d) == 1.0f)
+				onface++;
+		CPPUNIT_ASSERT(onface > 0);
+		if(onface == 3)
+			corners++;
+		else if(onface == 2)
+			edgeverts++;
+	}
+	CPPUNIT_ASSERT(corners == 8);
+	CPPUNIT_ASSERT(edgeverts >= 12 * 3);
+	for(const Triangle &t: mesh->getTris()){
+		bool flat = false;
+		for(int d = 0; d < 3; d++){
+			float c0 = coord(verts[t.v[0]], d);
+			if((c0 == 0.0f || c0 == 1.0f) && coord(verts[t.v[1]], d) == c0 && coord(verts[t.v[2]], d) == c0)
+				flat = true;
+		}
+		CPPUNIT_ASSERT(flat);
+	}
+
+	// with creases ignored the same remesh rounds the edges over
+	mesh->readSTL("../meshes/cube.stl");
+	mesh->remesh(0.2f, 3, report, 0.0f);
+	corners = 0;
+	for(const cgp::Point &p: mesh->getVerts())
+		if((p.x == 0.0f || p.x == 1.0f) && (p.y == 0.0f || p.y == 1.0f) && (p.z == 0.0f || p.z == 1.0f))
+			corners++;
+	CPPUNIT_ASSERT(corners < 8);
+}
+
+void TestMesh::testGenerators(){
+	vector<ShellStats> stats;
+	vector<cgp::Point> first;
+
+	// icosphere: 20 * 4^3 triangles, Euler characteristic 2, close to the volume of the unit sphere
+	mesh->generateIcosphere(3);
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 1 && stats[0].closed);
+	CPPUNIT_ASSERT(stats[0].numtris == 1280);
+	CPPUNIT_ASSERT((int) mesh->getVerts().size() - stats[0].numtris / 2 == 2);
+	CPPUNIT_ASSERT(fabs(stats[0].volume - 4.0 * M_PI / 3.0) < 0.02 * 4.0 * M_PI / 3.0);
+
+	// rings of unit radius and tube radius 0.35: Euler characteristic 2 - 2g, volume a little under g times 2 pi^2 R r^2 where the rings overlap
+	for(int genus = 1; genus <= 3; genus++){
+		mesh->generateTorus(genus, 24);
+		mesh->shellStats(stats);
+		CPPUNIT_ASSERT(stats.size() == 1 && stats[0].closed);
+		CPPUNIT_ASSERT((int) mesh->getVerts().size() - stats[0].numtris / 2 == 2 - 2 * genus);
+		CPPUNIT_ASSERT(stats[0].volume > 0.8 * genus * 2.0 * M_PI * M_PI * 0.35 * 0.35);
+	}
+
+	// gyroid lattice: a single closed shell, and the same mesh every time
+	mesh->generateGyroid(2, 12);
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 1 && stats[0].closed);
+	first = mesh->getVerts();
+	mesh->generateGyroid(2, 12, 1);
+	CPPUNIT_ASSERT(mesh->getVerts().size() == first.size());
+
+	// extracted surfaces survive a round trip through a file: welding on reading finds every vertex again
+	TempDirectory tmpdir("generate_tmp");
+	for(int shape = 0; shape < 2; shape++){
+		if(shape == 0)
+			mesh->generateTorus(3, 48);
+		else
+			mesh->generateGyroid(2, 12);
+		int numverts = (int) mesh->getVerts().size(), numtris = (int) mesh->getTris().size();
+		CPPUNIT_ASSERT(mesh->basicValidity() && mesh->manifoldValidity());
+		int euler = mesh->getEuler();
+		CPPUNIT_ASSERT(mesh->writeSTL("generate_tmp/shape.stl"));
+		CPPUNIT_ASSERT(mesh->readSTL("generate_tmp/shape.stl"));
+		CPPUNIT_ASSERT((int) mesh->getVerts().size() == numverts && (int) mesh->getTris().size() == numtris);
+		CPPUNIT_ASSERT(mesh->basicValidity() && mesh->getEuler() == euler);
+		CPPUNIT_ASSERT(mesh->manifoldValidity());
+	}
+
+	// doubling the resolution gives about four times the triangles, and a request beyond the limit gives none
+	mesh->generateTorus(3, 48);
+	int coarse = (int) mesh->getTris().size();
+	mesh->generateTorus(3, 96);
+	CPPUNIT_ASSERT((int) mesh->getTris().size() > 3 * coarse && (int) mesh->getTris().size() < 5 * coarse);
+	mesh->generateIcosphere(13);
+	CPPUNIT_ASSERT(mesh->getTris().empty() && mesh->getVerts().empty());
+	mesh->generateTorus(3, 100000);
+	CPPUNIT_ASSERT(mesh->getTris().empty());
+
+	// soup: 320 triangles less 4 holes, plus a quarter again in duplicates, welding back to the 162 vertices
+	mesh->generateIcosphere(2);
+	mesh->generateSoup(0.25f, 4, 7);
+	CPPUNIT_ASSERT(mesh->getVerts().size() == 3 * (316 + 79));
+	first = mesh->getVerts();
+	mesh->generateIcosphere(2);
+	mesh->generateSoup(0.25f, 4, 7);
+	vector<cgp::Point> second = mesh->getVerts();
+	for(int i = 0; i < (int) first.size(); i++)
+		CPPUNIT_ASSERT(first[i].x == second[i].x && first[i].y == second[i].y && first[i].z == second[i].z);
+	mesh->mergeVerts();
+	CPPUNIT_ASSERT(mesh->getVerts().size() == 162);
+	mesh->shellStats(stats);
+	CPPUNIT_ASSERT(stats.size() == 1 && !stats[0].closed);
+}
+
+void TestMesh::testProfiling(){
+	TempDirectory tmpdir("profiling_tmp");
+	map<string, string> events;
+	string line;
+
+	stats::enableTracing(true);
+	stats::clearTrace();
+	CPPUNIT_ASSERT(mesh->readSTL("../meshes/sphere.stl"));
+	CPPUNIT_ASSERT(stats::writeTrace("profiling_tmp/trace.json"));
+	stats::enableTracing(false);
+
+	// one event per line, keyed by name
+	ifstream in("profiling_tmp/trace.json");
+	CPPUNIT_ASSERT(getline(in, line) && line.find("\"traceEvents\"") != string::npos);
+	while(getline(in, line)){
+		size_t start = line.find("\"name\": \"");
+		if(start != string::npos){
+			start += 9;
+			events[line.substr(start, line.find('"', start) - start)] = line;
+		}
+	}
+
+	// each phase is nested inside the one that calls it
+	const char * phases[][2] = {{"mesh.readSTL", "0"}, {"mesh.parseSTL", "1"}, {"mesh.weld", "1"}, {"mesh.mergeVerts", "2"},
+		{"mesh.deriveVertNorms", "2"}, {"mesh.validate", "1"}, {"mesh.createEdges", "2"}, {"mesh.checkBasic", "2"},
+		{"mesh.checkManifold", "2"}};
+	for(auto &phase: phases){
+		CPPUNIT_ASSERT(events.count(phase[0]) == 1);
+		CPPUNIT_ASSERT(events[phase[0]].find("\"ph\": \"X\"") != string::npos);
+		CPPUNIT_ASSERT(events[phase[0]].find("\"depth\": " + string(phase[1]) + "}") != string::npos);
+	}
+
+	// the spans also accumulate into the totals printed by reportTimes
+	for(const auto &time: stats::getTimes())
+		if(time->name() == "mesh.parseSTL")
+			CPPUNIT_ASSERT(time->times() >= 1);
+}
+
+void TestMesh::testCounters(){
+	stats::Counter counter("test.counter");
+	stats::Histogram histogram("test.histogram");
+
+	// each round runs on new threads, which take over the counts of the threads before them
+	for(int round = 0; round < 3; round++)
+		parallel::forChunks(1, 1001, 8, [&](int, int first, int last){
+			for(int i = first; i < last; i++){
+				counter.add();
+				histogram.add(i);
+			}
+		});
+	CPPUNIT_ASSERT(counter.total() == 3000);
+	CPPUNIT_ASSERT(histogram.count() == 3000);
+	CPPUNIT_ASSERT(histogram.sum() == 3 * 500500);
+	CPPUNIT_ASSERT(histogram.max() == 1000);
+
+	// quantiles are the top of a bucket, no more than an eighth above the true value
+	CPPUNIT_ASSERT(histogram.quantile(0.5) >= 500 && histogram.quantile(0.5) <= 500 * 9 / 8);
+	CPPUNIT_ASSERT(histogram.quantile(0.99) >= 990 && histogram.quantile(0.99) <= 1000);
+	CPPUNIT_ASSERT(histogram.quantile(0.0) == 1);
+	for(uint64_t v: {0ull, 7ull, 8ull, 15ull, 16ull, 1000ull, 123456789ull, ~0ull}){
+		int b = stats::Histogram::bucket(v);
+		CPPUNIT_ASSERT(b >= 0 && b < stats::Histogram::numBuckets);
+		CPPUNIT_ASSERT(stats::Histogram::bucketMax(b) >= v && (b == 0 || stats::Histogram::bucketMax(b - 1) < v));
+	}
+
+	// destroyed histograms give back their slots zeroed, so short-lived ones never run out
+	for(int i = 0; i < 1000; i++){
+		stats::Histogram temporary("test.temporary");
+		CPPUNIT_ASSERT(temporary.count() == 0);
+		temporary.add(i);
+		CPPUNIT_ASSERT(temporary.count() == 1);
+	}
+}
+
+void TestMesh::testLatency(){
+	stats::TimeInit init("test.latency", true);
+	std::shared_ptr<stats::Time> time;
+
+	for(const auto &t: stats::getTimes())
+		if(t->name() == "test.latency")
+			time = t;
+	CPPUNIT_ASSERT(time && time->latency() != NULL);
+
+	{
+		stats::Span span(init); // not recorded, timing is off
+	}
+	stats::enableTimers(true);
+	for(int i = 0; i < 10; i++){
+		stats::Span span(init);
+		mesh->generateIcosphere(2);
+	}
+	stats::enableTimers(false);
+
+	const stats::Histogram * latency = time->latency();
+	CPPUNIT_ASSERT(latency->count() == 10 && time->times() == 10);
+	CPPUNIT_ASSERT(latency->quantile(0.5) <= latency->quantile(0.99) && latency->quantile(0.99) <= latency->max());
+	CPPUNIT_ASSERT(latency->max() <= (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(time->total()).count());
+}
+
+void TestMesh::testMemoryBudget(){
+	int64_t before = stats::memoryInUse();
+
+	// the budget is checked before anything is allocated
+	stats::setMemoryBudget(before + 1024);
+	CPPUNIT_ASSERT(!mesh->readSTL("../meshes/bunny.stl"));
+	CPPUNIT_ASSERT(mesh->empty());
+	CPPUNIT_ASSERT(stats::memoryInUse() == before);
+	stats::setMemoryBudget(0);
+
+	// welding and validation of a mesh already held check what they would add
+	{
+		Mesh soup;
+		soup.generateIcosphere(3);
+		soup.generateSoup(0.0f, 0, 1);
+		int numverts = (int) soup.getVerts().size();
+		stats::setMemoryBudget(stats::memoryInUse() + 1024);
+		CPPUNIT_ASSERT(!soup.mergeVerts());
+		CPPUNIT_ASSERT((int) soup.getVerts().size() == numverts);
+		soup.validate(ValidationPolicy::FULL);
+		CPPUNIT_ASSERT(!soup.getValidity().tested);
+		stats::setMemoryBudget(0);
+		CPPUNIT_ASSERT(soup.mergeVerts() && soup.getVerts().size() == 642);
+	}
+	CPPUNIT_ASSERT(stats::memoryInUse() == before);
+
+	// 482 vertices with their normals and 960 triangles, released with the mesh
+	{
+		Mesh local;
+		CPPUNIT_ASSERT(local.readSTL("../meshes/sphere.stl"));
+		CPPUNIT_ASSERT(stats::memoryInUse() >= before + (int64_t) (482 * (sizeof(cgp::Point) + sizeof(cgp::Vector)) + 960 * sizeof(Triangle)));
+	}
+	CPPUNIT_ASSERT(stats::memoryInUse() == before);
+}
+
+void TestMesh::testArena(){
+	Arena arena(256);
+
+	// allocations are aligned, and larger than a block is fine
+	CPPUNIT_ASSERT(arena.allocate(1, 1) != NULL);
+	for(size_t align: {2, 4, 8, 16, 64}){
+		uintptr_t p = (uintptr_t) arena.allocate(3, align);
+		CPPUNIT_ASSERT(p % align == 0);
+	}
+	CPPUNIT_ASSERT(arena.allocate(1000) != NULL);
+	CPPUNIT_ASSERT(arena.bytesReserved() >= 1256 && arena.bytesUsed() >= 1015);
+	arena.reset();
+	CPPUNIT_ASSERT(arena.bytesUsed() == 0 && arena.bytesReserved() == 256);
+
+	// keys clustered into a small range so that some probes run long, checked against std::unordered_map
+	FlatMap<long, int, std::hash<long>, ArenaAllocator<std::pair<long, int> > > flat{ArenaAllocator<std::pair<long, int> >(arena)};
+	std::unordered_map<long, int> reference;
+	std::mt19937 rng(3);
+	for(int i = 0; i < 20000; i++){
+		long key = (long) (rng() % 5000) * 64;
+		bool fresh = flat.insert(key, i).second;
+		CPPUNIT_ASSERT(fresh == reference.emplace(key, i).second);
+	}
+	CPPUNIT_ASSERT(flat.size() == reference.size());
+	for(auto &entry: reference)
+		CPPUNIT_ASSERT(flat.find(entry.first) != NULL && * flat.find(entry.first) == entry.second);
+	CPPUNIT_ASSERT(flat.find(1) == NULL && flat.find(-64) == NULL);
+	int visited = 0;
+	flat.forEach([&](long, int){ visited++; });
+	CPPUNIT_ASSERT(visited == (int) reference.size());
+
+	// the arena vector alias uses the arena too
+	uts::arena_vector<int> counts(100, 0, ArenaAllocator<int>(arena));
+	counts[99]++;
+	CPPUNIT_ASSERT(counts[99] == 1);
+}
+
+void TestMesh::testFlatMap(){
+	uts::flat_map<uint64_t, int> map;
+
+	// dense keys spread by the scrambled hash, through several growths
+	for(int i = 0; i < 100000; i++)
+		CPPUNIT_ASSERT(map.insert((uint64_t) i << 32, i).second);
+	CPPUNIT_ASSERT(map.size() == 100000);
+	CPPUNIT_ASSERT(!map.insert((uint64_t) 5 << 32, -1).second && * map.find((uint64_t) 5 << 32) == 5);
+	for(int i = 0; i < 100000; i += 7)
+		CPPUNIT_ASSERT(map.find((uint64_t) i << 32) != NULL && * map.find((uint64_t) i << 32) == i);
+	CPPUNIT_ASSERT(map.find(1) == NULL);
+
+	map.forEach([](uint64_t, int &value){ value = -value; });
+	CPPUNIT_ASSERT(map[(uint64_t) 99999 << 32] == -99999);
+	CPPUNIT_ASSERT(map[12345] == 0 && map.size() == 100001);
+
+	size_t bytes = map.bytes();
+	map.clear();
+	CPPUNIT_ASSERT(map.empty() && map.find(0) == NULL && map.bytes() == bytes);
+	CPPUNIT_ASSERT(map.insert(0, 1).second && * map.find(0) == 1);
+
+	// icosphere midpoints are shared through a flat map, and a closed mesh still welds to the same vertices
+	mesh->generateIcosphere(3);
+	CPPUNIT_ASSERT(mesh->getVerts().size() == 642);
+	CPPUNIT_ASSERT(mesh->manifoldValidity());
+	mesh->readSTL("../meshes/torus.stl");
+	CPPUNIT_ASSERT(mesh->basicValidity());
+	CPPUNIT_ASSERT(mesh->manifoldValidity());
+}
+
+void TestMesh::testAccessors(){
+	mesh->readSTL("../meshes/sphere.stl");
+	const vector<cgp::Point> &verts = mesh->getVerts();
+	int numverts = (int) verts.size();
+
+	// repeated calls see the same array, and the triangles index into it
+	CPPUNIT_ASSERT(&mesh->getVerts() == &verts && !mesh->getTris().empty());
+	for(const Triangle &t: mesh->getTris())
+		for(int p = 0; p < 3; p++)
+			CPPUNIT_ASSERT(t.v[p] >= 0 && t.v[p] < numverts);
+
+	// a moved array is taken over rather than copied
+	vector<cgp::Point> moved(verts);
+	const cgp::Point * storage = moved.data();
+	mesh->setVerts(std::move(moved));
+	CPPUNIT_ASSERT(mesh->getVerts().data() == storage);
+
+	// appending reports where the new vertices start, and changes in place are seen through the view
+	CPPUNIT_ASSERT(mesh->appendVerts({cgp::Point(5, 5, 5), cgp::Point(6, 6, 6)}) == numverts);
+	CPPUNIT_ASSERT((int) verts.size() == numverts + 2 && verts[numverts + 1].x == 6.0f);
+	mesh->transformVerts([](int, cgp::Point &p){ p.x += 1.0f; });
+	CPPUNIT_ASSERT(verts[numverts].x == 6.0f);
+	CPPUNIT_ASSERT(!mesh->basicValidity()); // the appended vertices are dangling
+}
+
+void TestMesh::testCancel(){
+	vector<float> seen;
+	vector<pair<int, int>> pairs;
+	RepairReport report;
+
+	// progress through a whole load rises steadily to completion
+	{
+		Progress progress([&seen](float done){ seen.push_back(done); });
+		CPPUNIT_ASSERT(mesh->readSTL("../meshes/torus.stl", ValidationPolicy::FULL, &progress));
+		CPPUNIT_ASSERT(!seen.empty() && seen.back() == 1.0f);
+		for(int i = 1; i < (int) seen.size(); i++)
+			CPPUNIT_ASSERT(seen[i] >= seen[i-1]);
+	}
+
+	// a mesh big enough for several checks in each stage, cancelled once validation is under way
+	mesh->generateIcosphere(6);
+	int numverts = (int) mesh->getVerts().size();
+	{
+		Progress progress, * self = NULL;
+		Progress partway([&self](float done){ if(done > 0.9f) self->cancel(); });
+		self = &partway;
+		mesh->validate(ValidationPolicy::FULL, &partway);
+		CPPUNIT_ASSERT(partway.cancelled() && partway.fraction() < 1.0f);
+		CPPUNIT_ASSERT(!mesh->getValidity().tested);
+		CPPUNIT_ASSERT((int) mesh->getVerts().size() == numverts);
+
+		// without a cancel the same mesh validates
+		mesh->validate(ValidationPolicy::FULL, &progress);
+		CPPUNIT_ASSERT(mesh->getValidity().tested && mesh->getValidity().basic && mesh->getValidity().manifoldTested);
+		CPPUNIT_ASSERT(progress.fraction() == 1.0f);
+
+		// a cancelled weld leaves the mesh as it was, and a cancelled repair or search stops early, with
+		// the search reporting that it is incomplete rather than that there are no intersections
+		progress.cancel();
+		mesh->mergeVerts(ProgressRange(&progress));
+		CPPUNIT_ASSERT((int) mesh->getVerts().size() == numverts);
+		CPPUNIT_ASSERT(!mesh->repair(report, 128, &progress));
+		CPPUNIT_ASSERT(mesh->selfIntersections(pairs, false, 0, &progress) == IntersectionSearch::CANCELLED && pairs.empty());
+		CPPUNIT_ASSERT(mesh->basicValidity());
+	}
+}
+
+void TestMesh::testBatchClaims(){
+	const int numjobs = 100;
+	vector<atomic<int> > done(numjobs);
+	atomic<int> started(0);
+	int unclaimed;
+
+	// half the workers fail their setup and return without claiming, as a thread without a context does
+	for(auto &d: done)
+		d = 0;
+	unclaimed = parallel::forClaims(numjobs, 8, [&](const std::function<int()> &claim){
+		int i;
+		if(started++ % 2 == 0)
+			return;
+		while((i = claim()) >= 0)
+			done[i]++;
+	});
+	CPPUNIT_ASSERT(unclaimed == 0);
+	for(auto &d: done)
+		CPPUNIT_ASSERT(d == 1);
+
+	// when no worker starts, every job is reported unclaimed exactly once
+	unclaimed = parallel::forClaims(numjobs, 8, [&](const std::function<int()> &){});
+	CPPUNIT_ASSERT(unclaimed == numjobs);
+
+	// no more threads start than there are jobs, so here each worker takes exactly one
+	for(auto &d: done)
+		d = 0;
+	unclaimed = parallel::forClaims(3, 8, [&](const std::function<int()> &claim){
+		int i = claim();
+		if(i >= 0)
+			done[i]++;
+	});
+	CPPUNIT_ASSERT(unclaimed == 0);
+	CPPUNIT_ASSERT(done[0] == 1 && done[1] == 1 && done[2] == 1);
+}
 
 //#if 0 /* Disabled since it crashes the whole test suite */
 CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestMesh, TestSet::perCommit());
@@ -18,6 +18,28 @@ class TestMesh : public CppUnit::TestFixture
     CPPUNIT_TEST(testMeshingTorus);
     CPPUNIT_TEST(testEulerTorus);
     CPPUNIT_TEST(testEdgeBounds);
+    CPPUNIT_TEST(testValidationPolicy);
+    CPPUNIT_TEST(testShells);
+    CPPUNIT_TEST(testMassProperties);
+    CPPUNIT_TEST(testRepair);
+    CPPUNIT_TEST(testSelfIntersection);
+    CPPUNIT_TEST(testVoxelise);
+    CPPUNIT_TEST(testHollow);
+    CPPUNIT_TEST(testOffset);
+    CPPUNIT_TEST(testBoolean);
+    CPPUNIT_TEST(testSubdivide);
+    CPPUNIT_TEST(testSmooth);
+    CPPUNIT_TEST(testRemesh);
+    CPPUNIT_TEST(testGenerators);
+    CPPUNIT_TEST(testProfiling);
+    CPPUNIT_TEST(testCounters);
+    CPPUNIT_TEST(testLatency);
+    CPPUNIT_TEST(testMemoryBudget);
+    CPPUNIT_TEST(testArena);
+    CPPUNIT_TEST(testFlatMap);
+    CPPUNIT_TEST(testAccessors);
+    CPPUNIT_TEST(testCancel);
+    CPPUNIT_TEST(testBatchClaims);
     CPPUNIT_TEST_SUITE_END();
 
 private:
@@ -50,6 +72,72 @@ public:
     void testEulerTorus();
     
     void testEdgeBounds();
+
+    /// Check that skipped validation reports nothing and that background validation matches full validation
+    void testValidationPolicy();
+
+    /// Check shell labelling, statistics and splitting on single closed and open shells
+    void testShells();
+
+    /// Check that mass properties agree with shell statistics and do not depend on the thread count
+    void testMassProperties();
+
+    /// Check that repair closes the holes in the bunny and leaves a valid mesh untouched
+    void testRepair();
+
+    /// Check the triangle intersection test and that closed meshes report no self-intersections
+    void testSelfIntersection();
+
+    /// Check voxel volume against the mesh volume and that polygonising the voxels gives a closed surface
+    void testVoxelise();
+
+    /// Check that hollowing adds a closed inward facing shell enclosing the expected cavity
+    void testHollow();
+
+    /// Check offset volumes along normals on a cube and through the distance field on a sphere
+    void testOffset();
+
+    /// Check boolean volumes for overlapping, disjoint and nested cubes
+    void testBoolean();
+
+    /// Check that subdivision brings a faceted sphere closer to the true sphere and leaves creases alone
+    void testSubdivide();
+
+    /// Check that smoothing removes noise from a sphere without shrinking it, and that features are kept
+    void testSmooth();
+
+    /// Check that remeshing reaches the target edge length on closed shells without changing their shape
+    void testRemesh();
+
+    /// Check the size, closure, genus and volume of procedurally generated meshes, and the make-up of a generated soup
+    void testGenerators();
+
+    /// Check that loading records nested spans for each phase and that they are exported as a Chrome trace
+    void testProfiling();
+
+    /// Check that per-thread counters and histograms total correctly across threads, including ones that have exited
+    void testCounters();
+
+    /// Check that times keeping a latency histogram record each span, and only while timing is enabled
+    void testLatency();
+
+    /// Check that loaded meshes are charged to the memory accounts and that loads over the budget are refused
+    void testMemoryBudget();
+
+    /// Check arena alignment and reuse, and that a flat map in an arena agrees with std::unordered_map
+    void testArena();
+
+    /// Check that uts::flat_map keeps its entries through growth and clearing, and that welding through it is unchanged
+    void testFlatMap();
+
+    /// Check that the vertex and triangle accessors give views of the mesh arrays rather than copies
+    void testAccessors();
+
+    /// Check that long operations report increasing progress and stop cleanly when cancelled part way
+    void testCancel();
+
+    /// Check that batch jobs handed out to threads are each claimed or reported once, even when workers fail to start
+    void testBatchClaims();
 };
 
 #endif /* !TILER_TEST_MESH_H */
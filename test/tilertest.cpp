@@ -47,6 +47,16 @@ static po::variables_map processOptions(int argc, const char **argv)
         ("verbose,v",                                 "Show result of each test as it runs");
     desc.add(test);
 
+    po::options_description bench("Benchmark options (nightly)");
+    bench.add_options()
+        ("bench-sizes", po::value<std::string>()->default_value("1K,10K,100K,1M,10M,50M"), "Comma separated triangle counts, with optional K or M suffix")
+        ("bench-shape", po::value<std::string>()->default_value("torus"), "Generated mesh: torus, gyroid or sphere")
+        ("bench-repeats", po::value<int>()->default_value(3), "Runs of each stage, keeping the fastest")
+        ("bench-output", po::value<std::string>()->default_value("bench_mesh"), "Results file name, written with .csv and .json extensions")
+        ("bench-baseline", po::value<std::string>(), "CSV results to compare against, failing on regressions")
+        ("bench-tolerance", po::value<double>()->default_value(0.25), "Allowed slowdown against the baseline, as a fraction");
+    desc.add(bench);
+
 #if HAVE_OPENCL
     po::options_description cl("OpenCL options");
     CLH::addOptions(cl);